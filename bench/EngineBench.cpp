@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <new>
+#include <random>
+#include <stdlib.h>
+#include <vector>
+
+#include "wgleng/core/Components.h"
+#include "wgleng/core/EntryPoint.h"
+#include "wgleng/headless/GLRecorder.h"
+#include "wgleng/rendering/GLState.h"
+
+// per frame hot paths on synthetic scenes, run against the GLRecorder backend.
+// every scene is generated from a fixed seed, so numbers are comparable between runs.
+//     wgleng_bench --benchmark_filter=UpdateRenderableMeshes
+
+// =============================================================================
+// allocation counting
+// =============================================================================
+namespace {
+	std::atomic<uint64_t> g_allocations{0};
+}
+// gcc pairs the free in the replacement operator delete with the operator new of inlined call sites and warns
+// (-Wmismatched-new-delete), but every replacement new below allocates with malloc or aligned_alloc, which free
+// releases
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(std::size_t size) {
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = malloc(size ? size : 1)) return ptr;
+	abort();
+}
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	const auto align = static_cast<std::size_t>(alignment);
+	if (void* ptr = aligned_alloc(align, (size + align - 1) / align * align)) return ptr;
+	abort();
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return operator new(size, alignment);
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { free(ptr); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// =============================================================================
+// synthetic scenes
+// =============================================================================
+namespace {
+	struct SceneConfig {
+		int64_t staticMeshes = 0;
+		int64_t rigidBodies = 0;
+		int64_t texts = 0;
+		int64_t cascades = 3; // 2, 3 or 4, maps to the shadow presets
+		int64_t occluders = 0; // walls flagged OCCLUDER between the camera and the scene
+		bool shadowCache = false; // off, so the other benchmarks redraw every cascade each frame
+
+		bool operator==(const SceneConfig&) const = default;
+	};
+
+	Context* g_ctx = nullptr;
+	SceneConfig g_config;
+	bool g_running = false;
+
+	void createBoxMesh() {
+		const std::vector<Vertex> vertices = {
+			{{-0.5f, -0.5f, -0.5f}, {0, 0, -1}}, {{0.5f, -0.5f, -0.5f}, {0, 0, -1}},
+			{{0.5f, 0.5f, -0.5f}, {0, 0, -1}}, {{-0.5f, 0.5f, -0.5f}, {0, 0, -1}},
+			{{-0.5f, -0.5f, 0.5f}, {0, 0, 1}}, {{0.5f, -0.5f, 0.5f}, {0, 0, 1}},
+			{{0.5f, 0.5f, 0.5f}, {0, 0, 1}}, {{-0.5f, 0.5f, 0.5f}, {0, 0, 1}},
+		};
+		const std::vector<uint32_t> indices = {
+			0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+			3, 6, 2, 3, 7, 6, 1, 2, 6, 1, 6, 5, 0, 4, 7, 0, 7, 3,
+		};
+		const std::vector<Material> materials = {{{0.8f, 0.8f, 0.8f, 1}}};
+		MeshRegistry::Create("box")->Load(vertices, materials, indices);
+	}
+
+	class BenchScene : public Scene {
+	public:
+		explicit BenchScene(const SceneConfig& config) {
+			m_camera = std::make_shared<Camera>();
+			m_camera->position = {0, 40, -150};
+			m_camera->SetRotation(90, -15);
+			m_camera->SetFarPlane(600);
+
+			std::mt19937 rng{1234};
+			std::uniform_real_distribution<float> position{-100.0f, 100.0f};
+			std::uniform_real_distribution<float> rotation{0.0f, 360.0f};
+			const Mesh box = MeshRegistry::Get("box");
+
+			// floor
+			const auto floor = registry.create();
+			registry.emplace<RigidBodyComponent>(floor, RigidBodyComponent{
+				m_physicsWorld.CreateRigidBody(floor, m_physicsWorld.GetBoxCollider({200, 0.5f, 200}), 0, {0, -0.5f, 0}, {0, 0, 0})
+			});
+
+			for (int64_t i = 0; i < config.staticMeshes; i++) {
+				const auto entity = registry.create();
+				registry.emplace<MeshComponent>(entity, MeshComponent{.mesh = box, .position = glm::vec3{0}, .rotation = glm::vec3{0}});
+				registry.emplace<TransformComponent>(entity, TransformComponent{
+					.position = {position(rng), (position(rng) + 100.0f) * 0.2f, position(rng)},
+					.rotation = {0, rotation(rng), 0},
+					.scale = {2, 2, 2}
+				});
+			}
+
+			// a row of walls in front of the camera
+			for (int64_t i = 0; i < config.occluders; i++) {
+				const auto entity = registry.create();
+				registry.emplace<MeshComponent>(entity, MeshComponent{.mesh = box, .position = glm::vec3{0}, .rotation = glm::vec3{0}});
+				registry.emplace<FlagComponent>(entity, FlagComponent{EntityFlags::OCCLUDER});
+				registry.emplace<TransformComponent>(entity, TransformComponent{
+					.position = {(static_cast<float>(i) - static_cast<float>(config.occluders - 1) * 0.5f) * 40.0f, 40, -110},
+					.rotation = {0, 0, 0},
+					.scale = {40, 80, 1}
+				});
+			}
+
+			const auto boxCollider = m_physicsWorld.GetBoxCollider({0.5f, 0.5f, 0.5f});
+			std::vector<entt::entity> bodies;
+			for (int64_t i = 0; i < config.rigidBodies; i++) {
+				const auto entity = registry.create();
+				const glm::vec3 pos{position(rng), 1 + (position(rng) + 100.0f) * 0.5f, position(rng)};
+				registry.emplace<MeshComponent>(entity, MeshComponent{.mesh = box, .position = glm::vec3{0}, .rotation = glm::vec3{0}});
+				registry.emplace<RigidBodyComponent>(entity, RigidBodyComponent{
+					m_physicsWorld.CreateRigidBody(entity, boxCollider, 1, pos, {0, rotation(rng), 0})
+				});
+				bodies.push_back(entity);
+			}
+
+			// half of the texts float in the world, the other half ride on rigid bodies
+			for (int64_t i = 0; i < config.texts; i++) {
+				auto text = Text::CreateText("arial", "Entity " + std::to_string(i));
+				text->useOrtho = false;
+				text->scale = glm::vec3{0.01f};
+				if (i % 2 == 1 && !bodies.empty()) {
+					text->position = {0, 1, 0};
+					registry.get_or_emplace<TextComponent>(bodies[i % bodies.size()]).texts.push_back(text);
+				}
+				else {
+					text->position = {position(rng), 5, position(rng)};
+					AddText(text);
+				}
+				m_texts.push_back(std::move(text));
+			}
+		}
+
+		void Update(TimeDuration dt) override {
+			m_physicsWorld.Update(dt);
+		}
+
+		PhysicsWorld& GetPhysics() { return m_physicsWorld; }
+
+	private:
+		std::vector<std::shared_ptr<DrawableText>> m_texts;
+	};
+
+	// (re)starts the engine when the requested scene differs from the running one
+	bool useScene(const SceneConfig& config) {
+		if (g_running && g_config == config) return true;
+		if (g_running) I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_stop();
+		g_config = config;
+		g_running = I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_start();
+		if (!g_running) return false;
+		// let the piles settle a bit so sleeping bodies are part of the picture
+		I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_runFrames(30, 16667us);
+		return true;
+	}
+	BenchScene& scene() {
+		return static_cast<BenchScene&>(*g_ctx->scene);
+	}
+
+	void reportPerEntity(benchmark::State& state, int64_t entities, uint64_t allocations) {
+		state.counters["ns/entity"] = benchmark::Counter(static_cast<double>(state.iterations() * std::max<int64_t>(entities, 1)),
+			benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+		state.counters["allocs/frame"] = static_cast<double>(allocations) / static_cast<double>(state.iterations());
+	}
+
+	// Args: {entities, cascades}
+	SceneConfig meshScene(const benchmark::State& state) {
+		return {.staticMeshes = state.range(0) / 2, .rigidBodies = state.range(0) / 2, .cascades = state.range(1)};
+	}
+	void meshArgs(benchmark::internal::Benchmark* b) {
+		b->ArgNames({"entities", "cascades"});
+		for (const int64_t entities : {1000, 10000}) {
+			for (const int64_t cascades : {2, 4}) b->Args({entities, cascades});
+		}
+		b->Unit(benchmark::kMicrosecond);
+	}
+	void entityArgs(benchmark::internal::Benchmark* b) {
+		b->ArgNames({"entities"});
+		b->Arg(1000)->Arg(10000);
+		b->Unit(benchmark::kMicrosecond);
+	}
+}
+
+// =============================================================================
+// renderer steps
+// =============================================================================
+class RendererBench {
+public:
+	static std::vector<glm::mat4> LightSpaceMatrices() {
+		auto& renderer = g_ctx->renderer;
+		const auto& camera = g_ctx->scene->GetCamera();
+		camera->Update(renderer.m_settings.resolution.width, renderer.m_settings.resolution.height);
+		glm::vec3 sceneMin{FLT_MAX}, sceneMax{-FLT_MAX};
+		g_ctx->scene->GetMeshInstances().GetBvh().GetBounds(sceneMin, sceneMax);
+		return renderer.m_csmbuffer.GetLightSpaceMatrices(camera, g_ctx->scene->sunlightDir, sceneMin, sceneMax);
+	}
+	// like Renderer::Render, the store is brought up to date before the meshes are culled
+	static void UpdateRenderableMeshes(const std::vector<glm::mat4>& csmMatrices) {
+		g_ctx->scene->GetMeshInstances().Update(g_ctx->scene->GetPhysicsWorld());
+		g_ctx->renderer.UpdateRenderableMeshes(g_ctx->scene, csmMatrices);
+	}
+	static std::size_t CameraInstances() {
+		std::size_t count = 0;
+		for (const auto& visible : g_ctx->renderer.m_renderableMeshesState.frustumInstances[0]) count += visible.size();
+		return count;
+	}
+	static void UpdateUniforms() {
+		g_ctx->renderer.m_streamBuffer.BeginFrame();
+		g_ctx->renderer.UpdateUniforms(g_ctx->scene);
+		g_ctx->renderer.m_streamBuffer.EndFrame();
+	}
+	static void RenderText() {
+		g_ctx->renderer.m_streamBuffer.BeginFrame();
+		g_ctx->renderer.RenderText(g_ctx->scene);
+		g_ctx->renderer.m_streamBuffer.EndFrame();
+	}
+};
+
+namespace {
+	bool start(benchmark::State& state, const SceneConfig& config) {
+		if (!useScene(config)) {
+			state.SkipWithError("failed to start engine");
+			return false;
+		}
+		// WebGL would have rejected a call, the numbers would not be meaningful
+		if (GLRecorder::GetErrorCount() > 0) {
+			state.SkipWithError("gl errors, see stderr");
+			return false;
+		}
+		return true;
+	}
+
+	void BM_UpdateRenderableMeshes(benchmark::State& state) {
+		if (!start(state, meshScene(state))) return;
+		const auto csmMatrices = RendererBench::LightSpaceMatrices();
+		const uint64_t allocsBefore = g_allocations;
+		for (auto _ : state) {
+			RendererBench::UpdateRenderableMeshes(csmMatrices);
+		}
+		reportPerEntity(state, state.range(0), g_allocations - allocsBefore);
+	}
+	BENCHMARK(BM_UpdateRenderableMeshes)->Apply(meshArgs);
+
+	// Args: {entities, walls}
+	void BM_OcclusionCulling(benchmark::State& state) {
+		SceneConfig config = meshScene(state);
+		config.cascades = 2;
+		config.occluders = state.range(1);
+		if (!start(state, config)) return;
+		const auto csmMatrices = RendererBench::LightSpaceMatrices();
+		const uint64_t allocsBefore = g_allocations;
+		for (auto _ : state) {
+			RendererBench::UpdateRenderableMeshes(csmMatrices);
+		}
+		reportPerEntity(state, state.range(0), g_allocations - allocsBefore);
+		state.counters["visible"] = static_cast<double>(RendererBench::CameraInstances());
+	}
+	BENCHMARK(BM_OcclusionCulling)->ArgNames({"entities", "walls"})->Args({10000, 0})->Args({10000, 4})->Unit(benchmark::kMicrosecond);
+
+	void BM_UpdateUniforms(benchmark::State& state) {
+		if (!start(state, meshScene(state))) return;
+		const auto csmMatrices = RendererBench::LightSpaceMatrices();
+		RendererBench::UpdateRenderableMeshes(csmMatrices);
+		GLRecorder::Reset();
+		const uint64_t allocsBefore = g_allocations;
+		for (auto _ : state) {
+			RendererBench::UpdateUniforms();
+			GLRecorder::EndFrame();
+		}
+		reportPerEntity(state, state.range(0), g_allocations - allocsBefore);
+		const auto& total = GLRecorder::GetTotalStats();
+		state.counters["uploadKB/frame"] = (total.bufferUploadBytes + total.textureUploadBytes) / 1024.0 / state.iterations();
+	}
+	BENCHMARK(BM_UpdateUniforms)->Apply(meshArgs);
+
+	void BM_PhysicsUpdate(benchmark::State& state) {
+		if (!start(state, {.rigidBodies = state.range(0)})) return;
+		auto& physics = scene().GetPhysics();
+		const uint64_t allocsBefore = g_allocations;
+		for (auto _ : state) {
+			physics.Update(16667us);
+		}
+		reportPerEntity(state, state.range(0), g_allocations - allocsBefore);
+	}
+	BENCHMARK(BM_PhysicsUpdate)->Apply(entityArgs);
+
+	void BM_CheckObjectsTouchingGround(benchmark::State& state) {
+		if (!start(state, {.rigidBodies = state.range(0)})) return;
+		const auto& physics = scene().GetPhysics();
+		const uint64_t allocsBefore = g_allocations;
+		for (auto _ : state) {
+			physics.CheckObjectsTouchingGround();
+		}
+		reportPerEntity(state, state.range(0), g_allocations - allocsBefore);
+	}
+	BENCHMARK(BM_CheckObjectsTouchingGround)->Apply(entityArgs);
+
+	void BM_RenderText(benchmark::State& state) {
+		if (!start(state, {.rigidBodies = state.range(0), .texts = state.range(0)})) return;
+		RendererBench::LightSpaceMatrices();
+		const uint64_t allocsBefore = g_allocations;
+		for (auto _ : state) {
+			RendererBench::RenderText();
+			GLRecorder::EndFrame();
+		}
+		reportPerEntity(state, state.range(0), g_allocations - allocsBefore);
+	}
+	BENCHMARK(BM_RenderText)->Apply(entityArgs);
+
+	void BM_DrawableTextConstruction(benchmark::State& state) {
+		if (!start(state, {})) return;
+		const std::string text = "Health: 100  Ammo: 30/90  Score: 123456";
+		const uint64_t allocsBefore = g_allocations;
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(Text::CreateText("arial", text));
+		}
+		// entities are glyphs here
+		reportPerEntity(state, static_cast<int64_t>(text.size()), g_allocations - allocsBefore);
+	}
+	BENCHMARK(BM_DrawableTextConstruction)->Unit(benchmark::kMicrosecond);
+
+	// whole frames: scripts, physics, instance updates, culling and draw submission
+	void BM_EngineFrame(benchmark::State& state) {
+		const SceneConfig config = meshScene(state);
+		if (!start(state, config)) return;
+		GLRecorder::Reset();
+		const uint64_t allocsBefore = g_allocations;
+		for (auto _ : state) {
+			I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_runFrames(1, 16667us);
+		}
+		reportPerEntity(state, state.range(0), g_allocations - allocsBefore);
+		const auto& total = GLRecorder::GetTotalStats();
+		const double frames = std::max<double>(GLRecorder::GetFrameCount(), 1);
+		state.counters["draws"] = total.drawCalls / frames;
+		state.counters["instances"] = total.instances / frames;
+		state.counters["stateChanges"] = total.stateChanges / frames;
+		state.counters["redundant"] = total.redundantStateChanges / frames;
+		state.counters["elided"] = GLState::GetElidedCount(); // last frame
+	}
+	BENCHMARK(BM_EngineFrame)->Apply(meshArgs)->Unit(benchmark::kMillisecond);
+
+	// Args: {entities, shadow cache}, whole frames with 4 cascades
+	void BM_ShadowCache(benchmark::State& state) {
+		SceneConfig config = meshScene(state);
+		config.cascades = 4;
+		config.shadowCache = state.range(1) != 0;
+		if (!start(state, config)) return;
+		GLRecorder::Reset();
+		const uint64_t allocsBefore = g_allocations;
+		for (auto _ : state) {
+			I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_runFrames(1, 16667us);
+		}
+		reportPerEntity(state, state.range(0), g_allocations - allocsBefore);
+		const auto& total = GLRecorder::GetTotalStats();
+		const double frames = std::max<double>(GLRecorder::GetFrameCount(), 1);
+		state.counters["draws"] = total.drawCalls / frames;
+		state.counters["instances"] = total.instances / frames;
+	}
+	BENCHMARK(BM_ShadowCache)->ArgNames({"entities", "cache"})->Args({10000, 0})->Args({10000, 1})->Unit(benchmark::kMillisecond);
+}
+
+void onInit(Context* ctx) {
+	g_ctx = ctx;
+	RendererSettings settings = ctx->renderer.GetSettings();
+	settings.shadows = g_config.cascades <= 2 ? RendererSettings::ShadowPreset::LOW :
+		g_config.cascades == 3 ? RendererSettings::ShadowPreset::MEDIUM : RendererSettings::ShadowPreset::HIGH;
+	settings.shadowCache.enabled = g_config.shadowCache;
+	settings.shadowCache.cacheStaticCasters = g_config.shadowCache;
+	ctx->renderer.SetSettings(settings, false);
+	createBoxMesh();
+	ctx->scene = std::make_shared<BenchScene>(g_config);
+}
+void onDeinit(Context* ctx) {
+	ctx->scene.reset();
+	g_ctx = nullptr;
+}
+void onTick(Context* /*ctx*/, TimeDuration /*dt*/) {}
+
+int main(int argc, char** argv) {
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+	benchmark::RunSpecifiedBenchmarks();
+	if (g_running) I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_stop();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,95 @@
+#include <benchmark/benchmark.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <vector>
+
+#include "wgleng/rendering/FrustumCulling.h"
+
+namespace {
+	struct Boxes {
+		// world space
+		std::vector<glm::vec3> min;
+		std::vector<glm::vec3> max;
+		// local space + model matrix, as the renderer used to cull
+		std::vector<glm::mat4> models;
+		// soa
+		std::vector<float> centerX, centerY, centerZ;
+		std::vector<float> extentX, extentY, extentZ;
+	};
+
+	Boxes makeBoxes(std::size_t count) {
+		Boxes boxes;
+		std::mt19937 rng{1234};
+		std::uniform_real_distribution<float> position{-200.0f, 200.0f};
+		std::uniform_real_distribution<float> size{0.5f, 4.0f};
+		for (std::size_t i = 0; i < count; i++) {
+			const glm::vec3 center{position(rng), position(rng) * 0.25f, position(rng)};
+			const glm::vec3 extent{size(rng), size(rng), size(rng)};
+			boxes.min.push_back(center - extent);
+			boxes.max.push_back(center + extent);
+			boxes.models.push_back(glm::scale(glm::translate(glm::mat4(1.0f), center), extent));
+			boxes.centerX.push_back(center.x);
+			boxes.centerY.push_back(center.y);
+			boxes.centerZ.push_back(center.z);
+			boxes.extentX.push_back(extent.x);
+			boxes.extentY.push_back(extent.y);
+			boxes.extentZ.push_back(extent.z);
+		}
+		return boxes;
+	}
+
+	FrustumCulling makeFrustum() {
+		const glm::mat4 proj = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(1.0f, 8.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		return FrustumCulling{proj * view};
+	}
+}
+
+static void BM_PerCornerModel(benchmark::State& state) {
+	const auto boxes = makeBoxes(state.range(0));
+	const auto frustum = makeFrustum();
+	const glm::vec3 localMin{-1.0f};
+	const glm::vec3 localMax{1.0f};
+	for (auto _ : state) {
+		uint32_t visible = 0;
+		for (const auto& model : boxes.models) {
+			visible += frustum.IsAabbVisible(localMin, localMax, model);
+		}
+		benchmark::DoNotOptimize(visible);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_PerCorner(benchmark::State& state) {
+	const auto boxes = makeBoxes(state.range(0));
+	const auto frustum = makeFrustum();
+	for (auto _ : state) {
+		uint32_t visible = 0;
+		for (std::size_t i = 0; i < boxes.min.size(); i++) {
+			visible += frustum.IsAabbVisible(boxes.min[i], boxes.max[i]);
+		}
+		benchmark::DoNotOptimize(visible);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_Batched(benchmark::State& state) {
+	const auto boxes = makeBoxes(state.range(0));
+	const auto frustum = makeFrustum();
+	const FrustumCulling::AabbBatch batch{
+		boxes.centerX.data(), boxes.centerY.data(), boxes.centerZ.data(),
+		boxes.extentX.data(), boxes.extentY.data(), boxes.extentZ.data(),
+		boxes.centerX.size()
+	};
+	std::vector<uint32_t> mask((batch.count + 31) / 32);
+	for (auto _ : state) {
+		frustum.CullAabbs(batch, mask.data());
+		benchmark::DoNotOptimize(mask.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_PerCornerModel)->Arg(10'000)->Arg(100'000)->Arg(1'000'000);
+BENCHMARK(BM_PerCorner)->Arg(10'000)->Arg(100'000)->Arg(1'000'000);
+BENCHMARK(BM_Batched)->Arg(10'000)->Arg(100'000)->Arg(1'000'000);
@@ -0,0 +1,179 @@
+#pragma once
+
+// index buffer optimizations run by objpacker after indices are generated.
+//   - tipsify: post transform vertex cache ordering (Sander, Nehab, Barczak 2007)
+//   - clusters that tipsify emits are then sorted so outward facing ones draw first, reducing overdraw
+//   - vertices are renumbered in first use order so vertex fetch walks memory linearly
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <numeric>
+#include <stdint.h>
+#include <vector>
+
+namespace MeshOptimizer {
+    // webgl does not expose the cache size, 16 is a safe lower bound for current gpus
+    constexpr uint32_t CacheSize = 16;
+
+    struct CacheStats {
+        float acmr; // transformed vertices per triangle, 0.5 is the optimum for big regular meshes
+        float atvr; // transformed vertices per unique vertex, 1 is the optimum
+    };
+
+    // simulated fifo cache, which is what most hardware behaves like
+    inline CacheStats AnalyzeCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = CacheSize) {
+        if (indices.empty() || vertexCount == 0) return {0, 0};
+        std::vector<uint32_t> cachedAt(vertexCount, 0);
+        uint32_t transformed = 0;
+        for (const uint32_t index : indices) {
+            // a vertex is still in the fifo if fewer than cacheSize vertices were transformed after it
+            if (cachedAt[index] == 0 || transformed - cachedAt[index] >= cacheSize) {
+                transformed++;
+                cachedAt[index] = transformed;
+            }
+        }
+        return {
+            static_cast<float>(transformed) / static_cast<float>(indices.size() / 3),
+            static_cast<float>(transformed) / static_cast<float>(vertexCount)
+        };
+    }
+
+    // returns the reordered indices and the triangle offsets where a new cluster starts
+    inline std::pair<std::vector<uint32_t>, std::vector<uint32_t>> Tipsify(const std::vector<uint32_t>& indices,
+        uint32_t vertexCount, uint32_t cacheSize = CacheSize) {
+        const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+        // vertex -> triangle adjacency
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+        for (const uint32_t index : indices) liveTriangles[index]++;
+        std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+        for (uint32_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (uint32_t i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = i / 3;
+
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> deadEnd;
+        deadEnd.reserve(indices.size());
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        std::vector<uint32_t> clusters;
+
+        uint32_t time = cacheSize + 1;
+        uint32_t cursor = 0;
+        int64_t fanning = vertexCount > 0 ? 0 : -1;
+        bool newCluster = true;
+        std::vector<uint32_t> candidates;
+        while (fanning >= 0) {
+            candidates.clear();
+            const uint32_t v = static_cast<uint32_t>(fanning);
+            for (uint32_t a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; a++) {
+                const uint32_t t = adjacency[a];
+                if (emitted[t]) continue;
+                if (newCluster) {
+                    clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+                    newCluster = false;
+                }
+                emitted[t] = true;
+                for (uint32_t k = 0; k < 3; k++) {
+                    const uint32_t w = indices[t * 3 + k];
+                    result.push_back(w);
+                    deadEnd.push_back(w);
+                    candidates.push_back(w);
+                    liveTriangles[w]--;
+                    if (time - cacheTime[w] > cacheSize) cacheTime[w] = time++;
+                }
+            }
+
+            // next fanning vertex: the candidate that stays in cache longest and still has triangles left
+            int64_t best = -1;
+            int64_t bestPriority = -1;
+            for (const uint32_t w : candidates) {
+                if (liveTriangles[w] == 0) continue;
+                int64_t priority = 0;
+                if (time - cacheTime[w] + 2 * liveTriangles[w] <= cacheSize) priority = time - cacheTime[w];
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    best = w;
+                }
+            }
+            if (best == -1) {
+                // dead end, try recently used vertices first, then fall back to scanning in input order
+                newCluster = true;
+                while (!deadEnd.empty() && best == -1) {
+                    const uint32_t w = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (liveTriangles[w] > 0) best = w;
+                }
+                while (best == -1 && cursor < vertexCount) {
+                    if (liveTriangles[cursor] > 0) best = cursor;
+                    cursor++;
+                }
+            }
+            fanning = best;
+        }
+        return {std::move(result), std::move(clusters)};
+    }
+
+    // sorts tipsify clusters so those facing away from the mesh center, which usually occlude the rest, draw first
+    inline std::vector<uint32_t> SortClustersForOverdraw(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters,
+        const std::vector<glm::vec3>& positions) {
+        const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        if (clusters.size() < 2) return indices;
+
+        glm::vec3 meshCenter{0};
+        for (const auto& p : positions) meshCenter += p;
+        meshCenter /= static_cast<float>(std::max<std::size_t>(positions.size(), 1));
+
+        std::vector<float> sortKey(clusters.size());
+        for (std::size_t c = 0; c < clusters.size(); c++) {
+            const uint32_t begin = clusters[c];
+            const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            glm::vec3 center{0};
+            glm::vec3 normal{0};
+            float area = 0;
+            for (uint32_t t = begin; t < end; t++) {
+                const auto& a = positions[indices[t * 3 + 0]];
+                const auto& b = positions[indices[t * 3 + 1]];
+                const auto& c2 = positions[indices[t * 3 + 2]];
+                const glm::vec3 cross = glm::cross(b - a, c2 - a);
+                const float triangleArea = glm::length(cross) * 0.5f;
+                center += (a + b + c2) / 3.0f * triangleArea;
+                normal += cross;
+                area += triangleArea;
+            }
+            if (area > 0) center /= area;
+            const float normalLength = glm::length(normal);
+            sortKey[c] = normalLength > 0 ? glm::dot(center - meshCenter, normal / normalLength) : 0;
+        }
+
+        std::vector<uint32_t> order(clusters.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (const uint32_t c : order) {
+            const uint32_t begin = clusters[c];
+            const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            result.insert(result.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+        }
+        return result;
+    }
+
+    // renumbers vertices in first use order, returns old index for each new vertex
+    inline std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+        constexpr uint32_t unused = ~0u;
+        std::vector<uint32_t> remap(vertexCount, unused);
+        std::vector<uint32_t> order;
+        order.reserve(vertexCount);
+        for (auto& index : indices) {
+            if (remap[index] == unused) {
+                remap[index] = static_cast<uint32_t>(order.size());
+                order.push_back(index);
+            }
+            index = remap[index];
+        }
+        return order;
+    }
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+// quadric error edge collapse (Garland, Heckbert 1997) used by objpacker to build lod chains.
+// collapses only move a vertex onto one of its neighbours, so simplified meshes reuse the input positions.
+// open borders and material borders get extra quadrics so silhouettes and color regions hold their shape.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <queue>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace MeshSimplifier {
+    struct Result {
+        std::vector<uint32_t> indices;         // into the input positions
+        std::vector<uint32_t> sourceTriangles; // input triangle each output triangle came from
+        float error;                           // largest rms distance of a collapsed vertex to its original planes
+    };
+
+    namespace detail {
+        struct Quadric {
+            std::array<double, 10> q{}; // upper triangle of the symmetric 4x4 matrix
+            double weight = 0;
+
+            static Quadric FromPlane(const glm::dvec3& n, double d, double weight) {
+                Quadric quadric;
+                quadric.q = {
+                    n.x * n.x, n.x * n.y, n.x * n.z, n.x * d,
+                               n.y * n.y, n.y * n.z, n.y * d,
+                                          n.z * n.z, n.z * d,
+                                                     d * d
+                };
+                for (auto& v : quadric.q) v *= weight;
+                quadric.weight = weight;
+                return quadric;
+            }
+            Quadric& operator+=(const Quadric& other) {
+                for (std::size_t i = 0; i < q.size(); i++) q[i] += other.q[i];
+                weight += other.weight;
+                return *this;
+            }
+            // squared distance to the accumulated planes, averaged by weight
+            double Error(const glm::dvec3& p) const {
+                const double e =
+                    q[0] * p.x * p.x + 2 * q[1] * p.x * p.y + 2 * q[2] * p.x * p.z + 2 * q[3] * p.x +
+                    q[4] * p.y * p.y + 2 * q[5] * p.y * p.z + 2 * q[6] * p.y +
+                    q[7] * p.z * p.z + 2 * q[8] * p.z +
+                    q[9];
+                return weight > 0 ? std::max(e, 0.0) / weight : 0;
+            }
+        };
+
+        struct Collapse {
+            double cost;
+            uint32_t from, to;
+            uint32_t fromVersion, toVersion;
+            bool operator>(const Collapse& other) const { return cost > other.cost; }
+        };
+
+        inline uint64_t EdgeKey(uint32_t a, uint32_t b) {
+            if (a > b) std::swap(a, b);
+            return (static_cast<uint64_t>(a) << 32) | b;
+        }
+    }
+
+    // positions must be welded, triangles that share a corner have to use the same index.
+    // stops at targetTriangles or before any collapse whose error would exceed maxError
+    inline Result Simplify(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+        const std::vector<int32_t>& triangleMaterials, uint32_t targetTriangles, float maxError) {
+        using namespace detail;
+        const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+        const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+        std::vector<uint32_t> triangles(indices.begin(), indices.end());
+        std::vector<bool> triangleAlive(triangleCount, true);
+        std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+        std::vector<Quadric> quadrics(vertexCount);
+        uint32_t liveTriangles = 0;
+
+        const auto position = [&](uint32_t v) { return glm::dvec3(positions[v]); };
+        const auto triangleNormal = [&](uint32_t t) {
+            const glm::dvec3 a = position(triangles[t * 3 + 0]);
+            return glm::cross(position(triangles[t * 3 + 1]) - a, position(triangles[t * 3 + 2]) - a);
+        };
+
+        // face quadrics, area weighted
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            const uint32_t a = triangles[t * 3 + 0], b = triangles[t * 3 + 1], c = triangles[t * 3 + 2];
+            if (a == b || b == c || c == a) {
+                triangleAlive[t] = false;
+                continue;
+            }
+            liveTriangles++;
+            for (uint32_t k = 0; k < 3; k++) vertexTriangles[triangles[t * 3 + k]].push_back(t);
+            const glm::dvec3 cross = triangleNormal(t);
+            const double length = glm::length(cross);
+            if (length <= 0) continue;
+            const glm::dvec3 n = cross / length;
+            const auto quadric = Quadric::FromPlane(n, -glm::dot(n, position(a)), length * 0.5);
+            for (uint32_t k = 0; k < 3; k++) quadrics[triangles[t * 3 + k]] += quadric;
+        }
+
+        // border quadrics, planes through the edge perpendicular to its face
+        struct EdgeUse {
+            uint32_t triangle;
+            uint32_t count;
+            bool sameMaterial;
+        };
+        std::unordered_map<uint64_t, EdgeUse> edges;
+        edges.reserve(triangleCount * 3);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            if (!triangleAlive[t]) continue;
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint64_t key = EdgeKey(triangles[t * 3 + k], triangles[t * 3 + (k + 1) % 3]);
+                auto [it, inserted] = edges.try_emplace(key, EdgeUse{t, 1, true});
+                if (inserted) continue;
+                it->second.count++;
+                if (triangleMaterials[it->second.triangle] != triangleMaterials[t]) it->second.sameMaterial = false;
+            }
+        }
+        constexpr double borderWeight = 10.0;
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            if (!triangleAlive[t]) continue;
+            const glm::dvec3 cross = triangleNormal(t);
+            if (glm::length(cross) <= 0) continue;
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint32_t a = triangles[t * 3 + k], b = triangles[t * 3 + (k + 1) % 3];
+                const auto& edge = edges[EdgeKey(a, b)];
+                if (edge.count == 2 && edge.sameMaterial) continue;
+                const glm::dvec3 direction = position(b) - position(a);
+                const glm::dvec3 perpendicular = glm::cross(direction, cross);
+                const double length = glm::length(perpendicular);
+                if (length <= 0) continue;
+                const glm::dvec3 n = perpendicular / length;
+                const auto quadric = Quadric::FromPlane(n, -glm::dot(n, position(a)), glm::dot(direction, direction) * borderWeight);
+                quadrics[a] += quadric;
+                quadrics[b] += quadric;
+            }
+        }
+
+        // candidate collapses in both directions of every edge
+        std::vector<uint32_t> versions(vertexCount, 0);
+        std::vector<bool> vertexAlive(vertexCount, true);
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> heap;
+        const auto pushCollapse = [&](uint32_t from, uint32_t to) {
+            Quadric merged = quadrics[from];
+            merged += quadrics[to];
+            heap.push({merged.Error(position(to)), from, to, versions[from], versions[to]});
+        };
+        for (const auto& [key, edge] : edges) {
+            const uint32_t a = static_cast<uint32_t>(key >> 32), b = static_cast<uint32_t>(key);
+            pushCollapse(a, b);
+            pushCollapse(b, a);
+        }
+
+        // moving from onto to must not flip or degenerate any remaining triangle
+        const auto collapseFlips = [&](uint32_t from, uint32_t to) {
+            for (const uint32_t t : vertexTriangles[from]) {
+                if (!triangleAlive[t]) continue;
+                const uint32_t* tri = &triangles[t * 3];
+                if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+                glm::dvec3 p[3];
+                for (uint32_t k = 0; k < 3; k++) p[k] = position(tri[k] == from ? to : tri[k]);
+                const glm::dvec3 before = triangleNormal(t);
+                const glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                const double beforeLength = glm::length(before), afterLength = glm::length(after);
+                if (afterLength <= 0 || beforeLength <= 0) return true;
+                if (glm::dot(before, after) < 0.25 * beforeLength * afterLength) return true;
+            }
+            return false;
+        };
+
+        const double maxCost = static_cast<double>(maxError) * maxError;
+        double worstCost = 0;
+        while (liveTriangles > targetTriangles && !heap.empty()) {
+            const Collapse collapse = heap.top();
+            heap.pop();
+            if (collapse.cost > maxCost) break;
+            const uint32_t from = collapse.from, to = collapse.to;
+            if (!vertexAlive[from] || !vertexAlive[to]) continue;
+            if (versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion) continue;
+            if (collapseFlips(from, to)) continue;
+
+            vertexAlive[from] = false;
+            quadrics[to] += quadrics[from];
+            versions[to]++;
+            worstCost = std::max(worstCost, collapse.cost);
+            for (const uint32_t t : vertexTriangles[from]) {
+                if (!triangleAlive[t]) continue;
+                uint32_t* tri = &triangles[t * 3];
+                const bool degenerate = tri[0] == to || tri[1] == to || tri[2] == to;
+                if (degenerate) {
+                    triangleAlive[t] = false;
+                    liveTriangles--;
+                    continue;
+                }
+                for (uint32_t k = 0; k < 3; k++) {
+                    if (tri[k] == from) tri[k] = to;
+                }
+                vertexTriangles[to].push_back(t);
+            }
+            vertexTriangles[from].clear();
+
+            // costs of every edge touching the merged vertex changed
+            auto& around = vertexTriangles[to];
+            std::erase_if(around, [&](uint32_t t) { return !triangleAlive[t]; });
+            for (const uint32_t t : around) {
+                for (uint32_t k = 0; k < 3; k++) {
+                    const uint32_t v = triangles[t * 3 + k];
+                    if (v == to) continue;
+                    pushCollapse(v, to);
+                    pushCollapse(to, v);
+                }
+            }
+        }
+
+        Result result;
+        result.error = static_cast<float>(std::sqrt(worstCost));
+        result.indices.reserve(liveTriangles * 3);
+        result.sourceTriangles.reserve(liveTriangles);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            if (!triangleAlive[t]) continue;
+            result.indices.insert(result.indices.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+            result.sourceTriangles.push_back(t);
+        }
+        return result;
+    }
+}
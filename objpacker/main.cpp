@@ -10,25 +10,53 @@
 #include <glm/gtx/hash.hpp>
 #include <unordered_map>
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cfloat>
+#include <mutex>
+#include <sstream>
+#include <string.h>
+#include <thread>
+
+#include "../src/wgleng/rendering/MeshPack.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
 constexpr bool SmoothNormals = false;
+// lods stop once simplification would move the surface further than this fraction of the model's diagonal
+constexpr float LodMaxError = 0.02f;
+// or once a lod would keep more than this fraction of the previous lod's triangles
+constexpr float LodMinReduction = 0.8f;
+// bump whenever the output for the same input changes, invalidates every cache entry
+constexpr uint32_t PackerVersion = 1;
+
+// models are packed in parallel, each worker collects its log here and prints it once the model is done
+thread_local std::ostringstream fileLog;
 
 struct Material {
     glm::vec4 diffuse{1};
 };
 
+// vertices closer than this are welded into one
+constexpr float WeldPositionEpsilon = 0.0001f;
+constexpr float WeldNormalEpsilon = 0.001f;
+
 struct Vertex {
     glm::vec3 position{0};
     glm::vec3 normal{0};
     int32_t materialId{-1};
 
+    // equality and hash both work on the snapped grid so welding stays consistent
+    glm::ivec3 weldPosition() const { return glm::ivec3(glm::round(position / WeldPositionEpsilon)); }
+    glm::ivec3 weldNormal() const { return glm::ivec3(glm::round(normal / WeldNormalEpsilon)); }
+
 	bool operator==(const Vertex& other) const {
-		float epsilon = 0.0001f;
-		return 
-            glm::abs(position.x - other.position.x) < epsilon &&
-            glm::abs(normal.x - other.normal.x) < epsilon &&
+		return weldPosition() == other.weldPosition() &&
+            weldNormal() == other.weldNormal() &&
 			materialId == other.materialId;
 	}
 };
@@ -37,14 +65,21 @@ namespace std {
     struct hash<Vertex> {
         std::size_t operator()(const Vertex& v) const {
             std::size_t seed = 0;
-            seed ^= std::hash<glm::vec3>{}(v.position) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-            seed ^= std::hash<glm::vec3>{}(v.normal) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            seed ^= std::hash<glm::ivec3>{}(v.weldPosition()) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            seed ^= std::hash<glm::ivec3>{}(v.weldNormal()) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
             seed ^= std::hash<int32_t>{}(v.materialId) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
             return seed;
         }
     };
 }
 
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<Material> materials;
+    std::vector<uint32_t> indices; // all lods back to back
+    std::vector<WMeshLod> lods;
+};
+
 bool CreateDirectoryRecursive(std::string const & dirName, std::error_code & err) {
     err.clear();
     if (!std::filesystem::create_directories(dirName, err)) {
@@ -74,21 +109,79 @@ std::vector<std::filesystem::path> getFiles(const std::string& folderPath) {
     return files;
 }
 
-void embedVertices(const std::vector<Vertex>& vertices, const std::vector<Material>& materials,
-                    const std::vector<uint32_t>& indices, const std::filesystem::path& file) {
+std::string readFile(const std::filesystem::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) return {};
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+// only touches the file if its bytes differ, so unchanged headers do not trigger recompiles
+bool writeIfChanged(const std::filesystem::path& file, std::string_view data) {
     std::error_code err;
-    if (!CreateDirectoryRecursive(file.parent_path().string(), err)) {
-        // Report the error:
-        std::cout << "Failed to create directory for" << file << ": " << err.message() << std::endl;
-    }
-    std::ofstream out(file);
+    if (std::filesystem::file_size(file, err) == data.size() && !err && readFile(file) == data) return false;
+    std::ofstream out(file, std::ios::binary);
     if (!out.is_open()) {
-        std::cerr << "Failed to open file " << file << std::endl;
-        return;
+        fileLog << "Failed to open file " << file << std::endl;
+        return false;
+    }
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return true;
+}
+
+// fnv-1a 64
+uint64_t hashBytes(std::string_view data, uint64_t hash = 0xcbf29ce484222325) {
+    for (const char c : data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+// everything the output of a model depends on: the obj, its mtl libraries and the packer options
+uint64_t hashModel(const std::filesystem::path& file, const std::string& options) {
+    const std::string obj = readFile(file);
+    uint64_t hash = hashBytes(options + std::to_string(PackerVersion));
+    hash = hashBytes(obj, hash);
+    std::istringstream lines(obj);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (!line.starts_with("mtllib ")) continue;
+        std::string library = line.substr(7);
+        while (!library.empty() && std::isspace(static_cast<unsigned char>(library.back()))) library.pop_back();
+        hash = hashBytes(library, hash);
+        hash = hashBytes(readFile(file.parent_path() / library), hash);
     }
+    return hash;
+}
+
+// one "<hash> <model file name>" per line
+std::unordered_map<std::string, uint64_t> loadCache(const std::filesystem::path& file) {
+    std::unordered_map<std::string, uint64_t> cache;
+    std::istringstream lines(readFile(file));
+    uint64_t hash;
+    std::string name;
+    while (lines >> std::hex >> hash >> std::ws && std::getline(lines, name)) cache[name] = hash;
+    return cache;
+}
+void saveCache(const std::filesystem::path& file, const std::unordered_map<std::string, uint64_t>& cache) {
+    std::vector<std::pair<std::string, uint64_t>> entries(cache.begin(), cache.end());
+    std::sort(entries.begin(), entries.end());
+    std::string data;
+    for (const auto& [name, hash] : entries) data += std::format("{:016x} {}\n", hash, name);
+    writeIfChanged(file, data);
+}
 
+void embedVertices(const MeshData& mesh, const std::filesystem::path& file) {
+    const auto& [vertices, materials, indices, lods] = mesh;
+    std::error_code err;
+    if (!CreateDirectoryRecursive(file.parent_path().string(), err)) {
+        // Report the error:
+        fileLog << "Failed to create directory for" << file << ": " << err.message() << std::endl;
+    }
+    std::ostringstream out;
     out << "#pragma once\n\n";
     out << "#include <stdint.h>\n";
+    out << "#include <wgleng/rendering/MeshPack.h>\n";
     out << "#include <wgleng/rendering/Vertex.h>\n\n";
     // materials
     out << "constexpr uint32_t " << file.stem().string() << "_materialCount = " << materials.size() << ";\n";
@@ -116,8 +209,9 @@ void embedVertices(const std::vector<Vertex>& vertices, const std::vector<Materi
     }
     out << "\n};\n";
 
-    // indices
-    out << "constexpr uint32_t " << file.stem().string() << "_indexCount = " << indices.size() << ";\n";
+    // indices, _indexCount only covers lod 0. pass _lodIndexCount indices together with _lods to get every lod
+    out << "constexpr uint32_t " << file.stem().string() << "_indexCount = " << lods[0].indexCount << ";\n";
+    out << "constexpr uint32_t " << file.stem().string() << "_lodIndexCount = " << indices.size() << ";\n";
     out << "const uint32_t " << file.stem().string() << "_indices[] = {";
     counter = 0;
     for (const auto& index : indices) {
@@ -126,13 +220,91 @@ void embedVertices(const std::vector<Vertex>& vertices, const std::vector<Materi
     }
     out << "\n};\n";
 
-    out.close();
-    std::cout << "  Embedded vertices in " << file << std::endl;
+    // lods
+    out << "constexpr uint32_t " << file.stem().string() << "_lodCount = " << lods.size() << ";\n";
+    out << "const WMeshLod " << file.stem().string() << "_lods[] = {";
+    for (const auto& lod : lods) {
+        out << std::format("\n    {{{},{},{},0}},", lod.indexOffset, lod.indexCount, lod.error);
+    }
+    out << "\n};\n";
+
+    if (writeIfChanged(file, out.str())) fileLog << "  Embedded vertices in " << file << std::endl;
+    else fileLog << "  Unchanged " << file << std::endl;
 }
 
-void dumpVertices(const std::vector<Vertex>& vertices, const std::vector<Material>& materials,
-        const std::vector<uint32_t>& indices, const std::filesystem::path& file) {
-    std::cout << "TODO: dump vertices" << std::endl;
+void dumpVertices(const MeshData& mesh, const std::filesystem::path& file, bool quantize) {
+    const auto& [vertices, materials, indices, lods] = mesh;
+    std::error_code err;
+    if (!CreateDirectoryRecursive(file.parent_path().string(), err)) {
+        fileLog << "Failed to create directory for" << file << ": " << err.message() << std::endl;
+    }
+
+    glm::vec3 aabbMin{FLT_MAX};
+    glm::vec3 aabbMax{-FLT_MAX};
+    for (const auto& vertex : vertices) {
+        aabbMin = glm::min(aabbMin, vertex.position);
+        aabbMax = glm::max(aabbMax, vertex.position);
+    }
+    if (vertices.empty()) aabbMin = aabbMax = glm::vec3{0};
+
+    const bool smallIndices = vertices.size() <= 0x10000;
+    WMeshHeader header{
+        .magic = WMESH_MAGIC,
+        .version = WMESH_VERSION,
+        .vertexFormat = quantize ? WMeshVertexFormat::QUANTIZED : WMeshVertexFormat::FLOAT32,
+        .indexFormat = smallIndices ? WMeshIndexFormat::UINT16 : WMeshIndexFormat::UINT32,
+        .materialCount = static_cast<uint32_t>(materials.size()),
+        .vertexCount = static_cast<uint32_t>(vertices.size()),
+        .indexCount = static_cast<uint32_t>(indices.size()),
+        .lodCount = static_cast<uint32_t>(lods.size()),
+        // offsets are laid out below
+        .materialOffset = 0,
+        .lodOffset = 0,
+        .vertexOffset = 0,
+        .indexOffset = 0,
+        .aabbMin = {aabbMin.x, aabbMin.y, aabbMin.z},
+        .aabbMax = {aabbMax.x, aabbMax.y, aabbMax.z},
+    };
+    const auto align4 = [](uint32_t offset) { return (offset + 3) & ~3u; };
+    header.materialOffset = sizeof(WMeshHeader);
+    header.lodOffset = align4(header.materialOffset + header.materialCount * sizeof(Material));
+    header.vertexOffset = align4(header.lodOffset + header.lodCount * sizeof(WMeshLod));
+    header.indexOffset = align4(header.vertexOffset + header.vertexCount *
+        (quantize ? sizeof(WMeshQuantizedVertex) : sizeof(Vertex)));
+
+    std::vector<char> data(align4(header.indexOffset + header.indexCount * static_cast<uint32_t>(header.indexFormat)), 0);
+    memcpy(data.data(), &header, sizeof(header));
+    for (std::size_t i = 0; i < materials.size(); i++) {
+        memcpy(data.data() + header.materialOffset + i * sizeof(Material), &materials[i].diffuse, sizeof(Material));
+    }
+    memcpy(data.data() + header.lodOffset, lods.data(), lods.size() * sizeof(WMeshLod));
+    for (std::size_t i = 0; i < vertices.size(); i++) {
+        const auto& vertex = vertices[i];
+        if (quantize) {
+            const auto position = WMeshEncodePosition(vertex.position, aabbMin, aabbMax);
+            const auto normal = WMeshEncodeNormal(vertex.normal);
+            const WMeshQuantizedVertex packed{
+                .position = {position.x, position.y, position.z},
+                .materialId = vertex.materialId < 0 ? WMESH_NO_MATERIAL : static_cast<uint16_t>(vertex.materialId),
+                .normal = {normal.x, normal.y},
+            };
+            memcpy(data.data() + header.vertexOffset + i * sizeof(packed), &packed, sizeof(packed));
+        }
+        else {
+            memcpy(data.data() + header.vertexOffset + i * sizeof(Vertex), &vertex, sizeof(Vertex));
+        }
+    }
+    for (std::size_t i = 0; i < indices.size(); i++) {
+        if (smallIndices) {
+            const uint16_t index = static_cast<uint16_t>(indices[i]);
+            memcpy(data.data() + header.indexOffset + i * sizeof(index), &index, sizeof(index));
+        }
+        else {
+            memcpy(data.data() + header.indexOffset + i * sizeof(uint32_t), &indices[i], sizeof(uint32_t));
+        }
+    }
+    if (writeIfChanged(file, std::string_view(data.data(), data.size()))) fileLog << "  Packed " << data.size() << " bytes in " << file << std::endl;
+    else fileLog << "  Unchanged " << file << std::endl;
 }
 
 std::pair<std::vector<Vertex>, std::vector<uint32_t>> generateIndices(const std::vector<Vertex>& vertices) {
@@ -187,29 +359,90 @@ void generateSmoothNormals(std::vector<Vertex>& vertices) {
     }
 }
 
-std::tuple<std::vector<Vertex>, std::vector<Material>, std::vector<uint32_t>> loadModel(const std::filesystem::path& file) {
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+    const auto before = MeshOptimizer::AnalyzeCache(indices, vertexCount);
+
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (const auto& vertex : vertices) positions.push_back(vertex.position);
+    auto [cacheOrdered, clusters] = MeshOptimizer::Tipsify(indices, vertexCount);
+    indices = MeshOptimizer::SortClustersForOverdraw(cacheOrdered, clusters, positions);
+
+    const auto order = MeshOptimizer::OptimizeVertexFetch(indices, vertexCount);
+    std::vector<Vertex> newVertices;
+    newVertices.reserve(order.size());
+    for (const uint32_t i : order) newVertices.push_back(vertices[i]);
+    vertices = std::move(newVertices);
+
+    const auto after = MeshOptimizer::AnalyzeCache(indices, static_cast<uint32_t>(vertices.size()));
+    fileLog << std::format("  ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, {} clusters",
+        before.acmr, after.acmr, before.atvr, after.atvr, clusters.size()) << std::endl;
+}
+
+// normals, indexing and optimization for one lod given as a triangle soup, appended to the shared buffers
+void appendLod(MeshData& mesh, std::vector<Vertex> vertices, float error) {
+	if (SmoothNormals) generateSmoothNormals(vertices);
+	else generateFlatNormals(vertices);
+	auto [lodVertices, lodIndices] = generateIndices(vertices);
+    optimizeMesh(lodVertices, lodIndices);
+
+    const uint32_t baseVertex = static_cast<uint32_t>(mesh.vertices.size());
+    mesh.lods.push_back({
+        .indexOffset = static_cast<uint32_t>(mesh.indices.size()),
+        .indexCount = static_cast<uint32_t>(lodIndices.size()),
+        .error = error,
+        .reserved = 0,
+    });
+    mesh.vertices.insert(mesh.vertices.end(), lodVertices.begin(), lodVertices.end());
+    for (const uint32_t index : lodIndices) mesh.indices.push_back(baseVertex + index);
+}
+
+std::vector<Vertex> triangleSoup(const MeshData& mesh, uint32_t lod) {
+    std::vector<Vertex> vertices;
+    const auto& range = mesh.lods[lod];
+    vertices.reserve(range.indexCount);
+    for (uint32_t i = 0; i < range.indexCount; i++) vertices.push_back(mesh.vertices[mesh.indices[range.indexOffset + i]]);
+    return vertices;
+}
+
+// merges corners by position only, so flat shaded faces become connected for simplification
+std::pair<std::vector<glm::vec3>, std::vector<uint32_t>> weldPositions(const std::vector<Vertex>& vertices) {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    indices.reserve(vertices.size());
+    std::unordered_map<glm::ivec3, uint32_t> positionMap;
+    for (const auto& vertex : vertices) {
+        const auto [it, inserted] = positionMap.try_emplace(vertex.weldPosition(), static_cast<uint32_t>(positions.size()));
+        if (inserted) positions.push_back(vertex.position);
+        indices.push_back(it->second);
+    }
+    return {std::move(positions), std::move(indices)};
+}
+
+MeshData loadModel(const std::filesystem::path& file) {
     // parse file
-    std::cout << "File: " << file << std::endl;
+    fileLog << "File: " << file << std::endl;
     tinyobj::ObjReader reader;
     tinyobj::ObjReaderConfig config;
     config.triangulate = true;
     if (!reader.ParseFromFile(file.string(), config)) {
         if (!reader.Error().empty()) {
-            std::cerr << "  Error: " << reader.Error() << std::endl;
+            fileLog << "  Error: " << reader.Error() << std::endl;
         }
         return {};
     }
     if (!reader.Warning().empty()) {
-        std::cerr << "  Warning: " << reader.Warning() << std::endl;
+        fileLog << "  Warning: " << reader.Warning() << std::endl;
     }
 
     const auto& attrib = reader.GetAttrib();
-    std::cout << "  Shape count: " << reader.GetShapes().size() << std::endl;
-    std::cout << "  Vertex count: " << attrib.vertices.size() << std::endl;
-    std::cout << "  Normal count: " << attrib.normals.size() << std::endl;
-    std::cout << "  Material count: " << reader.GetMaterials().size() << std::endl;
+    fileLog << "  Shape count: " << reader.GetShapes().size() << std::endl;
+    fileLog << "  Vertex count: " << attrib.vertices.size() << std::endl;
+    fileLog << "  Normal count: " << attrib.normals.size() << std::endl;
+    fileLog << "  Material count: " << reader.GetMaterials().size() << std::endl;
 
-    std::cout << "  Loading vertices ..." << std::endl;
+    fileLog << "  Loading vertices ..." << std::endl;
     std::vector<Vertex> vertices;
     for (const auto& shape : reader.GetShapes()) {
         auto& mesh = shape.mesh;
@@ -228,21 +461,13 @@ std::tuple<std::vector<Vertex>, std::vector<Material>, std::vector<uint32_t>> lo
             //        attrib.normals[3 * index.normal_index + 2]
             //    };
             //}
-            int32_t materialId = faceId++ / 3;
+            const std::size_t materialId = faceId++ / 3;
             if (materialId < mesh.material_ids.size()) vertex.materialId = mesh.material_ids[materialId];
             vertices.push_back(vertex);
         }
     }
 
-    std::cout << "  Creating normals ..." << std::endl;
-	if (SmoothNormals) generateSmoothNormals(vertices);
-	else generateFlatNormals(vertices);
-
-    std::cout << "  Creating indices ..." << std::endl;
-	auto [newVertices, indices] = generateIndices(vertices);
-	vertices = std::move(newVertices);
-
-    std::cout << "  Loading materials ..." << std::endl;
+    fileLog << "  Loading materials ..." << std::endl;
     std::vector<Material> materials;
     for (const auto& material : reader.GetMaterials()) {
         materials.push_back({
@@ -250,27 +475,128 @@ std::tuple<std::vector<Vertex>, std::vector<Material>, std::vector<uint32_t>> lo
         });
     }
 
-    std::cout << "  Loaded " << vertices.size() << " vertices, " << indices.size() << " indices." << std::endl;
-    return {std::move(vertices), std::move(materials), std::move(indices)};
+    MeshData mesh;
+    mesh.materials = std::move(materials);
+    fileLog << "  Building lod 0 ..." << std::endl;
+    appendLod(mesh, std::move(vertices), 0);
+
+    // lods are simplified from the full mesh, halving the triangle count each step
+    const auto [positions, positionIndices] = weldPositions(triangleSoup(mesh, 0));
+    std::vector<int32_t> triangleMaterials;
+    triangleMaterials.reserve(positionIndices.size() / 3);
+    for (uint32_t i = 0; i < mesh.lods[0].indexCount; i += 3) triangleMaterials.push_back(mesh.vertices[mesh.indices[i]].materialId);
+    glm::vec3 aabbMin{FLT_MAX};
+    glm::vec3 aabbMax{-FLT_MAX};
+    for (const auto& position : positions) {
+        aabbMin = glm::min(aabbMin, position);
+        aabbMax = glm::max(aabbMax, position);
+    }
+    const float maxError = glm::length(aabbMax - aabbMin) * LodMaxError;
+    uint32_t previousTriangles = mesh.lods[0].indexCount / 3;
+    for (uint32_t lod = 1; lod < WMESH_MAX_LODS; lod++) {
+        const uint32_t target = mesh.lods[0].indexCount / 3 >> lod;
+        const auto simplified = MeshSimplifier::Simplify(positions, positionIndices, triangleMaterials, target, maxError);
+        const uint32_t triangles = static_cast<uint32_t>(simplified.sourceTriangles.size());
+        if (triangles == 0 || triangles > previousTriangles * LodMinReduction) break;
+        previousTriangles = triangles;
+
+        fileLog << "  Building lod " << lod << " ..." << std::endl;
+        std::vector<Vertex> lodVertices;
+        lodVertices.reserve(simplified.indices.size());
+        for (uint32_t i = 0; i < simplified.indices.size(); i++) {
+            lodVertices.push_back({
+                .position = positions[simplified.indices[i]],
+                .materialId = triangleMaterials[simplified.sourceTriangles[i / 3]]
+            });
+        }
+        appendLod(mesh, std::move(lodVertices), simplified.error);
+    }
+
+    for (uint32_t lod = 0; lod < mesh.lods.size(); lod++) {
+        fileLog << std::format("  Lod {}: {} triangles, error {:.5f}", lod, mesh.lods[lod].indexCount / 3, mesh.lods[lod].error) << std::endl;
+    }
+    fileLog << "  Loaded " << mesh.vertices.size() << " vertices, " << mesh.indices.size() << " indices." << std::endl;
+    return mesh;
 }
 
-int main() {
+// objpacker            embed models/*.obj as headers in src/meshes
+// objpacker --wmesh    write binary .wmesh packs to assets/meshes instead, see MeshImpl::LoadPacked
+//           --float    keep full precision vertices in .wmesh packs
+//           --force    repack models even if they did not change since the last run
+//           -j <n>     worker threads, defaults to the core count
+int main(int argc, char** argv) {
+    bool binary = false;
+    bool quantize = true;
+    bool force = false;
+    uint32_t jobs = std::max(std::thread::hardware_concurrency(), 1u);
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--wmesh") binary = true;
+        else if (arg == "--float") quantize = false;
+        else if (arg == "--force") force = true;
+        else if (arg == "-j" && i + 1 < argc) jobs = std::max(std::stoi(argv[++i]), 1);
+        else std::cerr << "Unknown argument " << arg << std::endl;
+    }
     std::string inFolder = "models";
-    std::string outFolder = "src/meshes";
+    std::string outFolder = binary ? "assets/meshes" : "src/meshes";
+    const std::string options = std::format("{}{}{}", binary ? "wmesh" : "header", quantize ? "q" : "f", SmoothNormals ? "s" : "");
 
-    auto files = getFiles(inFolder);
+    std::vector<std::filesystem::path> files;
+    for (auto& file : getFiles(inFolder)) {
+        if (file.extension() == ".obj") files.push_back(std::move(file));
+    }
     std::cout << std::endl;
-    for (const auto& file : files) {
-		if (file.extension() != ".obj") continue;
 
-        auto&& [vertices, materials, indices] = loadModel(file);
-        if (vertices.empty()) {
-            std::cerr << "Failed to load model " << file << std::endl;
-            continue;
+    const auto cachePath = std::filesystem::path(outFolder) / ".objpacker-cache";
+    auto cache = loadCache(cachePath);
+    std::mutex mutex; // guards cache and std::cout
+    std::atomic<std::size_t> nextFile{0};
+    std::atomic<uint32_t> packedCount{0};
+    std::atomic<uint32_t> failedCount{0};
+
+    const auto worker = [&]() {
+        for (std::size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            const auto& file = files[i];
+            fileLog.str({});
+            auto outPath = std::filesystem::path(outFolder) / file.filename();
+            outPath.replace_extension(binary ? ".wmesh" : ".h");
+
+            const uint64_t hash = hashModel(file, options);
+            const std::string name = file.filename().string();
+            {
+                std::lock_guard lock(mutex);
+                const auto it = cache.find(name);
+                if (!force && it != cache.end() && it->second == hash && std::filesystem::exists(outPath)) {
+                    std::cout << "Skipping unchanged " << file << std::endl;
+                    continue;
+                }
+            }
+
+            const auto mesh = loadModel(file);
+            bool failed = mesh.vertices.empty();
+            if (!failed) {
+                if (binary) dumpVertices(mesh, outPath, quantize);
+                else embedVertices(mesh, outPath);
+                packedCount++;
+            }
+            else failedCount++;
+
+            std::lock_guard lock(mutex);
+            std::cout << fileLog.str();
+            if (failed) {
+                std::cerr << "Failed to load model " << file << std::endl;
+                cache.erase(name);
+            }
+            else cache[name] = hash;
         }
-        auto outPath = std::filesystem::path(outFolder) / file.filename();
-        outPath.replace_extension(".h");
-        embedVertices(vertices, materials, indices, outPath);
-    }
-    return 0;
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < std::min<std::size_t>(jobs, files.size()); i++) threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads) thread.join();
+
+    std::error_code err;
+    if (CreateDirectoryRecursive(outFolder, err)) saveCache(cachePath, cache);
+    std::cout << std::format("Packed {} of {} models, {} failed", packedCount.load(), files.size(), failedCount.load()) << std::endl;
+    return failedCount > 0 ? 1 : 0;
 }
@@ -10,17 +10,19 @@
 #include "EntityFlags.h"
 
 // may not be present
+// changes to mesh, position, rotation or scale require registry.patch<MeshComponent>() to be rendered
 struct MeshComponent {
 	Mesh mesh;
 	glm::vec3 position;
 	glm::vec3 rotation;
 	glm::vec3 scale{1};
-	uint8_t highlightId{0};        // resets every frame
-	bool hidden = false;           // resets every frame
+	uint8_t highlightId{0};        // resets every frame if set through MeshInstanceStore::Highlight
+	bool hidden = false;           // resets every frame if set through MeshInstanceStore::Hide
 	bool hiddenPersistent = false; // needs to be reset manually
 };
 
 // may not be present
+// changes require registry.patch<TransformComponent>() to be rendered
 struct TransformComponent {
 	glm::vec3 position;
 	glm::vec3 rotation;
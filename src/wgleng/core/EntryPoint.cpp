@@ -1,6 +1,8 @@
 #include "EntryPoint.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "../io/Input.h"
 #include "../rendering/Debug.h"
@@ -15,13 +17,7 @@
 Context* ctx = nullptr;
 bool isHidden = false;
 
-void mainLoop() {
-	// timing
-	static auto lastTime = TimePoint();
-	const auto now = TimePoint();
-	const auto dt = now - lastTime;
-	lastTime = now;
-
+void runFrame(TimeDuration dt) {
 	// start imgui frame
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplSDL2_NewFrame();
@@ -46,6 +42,15 @@ void mainLoop() {
 	Metrics::MeasureDurationStop(Metric::FRAME_TOTAL);
 	Metrics::MeasureDurationStart(Metric::FRAME_TOTAL);
 }
+void mainLoop() {
+	// timing
+	static auto lastTime = TimePoint();
+	const auto now = TimePoint();
+	const auto dt = now - lastTime;
+	lastTime = now;
+
+	runFrame(dt);
+}
 void initialize() {
 	// create context
 	if (ctx != nullptr) {
@@ -76,6 +81,30 @@ void deinitialize() {
 	Text::Deinit();
 }
 
+#ifdef WGLENG_HEADLESS
+bool I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_start() {
+	initialize();
+	return ctx != nullptr;
+}
+void I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_runFrames(uint32_t count, TimeDuration dt) {
+	if (ctx == nullptr) return;
+	for (uint32_t i = 0; i < count; i++) runFrame(dt);
+}
+void I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_stop() {
+	if (ctx == nullptr) return;
+	deinitialize();
+}
+int I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_headlessMain(int argc, char** argv) {
+	uint32_t frames = 600;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = static_cast<uint32_t>(atoi(argv[++i]));
+	}
+	if (!I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_start()) return 1;
+	I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_runFrames(frames, 16667us);
+	I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_stop();
+	return 0;
+}
+#else
 // embind stuff
 bool I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_start() {
 	initialize();
@@ -105,3 +134,4 @@ void I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_setHidden(bool hidden) {
 		emscripten_set_main_loop(mainLoop, 0, 1);
 	}
 }
+#endif
@@ -1,7 +1,9 @@
 #pragma once
 
+#ifndef WGLENG_HEADLESS
 #include <emscripten.h>
 #include <emscripten/bind.h>
+#endif
 
 #include "../core/Context.h"
 #include "../util/Timer.h"
@@ -10,6 +12,18 @@ void onInit(Context* ctx);
 void onDeinit(Context* ctx);
 void onTick(Context* ctx, TimeDuration dt);
 
+#ifdef WGLENG_HEADLESS
+// runs the engine without a window for a fixed amount of frames, see headless/GLRecorder.h
+//     --frames N   frames to run (default 600)
+int I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_headlessMain(int argc, char** argv);
+// drive the engine manually, e.g. from benchmarks. frames use a fixed dt.
+bool I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_start();
+void I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_runFrames(uint32_t count, TimeDuration dt);
+void I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_stop();
+#define WGLENG_INIT_ENGINE int main(int argc, char** argv) { \
+        return I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_headlessMain(argc, argv); \
+    }
+#else
 // export functions to JS
 bool I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_start();
 void I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_stop();
@@ -20,4 +34,5 @@ void I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_setHidden(bool hidden);
         emscripten::function("stop", &I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_stop); \
         emscripten::function("setFocused", &I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_setFocused); \
         emscripten::function("setHidden", &I_N_T_E_R_N_A_L_wgleng_internal_entrypoint_setHidden); \
-    }
\ No newline at end of file
+    }
+#endif
@@ -3,7 +3,7 @@
 #include "Components.h"
 
 Scene::Scene()
-    : m_sceneBuilder(registry, m_physicsWorld) {
+    : m_sceneBuilder(registry, m_physicsWorld), m_meshInstances(registry) {
 	registry.on_construct<entt::entity>().connect<OnConstructEntity>();
     registry.on_destroy<RigidBodyComponent>().connect<OnDestroyRigidBody>();
 	registry.on_construct<RigidBodyComponent>().connect<OnConstructRigidBody>();
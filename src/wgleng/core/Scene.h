@@ -4,6 +4,7 @@
 #include <memory>
 #include <vector>
 
+#include "../rendering/MeshInstances.h"
 #include "../rendering/Text.h"
 #include "../util/SceneBuilder.h"
 #include "../util/Timer.h"
@@ -25,6 +26,7 @@ public:
 	const std::shared_ptr<Camera>& GetCamera() const { return m_camera; }
 
 	const PhysicsWorld& GetPhysicsWorld() const { return m_physicsWorld; }
+	MeshInstanceStore& GetMeshInstances() { return m_meshInstances; }
 
 	void AddText(const std::weak_ptr<DrawableText>& text) {
 		m_drawableTexts.push_back(text);
@@ -43,6 +45,7 @@ protected:
 
 private:
 	std::vector<std::weak_ptr<DrawableText>> m_drawableTexts;
+	MeshInstanceStore m_meshInstances;
 
 private:
 	static void OnConstructEntity(entt::registry& reg, entt::entity entity);
@@ -0,0 +1,413 @@
+#include "GLRecorder.h"
+
+#include "../rendering/GLExtensions.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+namespace {
+	constexpr uint32_t maxPrintedErrors = 8;
+
+	struct RecorderState {
+		GLRecorder::FrameStats current;
+		GLRecorder::FrameStats last;
+		GLRecorder::FrameStats total;
+		std::vector<GLRecorder::DrawCall> drawCalls;
+		std::vector<GLRecorder::DrawCall> lastDrawCalls;
+		uint32_t frameCount = 0;
+
+		GLuint nextName = 1;
+		GLuint program = 0;
+		GLuint vertexArray = 0;
+		GLuint drawFramebuffer = 0;
+		GLuint readFramebuffer = 0;
+		GLenum activeTexture = GL_TEXTURE0;
+		GLenum cullFace = GL_BACK;
+		GLenum depthFunc = GL_LESS;
+		GLint viewport[4] = {0, 0, 0, 0};
+		std::unordered_map<GLenum, GLuint> buffers;
+		std::unordered_map<uint64_t, GLuint> textures; // (unit << 32) | target
+		std::unordered_map<GLenum, bool> capabilities;
+		std::unordered_map<GLuint, GLenum> queryTargets; // target of the last glBeginQuery
+		// WebGL2 fixes the type of a buffer at its first bind: element array or other data
+		std::unordered_map<GLuint, bool> elementArrayBuffers;
+		GLenum error = GL_NO_ERROR;
+		uint32_t errorCount = 0;
+	};
+	RecorderState& state() {
+		static RecorderState s;
+		return s;
+	}
+
+	template <typename T>
+	void setState(T& current, const T& value) {
+		auto& stats = state().current;
+		stats.stateChanges++;
+		if (current == value) stats.redundantStateChanges++;
+		current = value;
+	}
+
+	void accumulate(GLRecorder::FrameStats& total, const GLRecorder::FrameStats& frame) {
+		total.drawCalls += frame.drawCalls;
+		total.instances += frame.instances;
+		total.vertices += frame.vertices;
+		total.bufferUploads += frame.bufferUploads;
+		total.bufferUploadBytes += frame.bufferUploadBytes;
+		total.textureUploads += frame.textureUploads;
+		total.textureUploadBytes += frame.textureUploadBytes;
+		total.clears += frame.clears;
+		total.stateChanges += frame.stateChanges;
+		total.redundantStateChanges += frame.redundantStateChanges;
+	}
+
+	void recordDraw(GLenum mode, GLsizei count, GLsizei instanceCount, uint64_t vertices) {
+		auto& s = state();
+		s.current.drawCalls++;
+		s.current.instances += instanceCount;
+		s.current.vertices += vertices;
+		s.drawCalls.push_back({
+			.mode = mode,
+			.count = count,
+			.instanceCount = instanceCount,
+			.program = s.program,
+			.vertexArray = s.vertexArray,
+			.framebuffer = s.drawFramebuffer
+		});
+	}
+
+	void recordDraw(GLenum mode, GLsizei count, GLsizei instanceCount) {
+		recordDraw(mode, count, instanceCount, static_cast<uint64_t>(count) * instanceCount);
+	}
+
+	void recordError(GLenum error, const char* message) {
+		auto& s = state();
+		if (s.error == GL_NO_ERROR) s.error = error;
+		if (s.errorCount++ < maxPrintedErrors) fprintf(stderr, "GLRecorder: %s\n", message);
+	}
+
+	// copy targets take both buffer types, every other bind has to match the type of the first one
+	bool checkBufferType(GLenum target, GLuint buffer) {
+		if (buffer == 0) return true;
+		const bool elementArray = target == GL_ELEMENT_ARRAY_BUFFER;
+		const auto [it, first] = state().elementArrayBuffers.try_emplace(buffer, elementArray);
+		if (first || target == GL_COPY_READ_BUFFER || target == GL_COPY_WRITE_BUFFER || it->second == elementArray) return true;
+		recordError(GL_INVALID_OPERATION, elementArray ? "element array bind of a buffer holding other data" : "bind of an element array buffer to another target");
+		return false;
+	}
+
+	void recordBufferUpload(const void* data, GLsizeiptr size) {
+		if (!data) return;
+		state().current.bufferUploads++;
+		state().current.bufferUploadBytes += size;
+	}
+
+	uint64_t pixelSize(GLenum format, GLenum type) {
+		switch (type) {
+			case GL_UNSIGNED_SHORT_5_6_5:
+			case GL_UNSIGNED_SHORT_4_4_4_4:
+			case GL_UNSIGNED_SHORT_5_5_5_1:
+				return 2;
+			case GL_UNSIGNED_INT_2_10_10_10_REV:
+			case GL_UNSIGNED_INT_10F_11F_11F_REV:
+			case GL_UNSIGNED_INT_5_9_9_9_REV:
+			case GL_UNSIGNED_INT_24_8:
+				return 4;
+			case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+				return 8;
+			default:
+				break;
+		}
+		uint64_t componentSize = 1;
+		switch (type) {
+			case GL_SHORT:
+			case GL_UNSIGNED_SHORT:
+			case GL_HALF_FLOAT:
+				componentSize = 2;
+				break;
+			case GL_INT:
+			case GL_UNSIGNED_INT:
+			case GL_FLOAT:
+				componentSize = 4;
+				break;
+			default:
+				break;
+		}
+		switch (format) {
+			case GL_RG:
+			case GL_RG_INTEGER:
+			case GL_LUMINANCE_ALPHA:
+				return componentSize * 2;
+			case GL_RGB:
+			case GL_RGB_INTEGER:
+				return componentSize * 3;
+			case GL_RGBA:
+			case GL_RGBA_INTEGER:
+				return componentSize * 4;
+			default:
+				return componentSize;
+		}
+	}
+
+	void recordTextureUpload(const void* pixels, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type) {
+		if (!pixels) return;
+		if (state().buffers[GL_PIXEL_UNPACK_BUFFER] != 0) return; // copy from a buffer, counted when it was uploaded
+		state().current.textureUploads++;
+		state().current.textureUploadBytes += static_cast<uint64_t>(width) * height * depth * pixelSize(format, type);
+	}
+
+	void writeEmptyLog(GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+		if (length) *length = 0;
+		if (infoLog && bufSize > 0) infoLog[0] = '\0';
+	}
+
+	void generateNames(GLsizei n, GLuint* names) {
+		for (GLsizei i = 0; i < n; i++) names[i] = state().nextName++;
+	}
+}
+
+void GLRecorder::EndFrame() {
+	auto& s = state();
+	accumulate(s.total, s.current);
+	s.last = s.current;
+	s.current = {};
+	s.lastDrawCalls.swap(s.drawCalls);
+	s.drawCalls.clear();
+	s.frameCount++;
+}
+
+void GLRecorder::Reset() {
+	auto& s = state();
+	s.current = {};
+	s.last = {};
+	s.total = {};
+	s.drawCalls.clear();
+	s.lastDrawCalls.clear();
+	s.frameCount = 0;
+}
+
+const GLRecorder::FrameStats& GLRecorder::GetCurrentFrameStats() {
+	return state().current;
+}
+const GLRecorder::FrameStats& GLRecorder::GetLastFrameStats() {
+	return state().last;
+}
+const GLRecorder::FrameStats& GLRecorder::GetTotalStats() {
+	return state().total;
+}
+const std::vector<GLRecorder::DrawCall>& GLRecorder::GetLastFrameDrawCalls() {
+	return state().lastDrawCalls;
+}
+uint32_t GLRecorder::GetFrameCount() {
+	return state().frameCount;
+}
+uint32_t GLRecorder::GetErrorCount() {
+	return state().errorCount;
+}
+
+// =============================================================================
+// GLES3 entry points
+// =============================================================================
+
+// objects
+void glGenBuffers(GLsizei n, GLuint* buffers) { generateNames(n, buffers); }
+void glGenTextures(GLsizei n, GLuint* textures) { generateNames(n, textures); }
+void glGenVertexArrays(GLsizei n, GLuint* arrays) { generateNames(n, arrays); }
+void glGenFramebuffers(GLsizei n, GLuint* framebuffers) { generateNames(n, framebuffers); }
+void glDeleteBuffers(GLsizei n, const GLuint* buffers) {
+	for (GLsizei i = 0; i < n; i++) state().elementArrayBuffers.erase(buffers[i]);
+}
+void glDeleteTextures(GLsizei /*n*/, const GLuint* /*textures*/) {}
+void glDeleteVertexArrays(GLsizei /*n*/, const GLuint* /*arrays*/) {}
+void glDeleteFramebuffers(GLsizei /*n*/, const GLuint* /*framebuffers*/) {}
+
+// shaders
+GLuint glCreateShader(GLenum /*type*/) { return state().nextName++; }
+GLuint glCreateProgram() { return state().nextName++; }
+void glDeleteShader(GLuint /*shader*/) {}
+void glDeleteProgram(GLuint /*program*/) {}
+void glShaderSource(GLuint /*shader*/, GLsizei /*count*/, const GLchar* const* /*string*/, const GLint* /*length*/) {}
+void glCompileShader(GLuint /*shader*/) {}
+void glAttachShader(GLuint /*program*/, GLuint /*shader*/) {}
+void glLinkProgram(GLuint /*program*/) {}
+void glGetAttachedShaders(GLuint /*program*/, GLsizei /*maxCount*/, GLsizei* count, GLuint* /*shaders*/) {
+	if (count) *count = 0;
+}
+void glGetShaderiv(GLuint /*shader*/, GLenum pname, GLint* params) {
+	*params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+void glGetProgramiv(GLuint /*program*/, GLenum pname, GLint* params) {
+	*params = pname == GL_LINK_STATUS ? GL_TRUE : 0;
+}
+void glGetShaderInfoLog(GLuint /*shader*/, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+	writeEmptyLog(bufSize, length, infoLog);
+}
+void glGetProgramInfoLog(GLuint /*program*/, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+	writeEmptyLog(bufSize, length, infoLog);
+}
+GLint glGetUniformLocation(GLuint /*program*/, const GLchar* /*name*/) { return static_cast<GLint>(state().nextName++); }
+GLuint glGetUniformBlockIndex(GLuint /*program*/, const GLchar* /*uniformBlockName*/) { return state().nextName++; }
+void glUniformBlockBinding(GLuint /*program*/, GLuint /*uniformBlockIndex*/, GLuint /*uniformBlockBinding*/) {}
+void glUniform1i(GLint /*location*/, GLint /*v0*/) { state().current.stateChanges++; }
+void glUniform4iv(GLint /*location*/, GLsizei /*count*/, const GLint* /*value*/) { state().current.stateChanges++; }
+void glUniform3fv(GLint /*location*/, GLsizei /*count*/, const GLfloat* /*value*/) { state().current.stateChanges++; }
+void glUniform4fv(GLint /*location*/, GLsizei /*count*/, const GLfloat* /*value*/) { state().current.stateChanges++; }
+
+// buffers
+void glBindBuffer(GLenum target, GLuint buffer) {
+	if (checkBufferType(target, buffer)) setState(state().buffers[target], buffer);
+}
+void glBindBufferBase(GLenum target, GLuint /*index*/, GLuint buffer) {
+	if (!checkBufferType(target, buffer)) return;
+	state().current.stateChanges++;
+	state().buffers[target] = buffer;
+}
+void glBindBufferRange(GLenum target, GLuint /*index*/, GLuint buffer, GLintptr /*offset*/, GLsizeiptr /*size*/) {
+	if (!checkBufferType(target, buffer)) return;
+	state().current.stateChanges++;
+	state().buffers[target] = buffer;
+}
+void glBufferData(GLenum /*target*/, GLsizeiptr size, const void* data, GLenum /*usage*/) { recordBufferUpload(data, size); }
+void glBufferSubData(GLenum /*target*/, GLintptr /*offset*/, GLsizeiptr size, const void* data) { recordBufferUpload(data, size); }
+void glCopyBufferSubData(GLenum /*readTarget*/, GLenum /*writeTarget*/, GLintptr /*readOffset*/, GLintptr /*writeOffset*/, GLsizeiptr /*size*/) {}
+// nothing is rasterized, read backs are all zero
+void glGetBufferSubData(GLenum /*target*/, GLintptr /*offset*/, GLsizeiptr size, void* data) { memset(data, 0, size); }
+
+// sync objects, the recorder has no gpu timeline so fences are signaled right away
+GLsync glFenceSync(GLenum /*condition*/, GLbitfield /*flags*/) { return reinterpret_cast<GLsync>(static_cast<uintptr_t>(state().nextName++)); }
+GLenum glClientWaitSync(GLsync /*sync*/, GLbitfield /*flags*/, GLuint64 /*timeout*/) { return GL_ALREADY_SIGNALED; }
+void glDeleteSync(GLsync /*sync*/) {}
+
+// vertex arrays
+void glBindVertexArray(GLuint array) { setState(state().vertexArray, array); }
+void glEnableVertexAttribArray(GLuint /*index*/) {}
+void glVertexAttribPointer(GLuint /*index*/, GLint /*size*/, GLenum /*type*/, GLboolean /*normalized*/, GLsizei /*stride*/, const void* /*pointer*/) {}
+void glVertexAttribIPointer(GLuint /*index*/, GLint /*size*/, GLenum /*type*/, GLsizei /*stride*/, const void* /*pointer*/) {}
+void glVertexAttrib4f(GLuint /*index*/, GLfloat /*x*/, GLfloat /*y*/, GLfloat /*z*/, GLfloat /*w*/) { state().current.stateChanges++; }
+
+// textures
+void glActiveTexture(GLenum texture) { setState(state().activeTexture, texture); }
+void glBindTexture(GLenum target, GLuint texture) {
+	auto& s = state();
+	setState(s.textures[(static_cast<uint64_t>(s.activeTexture) << 32) | target], texture);
+}
+void glTexParameteri(GLenum /*target*/, GLenum /*pname*/, GLint /*param*/) {}
+void glPixelStorei(GLenum /*pname*/, GLint /*param*/) {}
+void glTexImage2D(GLenum /*target*/, GLint /*level*/, GLint /*internalformat*/, GLsizei width, GLsizei height, GLint /*border*/, GLenum format, GLenum type, const void* pixels) {
+	recordTextureUpload(pixels, width, height, 1, format, type);
+}
+void glTexImage3D(GLenum /*target*/, GLint /*level*/, GLint /*internalformat*/, GLsizei width, GLsizei height, GLsizei depth, GLint /*border*/, GLenum format, GLenum type, const void* pixels) {
+	recordTextureUpload(pixels, width, height, depth, format, type);
+}
+void glTexSubImage2D(GLenum /*target*/, GLint /*level*/, GLint /*xoffset*/, GLint /*yoffset*/, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels) {
+	recordTextureUpload(pixels, width, height, 1, format, type);
+}
+
+// framebuffers
+void glBindFramebuffer(GLenum target, GLuint framebuffer) {
+	auto& s = state();
+	if (target == GL_READ_FRAMEBUFFER) setState(s.readFramebuffer, framebuffer);
+	else if (target == GL_DRAW_FRAMEBUFFER) setState(s.drawFramebuffer, framebuffer);
+	else {
+		setState(s.drawFramebuffer, framebuffer);
+		s.readFramebuffer = framebuffer;
+	}
+}
+GLenum glCheckFramebufferStatus(GLenum /*target*/) { return GL_FRAMEBUFFER_COMPLETE; }
+void glFramebufferTexture2D(GLenum /*target*/, GLenum /*attachment*/, GLenum /*textarget*/, GLuint /*texture*/, GLint /*level*/) {}
+void glFramebufferTextureLayer(GLenum /*target*/, GLenum /*attachment*/, GLuint /*texture*/, GLint /*level*/, GLint /*layer*/) {}
+void glDrawBuffers(GLsizei /*n*/, const GLenum* /*bufs*/) { state().current.stateChanges++; }
+void glReadBuffer(GLenum /*src*/) { state().current.stateChanges++; }
+void glReadPixels(GLint /*x*/, GLint /*y*/, GLsizei /*width*/, GLsizei /*height*/, GLenum /*format*/, GLenum /*type*/, void* /*pixels*/) {}
+void glBlitFramebuffer(GLint /*srcX0*/, GLint /*srcY0*/, GLint /*srcX1*/, GLint /*srcY1*/, GLint /*dstX0*/, GLint /*dstY0*/, GLint /*dstX1*/, GLint /*dstY1*/, GLbitfield /*mask*/, GLenum /*filter*/) {}
+
+// state
+void glUseProgram(GLuint program) { setState(state().program, program); }
+void glEnable(GLenum cap) { setState(state().capabilities[cap], true); }
+void glDisable(GLenum cap) { setState(state().capabilities[cap], false); }
+void glCullFace(GLenum mode) { setState(state().cullFace, mode); }
+void glDepthFunc(GLenum func) { setState(state().depthFunc, func); }
+void glDepthMask(GLboolean /*flag*/) { state().current.stateChanges++; }
+void glColorMask(GLboolean /*red*/, GLboolean /*green*/, GLboolean /*blue*/, GLboolean /*alpha*/) { state().current.stateChanges++; }
+void glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	auto& s = state();
+	s.current.stateChanges++;
+	const GLint viewport[4] = {x, y, width, height};
+	if (memcmp(s.viewport, viewport, sizeof(viewport)) == 0) s.current.redundantStateChanges++;
+	memcpy(s.viewport, viewport, sizeof(viewport));
+}
+void glScissor(GLint /*x*/, GLint /*y*/, GLsizei /*width*/, GLsizei /*height*/) { state().current.stateChanges++; }
+void glClearColor(GLfloat /*red*/, GLfloat /*green*/, GLfloat /*blue*/, GLfloat /*alpha*/) { state().current.stateChanges++; }
+void glGetIntegerv(GLenum pname, GLint* data) {
+	const auto& s = state();
+	switch (pname) {
+		case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT: *data = 256; break;
+		case GL_MAX_UNIFORM_BLOCK_SIZE: *data = 16384; break;
+		case GL_MAX_UNIFORM_BUFFER_BINDINGS: *data = 24; break;
+		case GL_MAX_TEXTURE_SIZE: *data = 4096; break;
+		case GL_MAX_ARRAY_TEXTURE_LAYERS: *data = 256; break;
+		case GL_MAX_DRAW_BUFFERS: *data = 4; break;
+		case GL_MAX_COLOR_ATTACHMENTS: *data = 4; break;
+		case GL_MAX_TEXTURE_IMAGE_UNITS: *data = 16; break;
+		case GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS: *data = 32; break;
+		case GL_MAX_VERTEX_ATTRIBS: *data = 16; break;
+		case GL_CURRENT_PROGRAM: *data = static_cast<GLint>(s.program); break;
+		case GL_VERTEX_ARRAY_BINDING: *data = static_cast<GLint>(s.vertexArray); break;
+		case GL_DRAW_FRAMEBUFFER_BINDING: *data = static_cast<GLint>(s.drawFramebuffer); break;
+		case GL_VIEWPORT: memcpy(data, s.viewport, sizeof(s.viewport)); break;
+		default: *data = 0; break;
+	}
+}
+GLenum glGetError() {
+	const GLenum error = state().error;
+	state().error = GL_NO_ERROR;
+	return error;
+}
+const GLubyte* glGetString(GLenum name) {
+	switch (name) {
+		case GL_VENDOR: return reinterpret_cast<const GLubyte*>("wgleng");
+		case GL_RENDERER: return reinterpret_cast<const GLubyte*>("GLRecorder");
+		case GL_VERSION: return reinterpret_cast<const GLubyte*>("OpenGL ES 3.0 (headless)");
+		case GL_SHADING_LANGUAGE_VERSION: return reinterpret_cast<const GLubyte*>("OpenGL ES GLSL ES 3.00");
+		default: return reinterpret_cast<const GLubyte*>("");
+	}
+}
+void glFinish() {}
+
+// queries, results are always available. nothing is rasterized, so occlusion queries report visible and timers zero
+void glGenQueries(GLsizei n, GLuint* ids) { generateNames(n, ids); }
+void glDeleteQueries(GLsizei n, const GLuint* ids) {
+	for (GLsizei i = 0; i < n; i++) state().queryTargets.erase(ids[i]);
+}
+void glBeginQuery(GLenum target, GLuint id) { state().queryTargets[id] = target; }
+void glEndQuery(GLenum /*target*/) {}
+void glGetQueryObjectuiv(GLuint id, GLenum pname, GLuint* params) {
+	if (pname == GL_QUERY_RESULT_AVAILABLE) {
+		*params = GL_TRUE;
+		return;
+	}
+	const auto it = state().queryTargets.find(id);
+	const bool occlusion = it != state().queryTargets.end() &&
+		(it->second == GL_ANY_SAMPLES_PASSED || it->second == GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+	*params = occlusion ? GL_TRUE : 0;
+}
+
+// drawing
+void glClear(GLbitfield /*mask*/) { state().current.clears++; }
+void glClearBufferfv(GLenum /*buffer*/, GLint /*drawbuffer*/, const GLfloat* /*value*/) { state().current.clears++; }
+void glClearBufferuiv(GLenum /*buffer*/, GLint /*drawbuffer*/, const GLuint* /*value*/) { state().current.clears++; }
+void glDrawArrays(GLenum mode, GLint /*first*/, GLsizei count) { recordDraw(mode, count, 1); }
+void glDrawArraysInstanced(GLenum mode, GLint /*first*/, GLsizei count, GLsizei instancecount) { recordDraw(mode, count, instancecount); }
+void glDrawElements(GLenum mode, GLsizei count, GLenum /*type*/, const void* /*indices*/) { recordDraw(mode, count, 1); }
+void glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum /*type*/, const void* /*indices*/, GLsizei instancecount) { recordDraw(mode, count, instancecount); }
+// WEBGL_multi_draw, recorded as one draw call
+void glMultiDrawElementsInstancedWEBGL(GLenum mode, const GLsizei* counts, GLenum /*type*/, const void* const* /*offsets*/, const GLsizei* instanceCounts, GLsizei drawCount) {
+	uint64_t vertices = 0;
+	GLsizei instances = 0;
+	for (GLsizei i = 0; i < drawCount; i++) {
+		vertices += static_cast<uint64_t>(counts[i]) * instanceCounts[i];
+		instances += instanceCounts[i];
+	}
+	// count is the average per instance
+	recordDraw(mode, instances > 0 ? static_cast<GLsizei>(vertices / instances) : 0, instances, vertices);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <stdint.h>
+#include <vector>
+
+// Stand-in for WebGL in headless builds. Every gl* function the engine uses is defined in GLRecorder.cpp,
+// calls are only recorded and no gpu work is done. Misuse WebGL2 rejects is reported as a gl error. Object names are handed out sequentially and queries
+// return what a typical WebGL2 implementation would.
+class GLRecorder {
+public:
+	GLRecorder() = delete;
+
+	struct DrawCall {
+		GLenum mode;
+		GLsizei count; // vertices or indices
+		GLsizei instanceCount;
+		GLuint program;
+		GLuint vertexArray;
+		GLuint framebuffer;
+	};
+	struct FrameStats {
+		uint32_t drawCalls = 0;
+		uint64_t instances = 0;
+		uint64_t vertices = 0;
+		uint32_t bufferUploads = 0;
+		uint64_t bufferUploadBytes = 0;
+		uint32_t textureUploads = 0;
+		uint64_t textureUploadBytes = 0;
+		uint32_t clears = 0;
+		// binds, enables, viewport... redundant ones set the value that was already set
+		uint32_t stateChanges = 0;
+		uint32_t redundantStateChanges = 0;
+	};
+
+	// finishes the current frame, called from RenderTarget::SwapBuffers
+	static void EndFrame();
+	// forgets recorded frames and totals, objects stay alive
+	static void Reset();
+
+	static const FrameStats& GetCurrentFrameStats();
+	static const FrameStats& GetLastFrameStats();
+	static const FrameStats& GetTotalStats();
+	static const std::vector<DrawCall>& GetLastFrameDrawCalls();
+	static uint32_t GetFrameCount();
+	// gl errors raised since startup, they are also printed to stderr and reported by glGetError
+	static uint32_t GetErrorCount();
+};
@@ -0,0 +1,52 @@
+// null imgui platform / renderer backends for headless builds.
+// they only do the bookkeeping ImGui::NewFrame asserts on, nothing is drawn.
+#include <stdint.h>
+
+#include "../vendor/imgui/imgui.h"
+#include "../vendor/imgui/imgui_impl_opengl3.h"
+#include "../vendor/imgui/imgui_impl_sdl2.h"
+
+bool ImGui_ImplOpenGL3_Init(const char* /*glsl_version*/) {
+	ImGui::GetIO().BackendRendererName = "imgui_impl_headless";
+	return true;
+}
+void ImGui_ImplOpenGL3_Shutdown() {
+	ImGui::GetIO().BackendRendererName = nullptr;
+}
+void ImGui_ImplOpenGL3_NewFrame() {
+	ImGui_ImplOpenGL3_CreateFontsTexture();
+}
+void ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* /*draw_data*/) {}
+bool ImGui_ImplOpenGL3_CreateFontsTexture() {
+	ImGuiIO& io = ImGui::GetIO();
+	if (io.Fonts->IsBuilt()) return true;
+	unsigned char* pixels;
+	int width, height;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+	io.Fonts->SetTexID(reinterpret_cast<ImTextureID>(static_cast<intptr_t>(1)));
+	return true;
+}
+void ImGui_ImplOpenGL3_DestroyFontsTexture() {
+	ImGui::GetIO().Fonts->SetTexID(0);
+}
+bool ImGui_ImplOpenGL3_CreateDeviceObjects() {
+	return ImGui_ImplOpenGL3_CreateFontsTexture();
+}
+void ImGui_ImplOpenGL3_DestroyDeviceObjects() {
+	ImGui_ImplOpenGL3_DestroyFontsTexture();
+}
+
+bool ImGui_ImplSDL2_InitForOpenGL(SDL_Window* /*window*/, void* /*sdl_gl_context*/) {
+	ImGui::GetIO().BackendPlatformName = "imgui_impl_headless";
+	return true;
+}
+void ImGui_ImplSDL2_Shutdown() {
+	ImGui::GetIO().BackendPlatformName = nullptr;
+}
+void ImGui_ImplSDL2_NewFrame() {
+	// fixed step, headless frames do not map to wall clock time
+	ImGui::GetIO().DeltaTime = 1.0f / 60.0f;
+}
+bool ImGui_ImplSDL2_ProcessEvent(const SDL_Event* /*event*/) {
+	return false;
+}
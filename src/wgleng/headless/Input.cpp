@@ -0,0 +1,109 @@
+#include "../io/Input.h"
+
+#include "../vendor/imgui/imgui.h"
+
+namespace {
+    void press(auto& state) {
+        state.press = true;
+        state.hold = true;
+        state.release = false;
+    }
+    void release(auto& state) {
+        state.press = false;
+        state.hold = false;
+        state.release = true;
+    }
+}
+
+void Input::Poll(bool resetHeld) {
+    auto& io = ImGui::GetIO();
+    if (io.WantCaptureMouse || io.WantCaptureKeyboard) resetHeld = true;
+
+    // reset state
+    for (auto& key : m_keys) {
+        if (resetHeld) key.hold = false;
+        key.press = false;
+        key.release = false;
+    }
+    for (auto& button : m_buttons) {
+        if (resetHeld) button.hold = false;
+        button.press = false;
+        button.release = false;
+    }
+    m_scrollOffsetX = 0;
+    m_scrollOffsetY = 0;
+
+    // apply injected events
+    for (const auto& event : m_injectedEvents) {
+        switch (event.type) {
+            case InjectedEvent::Type::Key: {
+                if (event.code < 0 || event.code >= SDL_NUM_SCANCODES) break;
+                if (event.down) press(m_keys[event.code]);
+                else release(m_keys[event.code]);
+                break;
+            }
+            case InjectedEvent::Type::MouseButton: {
+                if (event.code < 0 || event.code >= m_buttonCount) break;
+                if (event.down) press(m_buttons[event.code]);
+                else release(m_buttons[event.code]);
+                break;
+            }
+            case InjectedEvent::Type::MouseMove: {
+                m_mousePosition = event.value;
+                break;
+            }
+            case InjectedEvent::Type::MouseScroll: {
+                m_scrollOffsetX = event.value.x;
+                m_scrollOffsetY = event.value.y;
+                break;
+            }
+        }
+    }
+    m_injectedEvents.clear();
+}
+bool Input::JustPressed(SDL_Scancode key) {
+    return m_keys[key].press;
+}
+bool Input::IsHeld(SDL_Scancode key) {
+    return m_keys[key].hold;
+}
+bool Input::JustReleased(SDL_Scancode key) {
+    return m_keys[key].release;
+}
+
+glm::vec2 Input::GetMousePosition() {
+    return m_mousePosition;
+}
+
+bool Input::JustPressedMouse(int button) {
+    if (button >= m_buttonCount) return false;
+    return m_buttons[button].press;
+}
+bool Input::IsHeldMouse(int button) {
+    if (button >= m_buttonCount) return false;
+    return m_buttons[button].hold;
+}
+bool Input::JustReleasedMouse(int button) {
+    if (button >= m_buttonCount) return false;
+    return m_buttons[button].release;
+}
+
+float Input::GetMouseScrollX() {
+    return m_scrollOffsetX;
+}
+float Input::GetMouseScrollY() {
+    return m_scrollOffsetY;
+}
+
+void Input::InjectKey(SDL_Scancode key, bool down) {
+    m_injectedEvents.push_back({.type = InjectedEvent::Type::Key, .code = key, .down = down, .value = {0, 0}});
+}
+void Input::InjectMouseButton(int button, bool down) {
+    m_injectedEvents.push_back({.type = InjectedEvent::Type::MouseButton, .code = button, .down = down, .value = {0, 0}});
+}
+void Input::InjectMouseMove(glm::vec2 position) {
+    m_injectedEvents.push_back({.type = InjectedEvent::Type::MouseMove, .code = 0, .down = false, .value = position});
+}
+void Input::InjectMouseScroll(float x, float y) {
+    m_injectedEvents.push_back({.type = InjectedEvent::Type::MouseScroll, .code = 0, .down = false, .value = {x, y}});
+}
@@ -0,0 +1,43 @@
+#include "../io/RenderTarget.h"
+
+#include "../vendor/imgui/imgui.h"
+#include "../vendor/imgui/imgui_impl_opengl3.h"
+#include "../vendor/imgui/imgui_impl_sdl2.h"
+#include "GLRecorder.h"
+
+// no window, the size is fixed unless Resize is called
+RenderTarget::RenderTarget() {
+    width = 1280;
+    height = 720;
+
+    // imgui
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    ImGui::StyleColorsDark();
+    ImGui_ImplSDL2_InitForOpenGL(nullptr, nullptr);
+    ImGui_ImplOpenGL3_Init("#version 300 es");
+
+    m_valid = true;
+    Resize(width, height);
+}
+RenderTarget::~RenderTarget() {
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplSDL2_Shutdown();
+    ImGui::DestroyContext();
+}
+
+void RenderTarget::SetFocused(bool /*focused*/) {}
+
+void RenderTarget::Resize(int32_t width, int32_t height) {
+    this->width = width;
+    this->height = height;
+    if (!IsValid()) return;
+    ImGui::GetIO().DisplaySize = ImVec2(static_cast<float>(width), static_cast<float>(height));
+}
+
+void RenderTarget::SwapBuffers() {
+    if (!IsValid()) return;
+    GLRecorder::EndFrame();
+}
@@ -1,6 +1,11 @@
 #pragma once
 
+#ifdef WGLENG_HEADLESS
+#include <vector>
+#include "../headless/Scancodes.h"
+#else
 #include <SDL2/SDL.h>
+#endif
 #include <glm/vec2.hpp>
 
 class Input {
@@ -18,6 +23,14 @@ public:
     static float GetMouseScrollX();
     static float GetMouseScrollY();
 
+#ifdef WGLENG_HEADLESS
+    // there is no event source in headless builds, injected events are applied by the next Poll
+    static void InjectKey(SDL_Scancode key, bool down);
+    static void InjectMouseButton(int button, bool down);
+    static void InjectMouseMove(glm::vec2 position);
+    static void InjectMouseScroll(float x, float y);
+#endif
+
 private:
     static constexpr inline int m_buttonCount = 10; // arbitrary number, maby someone has that crazy mouse
     struct KeyState {
@@ -29,4 +42,14 @@ private:
     static inline KeyState m_buttons[m_buttonCount];
     static inline float m_scrollOffsetX = 0;
     static inline float m_scrollOffsetY = 0;
+#ifdef WGLENG_HEADLESS
+    struct InjectedEvent {
+        enum class Type { Key, MouseButton, MouseMove, MouseScroll } type;
+        int code;
+        bool down;
+        glm::vec2 value;
+    };
+    static inline std::vector<InjectedEvent> m_injectedEvents;
+    static inline glm::vec2 m_mousePosition{0, 0};
+#endif
 };
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 
+#ifndef WGLENG_HEADLESS
 #include <emscripten.h>
 #include <SDL2/SDL.h>
+#endif
 #include <GLES3/gl3.h>
 #include <stdint.h>
 
@@ -23,7 +25,9 @@ public:
     int32_t width, height;
 
 private:
+#ifndef WGLENG_HEADLESS
     SDL_Window* m_window;
     SDL_GLContext m_context;
+#endif
     bool m_valid = false;
 };
\ No newline at end of file
@@ -1,9 +1,15 @@
 #include "CSMBuffer.h"
 
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <cmath>
+#include <numeric>
 #include <glm/ext.hpp>
 #include <iostream>
 
+#include "GLState.h"
+
 #define DEBUG_FRUSTUMS 0
 
 #if DEBUG_FRUSTUMS
@@ -11,32 +17,40 @@
 #include "Debug.h"
 #endif
 
-CSMBuffer::CSMBuffer(uint32_t width, uint32_t height, const std::vector<float>& cascadeSplits)
-	: m_width{width}, m_height{height}, m_cascadeSplits{cascadeSplits} {
+CSMBuffer::CSMBuffer(const std::vector<float>& cascadeSplits, const std::vector<uint32_t>& resolutions)
+	: m_cascadeSplits{cascadeSplits}, m_resolutions{resolutions} {
 	Create();
 }
 CSMBuffer::~CSMBuffer() {
 	Destroy();
 }
 
-void CSMBuffer::SetCascades(const std::vector<float>& cascadeSplits) {
+void CSMBuffer::SetCascades(const std::vector<float>& cascadeSplits, const std::vector<uint32_t>& resolutions, bool staticLayers) {
 	m_cascadeSplits = cascadeSplits;
+	m_resolutions = resolutions;
+	m_staticLayersEnabled = staticLayers;
 	Destroy();
 	Create();
 }
+glm::vec4 CSMBuffer::GetAtlasScaleOffset(uint32_t cascade) const {
+	const ShadowAtlas::Rect& rect = m_rects[cascade];
+	const glm::vec2 atlasSize{m_atlas.GetWidth(), m_atlas.GetHeight()};
+	return {glm::vec2(rect.size) / atlasSize, glm::vec2(rect.x, rect.y) / atlasSize};
+}
 
-void CSMBuffer::Resize(uint32_t width, uint32_t height) {
-	m_width = width;
-	m_height = height;
-	Destroy();
-	Create();
+void CSMBuffer::FitSplits(float minDepth, float maxDepth) {
+	const auto count = static_cast<float>(GetFrustumCount());
+	for (uint32_t i = 0; i < GetFrustumCount(); i++) {
+		const float t = (i + 1) / count;
+		const float logSplit = minDepth * glm::pow(maxDepth / minDepth, t);
+		const float uniformSplit = minDepth + (maxDepth - minDepth) * t;
+		m_splits[i] = glm::mix(uniformSplit, logSplit, m_logSplitWeight);
+	}
+	m_splitsNear = minDepth;
 }
-void CSMBuffer::ResizeAndSetCascades(uint32_t width, uint32_t height, const std::vector<float>& cascadeSplits) {
-	m_width = width;
-	m_height = height;
-	m_cascadeSplits = cascadeSplits;
-	Destroy();
-	Create();
+void CSMBuffer::ResetSplits() {
+	m_splits = m_cascadeSplits;
+	m_splitsNear = 0;
 }
 
 std::vector<glm::vec4> GetFrustumCornersWorldSpace(const glm::mat4& proj, const glm::mat4& view) {
@@ -54,7 +68,7 @@ std::vector<glm::vec4> GetFrustumCornersWorldSpace(const glm::mat4& proj, const
 	}
 	return frustumCorners;
 }
-std::vector<glm::mat4> CSMBuffer::GetLightSpaceMatrices(const std::shared_ptr<Camera>& camera, const glm::vec3& lightDir) const {
+std::vector<glm::mat4> CSMBuffer::GetLightSpaceMatrices(const std::shared_ptr<Camera>& camera, const glm::vec3& lightDir, const glm::vec3& sceneMin, const glm::vec3& sceneMax) const {
 #if DEBUG_FRUSTUMS
 	static std::vector<std::pair<glm::mat4, glm::mat4>> testMats;
 	if (Input::JustPressed(SDL_SCANCODE_G)) {
@@ -88,8 +102,8 @@ std::vector<glm::mat4> CSMBuffer::GetLightSpaceMatrices(const std::shared_ptr<Ca
 
 	std::vector<glm::mat4> lightSpaceMatrices(GetFrustumCount());
 	for (int i = 0; i < GetFrustumCount(); i++) {
-		const float nearPlane = i == 0 ? camera->GetNearPlane() : m_cascadeSplits[i - 1];
-		const float farPlane = m_cascadeSplits[i];
+		const float nearPlane = i == 0 ? glm::max(camera->GetNearPlane(), m_splitsNear) : m_splits[i - 1];
+		const float farPlane = m_splits[i];
 		glm::mat4 proj = glm::perspective(glm::radians(camera->GetFov()), camera->GetAspectRatio(), nearPlane, farPlane);
 		const auto frustumCorners = GetFrustumCornersWorldSpace(proj, camera->GetViewMatrix());
 
@@ -114,7 +128,12 @@ std::vector<glm::mat4> CSMBuffer::GetLightSpaceMatrices(const std::shared_ptr<Ca
 			minZ = std::min(minZ, trf.z);
 		}
 
-		maxZ *= 10.f;
+		// casters between the slice and the light still cast into it
+		if (sceneMin.x <= sceneMax.x) {
+			glm::vec3 lightSceneMin, lightSceneMax;
+			GetLightClipBounds(lightView, (sceneMin + sceneMax) * 0.5f, (sceneMax - sceneMin) * 0.5f, lightSceneMin, lightSceneMax);
+			maxZ = std::max(maxZ, lightSceneMax.z);
+		}
 
 		const glm::mat4 lightProjection = glm::ortho(minX, maxX, minY, maxY, -maxZ, -minZ);
 		lightSpaceMatrices[i] = lightProjection * lightView;
@@ -127,54 +146,206 @@ std::vector<glm::mat4> CSMBuffer::GetLightSpaceMatrices(const std::shared_ptr<Ca
 	return lightSpaceMatrices;
 }
 
+void CSMBuffer::GetLightClipBounds(const glm::mat4& lightSpaceMatrix, const glm::vec3& center, const glm::vec3& extent, glm::vec3& boundsMin, glm::vec3& boundsMax) {
+	// light space matrices are orthographic, so w stays 1. scalar, this runs for every receiver and caster
+	const glm::mat4& m = lightSpaceMatrix;
+	for (int r = 0; r < 3; r++) {
+		const float clipCenter = m[0][r] * center.x + m[1][r] * center.y + m[2][r] * center.z + m[3][r];
+		const float clipExtent = std::abs(m[0][r]) * extent.x + std::abs(m[1][r]) * extent.y + std::abs(m[2][r]) * extent.z;
+		boundsMin[r] = clipCenter - clipExtent;
+		boundsMax[r] = clipCenter + clipExtent;
+	}
+}
+glm::mat4 CSMBuffer::FitToBounds(const glm::mat4& lightSpaceMatrix, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	glm::mat4 fit{1};
+	for (int a = 0; a < 3; a++) {
+		fit[a][a] = 2.0f / (boundsMax[a] - boundsMin[a]);
+		fit[3][a] = -(boundsMax[a] + boundsMin[a]) / (boundsMax[a] - boundsMin[a]);
+	}
+	return fit * lightSpaceMatrix;
+}
+void CSMBuffer::UpdateCachedCascades(const std::shared_ptr<Camera>& camera, const glm::vec3& lightDir, uint32_t refitTexels, uint32_t farCascadeInterval,
+	const glm::vec3& sceneMin, const glm::vec3& sceneMax) {
+	m_frame++;
+	if (lightDir != m_cachedLightDir) {
+		InvalidateCache();
+		m_cachedLightDir = lightDir;
+	}
+	// light view around the world origin, cascade centers are snapped to texels in it
+	const glm::vec3 direction = glm::normalize(lightDir);
+	const glm::vec3 up = glm::abs(direction.y) > 0.99f ? glm::vec3{0, 0, 1} : glm::vec3{0, 1, 0};
+	const glm::mat4 lightView = glm::lookAt(glm::vec3{0}, -direction, up);
+	float sceneTop = std::numeric_limits<float>::lowest();
+	if (sceneMin.x <= sceneMax.x) {
+		glm::vec3 lightSceneMin, lightSceneMax;
+		GetLightClipBounds(lightView, (sceneMin + sceneMax) * 0.5f, (sceneMax - sceneMin) * 0.5f, lightSceneMin, lightSceneMax);
+		sceneTop = lightSceneMax.z;
+	}
+	for (uint32_t i = 0; i < GetFrustumCount(); i++) {
+		auto& cascade = m_cachedCascades[i];
+		// the margin may take at most a quarter of the cascade
+		const auto resolution = static_cast<float>(GetResolution(i));
+		const float marginFraction = 2.0f * glm::min(static_cast<float>(refitTexels), resolution / 8.0f) / resolution;
+		const float nearPlane = i == 0 ? camera->GetNearPlane() : m_cascadeSplits[i - 1];
+		const float farPlane = m_cascadeSplits[i];
+		const glm::mat4 proj = glm::perspective(glm::radians(camera->GetFov()), camera->GetAspectRatio(), nearPlane, farPlane);
+		const auto frustumCorners = GetFrustumCornersWorldSpace(proj, camera->GetViewMatrix());
+		glm::vec3 center{0};
+		for (const auto& v : frustumCorners) center += glm::vec3(v);
+		center /= frustumCorners.size();
+		float radius = 0;
+		for (const auto& v : frustumCorners) radius = glm::max(radius, glm::distance(glm::vec3(v), center));
+		// the sphere does not change with the camera rotation, rounding keeps float noise from moving the cascade
+		radius = glm::ceil(radius * 16.0f) / 16.0f;
+		const float extent = radius / (1.0f - marginFraction);
+		const glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1));
+
+		const glm::vec3 moved = glm::abs(lightCenter - cascade.center);
+		const bool outside = glm::max(moved.x, glm::max(moved.y, moved.z)) > cascade.margin;
+		if (!cascade.placed || outside || extent - radius != cascade.margin || sceneTop > cascade.nearZ) {
+			const float texelSize = 2.0f * extent / resolution;
+			const glm::vec2 snapped = glm::floor(glm::vec2(lightCenter) / texelSize + 0.5f) * texelSize;
+			// the near plane reaches up to the top of the scene like in GetLightSpaceMatrices, with some room so
+			// casters rising above it do not move the cascade every frame
+			const float nearZ = glm::max(lightCenter.z, sceneTop) + extent;
+			const glm::mat4 lightProjection = glm::ortho(snapped.x - extent, snapped.x + extent, snapped.y - extent, snapped.y + extent,
+				-nearZ, -(lightCenter.z - extent));
+			cascade.matrix = lightProjection * lightView;
+			cascade.center = lightCenter;
+			cascade.margin = extent - radius;
+			cascade.nearZ = nearZ;
+			cascade.placed = true;
+			cascade.staticLayerValid = false;
+		}
+		const uint32_t interval = i == 0 ? 1 : glm::max(farCascadeInterval, 1U);
+		cascade.due = !cascade.staticLayerValid || (m_frame + i) % interval == 0;
+	}
+}
+void CSMBuffer::InvalidateStaticLayers() {
+	for (auto& cascade : m_cachedCascades) {
+		cascade.staticLayerValid = false;
+		cascade.due = true;
+	}
+}
+void CSMBuffer::InvalidateCache() {
+	m_cachedCascades.assign(GetFrustumCount(), {});
+}
+std::vector<glm::mat4> CSMBuffer::GetCachedMatrices() const {
+	std::vector<glm::mat4> matrices(m_cachedCascades.size());
+	for (std::size_t i = 0; i < matrices.size(); i++) matrices[i] = m_cachedCascades[i].matrix;
+	return matrices;
+}
+
+void CSMBuffer::SetStaticLayersEnabled(bool enabled) {
+	if (m_staticLayersEnabled == enabled) return;
+	m_staticLayersEnabled = enabled;
+	Destroy();
+	Create();
+}
+void CSMBuffer::BindCascade(uint32_t cascade, bool staticLayer) const {
+	const ShadowAtlas::Rect& rect = m_rects[cascade];
+	GLState::BindFramebuffer(staticLayer ? m_staticFbo : m_fbo);
+	GLState::Viewport(rect.x, rect.y, rect.size, rect.size);
+}
+void CSMBuffer::ClearCascade(uint32_t cascade) const {
+	const ShadowAtlas::Rect& rect = m_rects[cascade];
+	GLState::SetCapability(GL_SCISSOR_TEST, true);
+	glScissor(rect.x, rect.y, rect.size, rect.size);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	GLState::SetCapability(GL_SCISSOR_TEST, false);
+}
+void CSMBuffer::CopyStaticLayer(uint32_t cascade) const {
+	// depth can only be copied by blitting, both atlases use the same format and layout
+	const ShadowAtlas::Rect& rect = m_rects[cascade];
+	const auto x0 = static_cast<GLint>(rect.x), y0 = static_cast<GLint>(rect.y);
+	const auto x1 = static_cast<GLint>(rect.x + rect.size), y1 = static_cast<GLint>(rect.y + rect.size);
+	BindCascade(cascade, false);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_staticFbo);
+	glBlitFramebuffer(x0, y0, x1, y1, x0, y0, x1, y1, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+}
+
 void CSMBuffer::Create() {
-	if (GetFrustumCount() == 0) {
-		printf("Error: CSMBuffer requires at least one cascade.\n");
+	InvalidateCache();
+	ResetSplits();
+	if (GetFrustumCount() == 0 || m_resolutions.size() != GetFrustumCount()) {
+		printf("Error: CSMBuffer requires at least one cascade and a resolution per cascade.\n");
+		m_rects.assign(GetFrustumCount(), {0, 0, 1});
+		return;
+	}
+	AllocateAtlas();
+	m_depthFormat = CreateDepthAtlas(m_texDepth, m_fbo, 0);
+	if (m_depthFormat < 0) {
+		printf("Error: Failed to create valid CSMBuffer.\n");
 		return;
 	}
-	m_fbos.resize(GetFrustumCount());
+	if (m_staticLayersEnabled && CreateDepthAtlas(m_staticTexDepth, m_staticFbo, m_depthFormat) != m_depthFormat) {
+		printf("Error: Failed to create static CSMBuffer layers.\n");
+		glDeleteFramebuffers(1, &m_staticFbo);
+		m_staticFbo = 0;
+	}
+}
+void CSMBuffer::AllocateAtlas() {
+	std::vector<uint32_t> order(GetFrustumCount());
+	std::iota(order.begin(), order.end(), 0);
+	std::ranges::sort(order, [&](uint32_t a, uint32_t b) { return m_resolutions[a] > m_resolutions[b]; });
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
 
-	glGenTextures(1, &m_texDepth);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, m_texDepth);
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// all cascades are halved until the atlas fits into the largest texture the gpu supports. once the atlas is wide
+	// enough every cascade fits into a square of the full height, so 1x1 cascades always fit
+	m_rects.resize(GetFrustumCount());
+	for (uint32_t shift = 0;; shift++) {
+		const auto resolution = [&](uint32_t i) { return std::max(m_resolutions[i] >> shift, 1U); };
+		const uint32_t height = std::bit_ceil(resolution(order.front()));
+		const uint32_t step = std::bit_ceil(resolution(order.back()));
+		for (uint32_t width = height; width <= static_cast<uint32_t>(maxSize) || height == 1; width += step) {
+			m_atlas.Reset(width, height);
+			if (std::ranges::all_of(order, [&](uint32_t i) { return m_atlas.Allocate(resolution(i), m_rects[i]); })) return;
+		}
+	}
+}
+int CSMBuffer::CreateDepthAtlas(GLuint& texture, GLuint& fbo, int firstFormat) const {
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	// sampled through sampler2DShadow, each fetch blends the comparisons of 2x2 texels (hardware pcf)
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
 
-	std::tuple<int, int, int> depthFormats[] = {
+	constexpr std::tuple<int, int, int> depthFormats[] = {
 		{GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT},
 		{GL_DEPTH32F_STENCIL8, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV},
 		{GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT},
 		{GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8},
 		{GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT},
 	};
-	bool bufferValid = false;
-	for (auto&& [d_internal_format, d_format, d_type] : depthFormats) {
-		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, d_internal_format, m_width, m_height, GetFrustumCount(), 0, d_format, d_type, 0);
-
-		for (auto& fbo : m_fbos) glDeleteFramebuffers(1, &fbo);
-		glGenFramebuffers(GetFrustumCount(), m_fbos.data());
-		bool success = true;
-		for (int i = 0; i < m_fbos.size(); i++) {
-			glBindFramebuffer(GL_FRAMEBUFFER, m_fbos[i]);
-			glDrawBuffers(0, nullptr);
-			glReadBuffer(GL_NONE);
-			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texDepth, 0, i);
-			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-				success = false;
-				break;
-			}
-		}
-		if (success) {
-			bufferValid = true;
-			break;
-		}
+	for (int format = firstFormat; format < static_cast<int>(std::size(depthFormats)); format++) {
+		const auto [d_internal_format, d_format, d_type] = depthFormats[format];
+		glTexImage2D(GL_TEXTURE_2D, 0, d_internal_format, m_atlas.GetWidth(), m_atlas.GetHeight(), 0, d_format, d_type, 0);
+
+		if (fbo) glDeleteFramebuffers(1, &fbo);
+		glGenFramebuffers(1, &fbo);
+		GLState::BindFramebuffer(fbo);
+		glDrawBuffers(0, nullptr);
+		glReadBuffer(GL_NONE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+		const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		GLState::BindFramebuffer(0);
+		if (complete) return format;
 	}
-	if (!bufferValid) printf("Error: Failed to create valid CSMBuffer.\n");
+	return -1;
 }
 void CSMBuffer::Destroy() {
-	glDeleteFramebuffers(m_fbos.size(), m_fbos.data());
-	m_fbos.clear();
-	glDeleteTextures(1, &m_texDepth);
+	if (m_fbo) glDeleteFramebuffers(1, &m_fbo);
+	m_fbo = 0;
+	if (m_texDepth) glDeleteTextures(1, &m_texDepth);
 	m_texDepth = 0;
+	if (m_staticFbo) glDeleteFramebuffers(1, &m_staticFbo);
+	m_staticFbo = 0;
+	if (m_staticTexDepth) glDeleteTextures(1, &m_staticTexDepth);
+	m_staticTexDepth = 0;
 }
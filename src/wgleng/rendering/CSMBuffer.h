@@ -2,41 +2,111 @@
 
 #include <GLES3/gl3.h>
 #include <glm/glm.hpp>
+#include <memory>
 #include <vector>
 
 #include "../core/Camera.h"
+#include "ShadowAtlas.h"
 
 class CSMBuffer {
 public:
 	CSMBuffer() = default;
-	CSMBuffer(uint32_t width, uint32_t height, const std::vector<float>& cascadeSplits);
+	CSMBuffer(const std::vector<float>& cascadeSplits, const std::vector<uint32_t>& resolutions);
 	~CSMBuffer();
 	CSMBuffer(const CSMBuffer&) = delete;
 	CSMBuffer& operator=(const CSMBuffer&) = delete;
 	CSMBuffer(CSMBuffer&&) = delete;
 	CSMBuffer& operator=(CSMBuffer&&) = delete;
 
-	uint32_t GetWidth() const { return m_width; }
-	uint32_t GetHeight() const { return m_height; }
-
 	uint32_t GetFrustumCount() const { return m_cascadeSplits.size(); }
-	// each cascade is the max shadow distance for that cascade, so at least 1 cascade is required
-	void SetCascades(const std::vector<float>& cascadeSplits);
+	// each cascade is the max shadow distance for that cascade, so at least 1 cascade is required.
+	// resolutions are the sizes of the square shadow maps of the cascades, rounded up to powers of two and halved
+	// while the atlas would not fit into GL_MAX_TEXTURE_SIZE. staticLayers is applied with them, see SetStaticLayersEnabled
+	void SetCascades(const std::vector<float>& cascadeSplits, const std::vector<uint32_t>& resolutions, bool staticLayers);
 	const std::vector<float>& GetCascades() const { return m_cascadeSplits; }
-	void Resize(uint32_t width, uint32_t height);
-	void ResizeAndSetCascades(uint32_t width, uint32_t height, const std::vector<float>& cascadeSplits);
+	uint32_t GetResolution(uint32_t cascade) const { return m_rects[cascade].size; }
+	uint32_t GetAtlasWidth() const { return m_atlas.GetWidth(); }
+	uint32_t GetAtlasHeight() const { return m_atlas.GetHeight(); }
+	// scale (xy) and offset (zw) from the [0, 1] texture coordinates of cascade to the atlas
+	glm::vec4 GetAtlasScaleOffset(uint32_t cascade) const;
+
+	// splits of the current frame, the configured cascades unless FitSplits moved them
+	const std::vector<float>& GetSplits() const { return m_splits; }
+	// sample distribution shadow maps: spreads the cascades over the view depth range the camera sees, blending
+	// logarithmic and uniform splits. the first cascade starts at minDepth. cached cascades keep the configured ones
+	void FitSplits(float minDepth, float maxDepth);
+	void ResetSplits();
+
+	// sceneMin / sceneMax are the world bounds of all casters (min > max if there are none), the near plane of each
+	// cascade moves up to them so casters between the slice and the light are not clipped
+	std::vector<glm::mat4> GetLightSpaceMatrices(const std::shared_ptr<Camera>& camera, const glm::vec3& lightDir, const glm::vec3& sceneMin, const glm::vec3& sceneMax) const;
+	// bounds of a world space aabb (center / half extent) in the clip space of a light space matrix
+	static void GetLightClipBounds(const glm::mat4& lightSpaceMatrix, const glm::vec3& center, const glm::vec3& extent, glm::vec3& boundsMin, glm::vec3& boundsMax);
+	// maps the clip space box [boundsMin, boundsMax] of a light space matrix to [-1, 1]
+	static glm::mat4 FitToBounds(const glm::mat4& lightSpaceMatrix, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
 
-	std::vector<glm::mat4> GetLightSpaceMatrices(const std::shared_ptr<Camera>& camera, const glm::vec3& lightDir) const;
+	// Cascades that stay in place between frames, so their depth can be kept (see RendererSettings::ShadowCacheSettings).
+	// A cascade covers the bounding sphere of its slice of the camera frustum, grown by refitTexels and snapped to texels.
+	// It does not follow camera rotations and only moves once the slice left the grown area or the light turned.
+	struct CachedCascade {
+		glm::mat4 matrix{1};
+		glm::vec3 center{0}; // of the slice in light view space, when the cascade was placed
+		float margin = 0; // the slice may move this far from center
+		float nearZ = 0; // light view depth of the near plane, the cascade is placed again once the scene reaches past it
+		bool placed = false;
+		bool staticLayerValid = false;
+		bool hasDynamicCasters = false; // drawn into the current depth, they have to be erased when they leave
+		bool due = false; // has to be brought up to date this frame
+	};
+	// places the cascades for this frame and marks the due ones. cascade 0 is due every frame, the others every
+	// farCascadeInterval frames (staggered), any cascade that moved or lost its static layer right away.
+	// sceneMin / sceneMax like in GetLightSpaceMatrices
+	void UpdateCachedCascades(const std::shared_ptr<Camera>& camera, const glm::vec3& lightDir, uint32_t refitTexels, uint32_t farCascadeInterval,
+		const glm::vec3& sceneMin, const glm::vec3& sceneMax);
+	// static casters changed, every cascade is due
+	void InvalidateStaticLayers();
+	void InvalidateCache();
+	std::vector<CachedCascade>& GetCachedCascades() { return m_cachedCascades; }
+	// matrices of the placed cascades, use them for culling and lighting instead of GetLightSpaceMatrices
+	std::vector<glm::mat4> GetCachedMatrices() const;
 
-	const std::vector<GLuint>& GetFBOs() const { return m_fbos; }
-	GLuint GetDepthTextureArray() const { return m_texDepth; }
+	// second atlas that only holds static casters, dynamic ones are drawn over a copy of it
+	void SetStaticLayersEnabled(bool enabled);
+	bool HasStaticLayers() const { return m_staticFbo != 0; }
+	// binds the framebuffer of the atlas and the viewport of cascade
+	void BindCascade(uint32_t cascade, bool staticLayer) const;
+	// clears the depth of cascade in the bound framebuffer
+	void ClearCascade(uint32_t cascade) const;
+	// copies the static layer of cascade into the cascade, leaves the cascade bound
+	void CopyStaticLayer(uint32_t cascade) const;
+
+	GLuint GetDepthTexture() const { return m_texDepth; }
 
 private:
 	void Create();
 	void Destroy();
+	// places the cascades in m_atlas. the largest one sets the height, the atlas grows wider until all fit
+	void AllocateAtlas();
+	// depth texture of the atlas size and its framebuffer in the first format that works, returns the format index
+	int CreateDepthAtlas(GLuint& texture, GLuint& fbo, int firstFormat) const;
+
+	// weight of the logarithmic splits in FitSplits, the rest are uniform
+	constexpr static inline float m_logSplitWeight = 0.75f;
 
-	uint32_t m_width, m_height;
 	std::vector<float> m_cascadeSplits;
-	std::vector<GLuint> m_fbos;
-	GLuint m_texDepth;
+	std::vector<uint32_t> m_resolutions;
+	std::vector<float> m_splits;
+	float m_splitsNear = 0; // 0 for the near plane of the camera
+	ShadowAtlas m_atlas;
+	std::vector<ShadowAtlas::Rect> m_rects; // per cascade
+	GLuint m_fbo = 0;
+	GLuint m_texDepth = 0;
+
+	bool m_staticLayersEnabled = false;
+	int m_depthFormat = 0;
+	GLuint m_staticFbo = 0;
+	GLuint m_staticTexDepth = 0;
+	std::vector<CachedCascade> m_cachedCascades;
+	glm::vec3 m_cachedLightDir{0};
+	uint32_t m_frame = 0;
 };
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cstdint>
+
+#include "GLState.h"
+
+// 2d texture used as a growable array, element i is at texel (i % width, i / width).
+// WebGL2 has no texture buffers, shaders read the elements with texelFetch.
+class DataTexture {
+public:
+    // internalFormat, format and type as in glTexImage2D, texelSize in bytes
+    DataTexture(GLenum internalFormat, GLenum format, GLenum type, uint32_t texelSize, uint32_t width)
+        : m_internalFormat{internalFormat}, m_format{format}, m_type{type}, m_texelSize{texelSize}, m_width{width} {
+        glGenTextures(1, &m_texture);
+        GLState::BindTexture(0, GL_TEXTURE_2D, m_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        Reserve(m_width);
+    }
+    ~DataTexture() {
+        if (m_texture != 0) glDeleteTextures(1, &m_texture);
+    }
+    DataTexture(const DataTexture&) = delete;
+    DataTexture& operator=(const DataTexture&) = delete;
+    DataTexture(DataTexture&&) = delete;
+    DataTexture& operator=(DataTexture&&) = delete;
+
+    GLuint GetTexture() const { return m_texture; }
+    uint32_t GetWidth() const { return m_width; }
+
+    // replaces texels [0, texelCount), the texture grows if needed and keeps its size afterwards
+    void Update(const void* data, uint32_t texelCount) {
+        if (texelCount == 0) return;
+        Reserve(texelCount);
+        Upload(static_cast<const uint8_t*>(data), texelCount);
+    }
+    // same as Update, but copies from a buffer on the gpu (e.g. a StreamBuffer allocation)
+    void Update(GLuint buffer, GLintptr offset, uint32_t texelCount) {
+        if (texelCount == 0) return;
+        Reserve(texelCount); // before binding, glTexImage2D would read from the unpack buffer
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        Upload(reinterpret_cast<const uint8_t*>(offset), texelCount);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+private:
+    void Upload(const uint8_t* source, uint32_t texelCount) {
+        const uint32_t fullRows = texelCount / m_width;
+        const uint32_t remainder = texelCount % m_width;
+        if (fullRows > 0) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, fullRows, m_format, m_type, source);
+        }
+        if (remainder > 0) { // partial last row, so no padding is uploaded
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, fullRows, remainder, 1, m_format, m_type,
+                source + static_cast<std::size_t>(fullRows) * m_width * m_texelSize);
+        }
+    }
+    // binds the texture and grows it to hold texelCount texels
+    void Reserve(uint32_t texelCount) {
+        GLState::BindTexture(0, GL_TEXTURE_2D, m_texture);
+        const uint32_t rows = (texelCount + m_width - 1) / m_width;
+        if (rows <= m_height) return;
+        m_height = std::max(rows, m_height * 2);
+        glTexImage2D(GL_TEXTURE_2D, 0, m_internalFormat, m_width, m_height, 0, m_format, m_type, nullptr);
+    }
+
+    GLenum m_internalFormat;
+    GLenum m_format;
+    GLenum m_type;
+    uint32_t m_texelSize;
+    uint32_t m_width;
+    uint32_t m_height = 0;
+    GLuint m_texture = 0;
+};
@@ -4,6 +4,7 @@
 #include <vector>
 #include <iostream>
 
+#include "GLState.h"
 #include "Highlights.h"
 
 GLDebugDrawer::GLDebugDrawer() : m_debugMode(0) {}
@@ -27,33 +28,31 @@ void GLDebugDrawer::setDebugMode(int debugMode) {
 
 void DebugDraw::Init() {
     if (m_vao) return;
+    // vertices are in the stream buffer, the attribute pointers are set in Draw
     glGenVertexArrays(1, &m_vao);
     glBindVertexArray(m_vao);
-    glGenBuffers(1, &m_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vert), (void*)offsetof(vert, position));
     glEnableVertexAttribArray(1);
-    glVertexAttribIPointer(1, 1, GL_UNSIGNED_BYTE, sizeof(vert), (void*)offsetof(vert, highlightId));
     glBindVertexArray(0);
 }
 void DebugDraw::Deinit() {
     if (!m_vao) return;
     glDeleteVertexArrays(1, &m_vao);
-    glDeleteBuffers(1, &m_vbo);
     m_vao = 0;
-    m_vbo = 0;
 }
 void DebugDraw::Clear() {
     m_vertices.clear();
 }
-void DebugDraw::Draw() {
+void DebugDraw::Draw(StreamBuffer& streamBuffer) {
     if (!m_enabled) return;
     if (m_vertices.empty()) return;
 
-    glBindVertexArray(m_vao);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(vert), m_vertices.data(), GL_DYNAMIC_DRAW);
+    const auto allocation = streamBuffer.Upload(m_vertices.data(), m_vertices.size() * sizeof(vert));
+    const auto offset = [&](std::size_t member) { return reinterpret_cast<void*>(allocation.offset + member); };
+    GLState::BindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, allocation.buffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vert), offset(offsetof(vert, position)));
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_BYTE, sizeof(vert), offset(offsetof(vert, highlightId)));
     glDrawArrays(GL_LINES, 0, m_vertices.size());
     m_vertices.clear();
 }
@@ -4,6 +4,8 @@
 #include <btBulletDynamicsCommon.h>
 #include <glm/glm.hpp>
 
+#include "StreamBuffer.h"
+
 class GLDebugDrawer : public btIDebugDraw {
 public:
     GLDebugDrawer();
@@ -27,7 +29,8 @@ public:
     static void Init();
     static void Deinit();
     static void Clear();
-    static void Draw();
+    // uploads the lines of this frame into the stream buffer and draws them
+    static void Draw(StreamBuffer& streamBuffer);
 
     static void DrawLine(const glm::vec3& from, const glm::vec3& to, const glm::vec3& color);
     static void DrawSphere(const glm::vec3& p, float radius, const glm::vec3& color);
@@ -48,5 +51,5 @@ private:
     static inline bool m_enabled = false;
     static inline GLDebugDrawer m_debugDrawer;
     static inline std::vector<vert> m_vertices;
-    static inline uint32_t m_vao, m_vbo;
+    static inline uint32_t m_vao;
 };
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "DepthReduction.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+
+DepthReduction::DepthReduction() {
+	glGenTextures(1, &m_texture);
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, m_width, m_height, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenFramebuffers(1, &m_fbo);
+	GLState::BindFramebuffer(m_fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) printf("Error: Failed to create depth reduction framebuffer.\n");
+	GLState::BindFramebuffer(0);
+
+	m_pixels.resize(static_cast<std::size_t>(m_width) * m_height * 4);
+	glGenBuffers(1, &m_pixelBuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(m_pixels.size() * sizeof(uint32_t)), nullptr, GL_STREAM_READ);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+DepthReduction::~DepthReduction() {
+	Clear();
+	glDeleteBuffers(1, &m_pixelBuffer);
+	glDeleteFramebuffers(1, &m_fbo);
+	glDeleteTextures(1, &m_texture);
+}
+void DepthReduction::Reduce(ShaderProgram& program, GLuint depthTexture) {
+	if (m_fence) return;
+
+	GLState::BindFramebuffer(m_fbo);
+	GLState::Viewport(m_width, m_height);
+	program.Use();
+	program.SetTexture("tDepth", GL_TEXTURE_2D, 0, depthTexture);
+	// no depth attachment, so the depth test passes
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// into the pixel pack buffer, the cpu only touches it once the fence signaled
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffer);
+	glReadPixels(0, 0, m_width, m_height, GL_RGBA_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+bool DepthReduction::Collect(float& minDepth, float& maxDepth) {
+	if (!m_fence) return false;
+	const GLenum status = glClientWaitSync(m_fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED) return false;
+	Clear();
+	// GL_WAIT_FAILED or a lost context, the pixel buffer is not safe to read
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffer);
+	glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(m_pixels.size() * sizeof(uint32_t)), m_pixels.data());
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	minDepth = 1.0f;
+	maxDepth = 0.0f;
+	for (std::size_t i = 0; i < m_pixels.size(); i += 4) {
+		if (m_pixels[i + 1] == 0) continue; // sky only
+		minDepth = std::min(minDepth, std::bit_cast<float>(m_pixels[i]));
+		maxDepth = std::max(maxDepth, std::bit_cast<float>(m_pixels[i + 1]));
+	}
+	return true;
+}
+void DepthReduction::Clear() {
+	if (m_fence) glDeleteSync(m_fence);
+	m_fence = nullptr;
+}
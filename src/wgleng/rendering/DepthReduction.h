@@ -0,0 +1,41 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <stdint.h>
+#include <vector>
+
+#include "ShaderProgram.h"
+
+// Min / max depth of the gbuffer for sample distribution shadow maps. The depth texture is reduced to
+// m_width x m_height texels on the gpu, each taking the min and max of a sparse grid of samples in its block.
+// The result is read into a pixel pack buffer and collected once its fence signaled, usually one or two frames
+// later. No new reduction is started while one is in flight.
+class DepthReduction {
+public:
+	DepthReduction();
+	~DepthReduction();
+	DepthReduction(const DepthReduction&) = delete;
+	DepthReduction& operator=(const DepthReduction&) = delete;
+	DepthReduction(DepthReduction&&) = delete;
+	DepthReduction& operator=(DepthReduction&&) = delete;
+
+	// draws the reduction and starts reading it back, leaves the reduction framebuffer and viewport bound
+	void Reduce(ShaderProgram& program, GLuint depthTexture);
+	// true if a readback finished. depths are in [0, 1], minDepth > maxDepth if there was nothing but sky
+	bool Collect(float& minDepth, float& maxDepth);
+	// drops the readback in flight
+	void Clear();
+
+	constexpr static uint32_t GetWidth() { return m_width; }
+	constexpr static uint32_t GetHeight() { return m_height; }
+
+private:
+	constexpr static inline uint32_t m_width = 32;
+	constexpr static inline uint32_t m_height = 16;
+
+	GLuint m_fbo = 0;
+	GLuint m_texture = 0; // GL_RG32UI, float bits of the min and max depth, 0 if no sample hit geometry
+	GLuint m_pixelBuffer = 0;
+	GLsync m_fence = nullptr;
+	std::vector<uint32_t> m_pixels; // rgba per texel, integer formats are read back with 4 channels
+};
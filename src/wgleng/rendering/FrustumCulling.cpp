@@ -1,5 +1,11 @@
 #include "FrustumCulling.h"
 
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 FrustumCulling::FrustumCulling(const glm::mat4& projxview, Plane ignoredPlanes) {
 	const glm::mat4 mat = glm::transpose(projxview);
 	m_planes.reserve(6);
@@ -52,3 +58,88 @@ bool FrustumCulling::IsAabbVisible(const glm::vec3& aabbMin, const glm::vec3& aa
 
 	return IsAabbVisible(newMin, newMax);
 }
+
+FrustumCulling::Intersection FrustumCulling::ClassifyAabb(const glm::vec3& aabbMin, const glm::vec3& aabbMax) const {
+	const glm::vec3 center = (aabbMax + aabbMin) * 0.5f;
+	const glm::vec3 extent = (aabbMax - aabbMin) * 0.5f;
+	Intersection result = Intersection::Inside;
+	for (const auto& g : m_planes) {
+		const glm::vec3 normal{g};
+		const float dist = glm::dot(normal, center) + g.w;
+		const float radius = glm::dot(glm::abs(normal), extent);
+		// every corner is behind the plane
+		if (dist + radius < 0.0f) return Intersection::Outside;
+		if (dist - radius < 0.0f) result = Intersection::Intersecting;
+	}
+	return result;
+}
+
+void FrustumCulling::CullAabbs(const AabbBatch& aabbs, uint32_t* visibleMask) const {
+	const std::size_t wordCount = (aabbs.count + 31) / 32;
+	for (std::size_t i = 0; i < wordCount; i++) visibleMask[i] = 0;
+
+	// center / extent test: box is outside if dot(n, c) + w + dot(|n|, e) < 0 for any plane
+	const std::size_t planeCount = m_planes.size();
+	glm::vec4 planes[6];
+	glm::vec3 absNormals[6];
+	for (std::size_t p = 0; p < planeCount; p++) {
+		planes[p] = m_planes[p];
+		absNormals[p] = glm::abs(glm::vec3(m_planes[p]));
+	}
+
+	std::size_t i = 0;
+#if defined(__wasm_simd128__)
+	for (; i + 4 <= aabbs.count; i += 4) {
+		const v128_t cx = wasm_v128_load(aabbs.centerX + i);
+		const v128_t cy = wasm_v128_load(aabbs.centerY + i);
+		const v128_t cz = wasm_v128_load(aabbs.centerZ + i);
+		const v128_t ex = wasm_v128_load(aabbs.extentX + i);
+		const v128_t ey = wasm_v128_load(aabbs.extentY + i);
+		const v128_t ez = wasm_v128_load(aabbs.extentZ + i);
+		v128_t visible = wasm_i32x4_splat(-1);
+		for (std::size_t p = 0; p < planeCount; p++) {
+			v128_t dist = wasm_f32x4_splat(planes[p].w);
+			dist = wasm_f32x4_add(dist, wasm_f32x4_mul(cx, wasm_f32x4_splat(planes[p].x)));
+			dist = wasm_f32x4_add(dist, wasm_f32x4_mul(cy, wasm_f32x4_splat(planes[p].y)));
+			dist = wasm_f32x4_add(dist, wasm_f32x4_mul(cz, wasm_f32x4_splat(planes[p].z)));
+			dist = wasm_f32x4_add(dist, wasm_f32x4_mul(ex, wasm_f32x4_splat(absNormals[p].x)));
+			dist = wasm_f32x4_add(dist, wasm_f32x4_mul(ey, wasm_f32x4_splat(absNormals[p].y)));
+			dist = wasm_f32x4_add(dist, wasm_f32x4_mul(ez, wasm_f32x4_splat(absNormals[p].z)));
+			visible = wasm_v128_and(visible, wasm_f32x4_ge(dist, wasm_f32x4_splat(0.0f)));
+		}
+		visibleMask[i / 32] |= static_cast<uint32_t>(wasm_i32x4_bitmask(visible)) << (i % 32);
+	}
+#elif defined(__SSE2__)
+	for (; i + 4 <= aabbs.count; i += 4) {
+		const __m128 cx = _mm_loadu_ps(aabbs.centerX + i);
+		const __m128 cy = _mm_loadu_ps(aabbs.centerY + i);
+		const __m128 cz = _mm_loadu_ps(aabbs.centerZ + i);
+		const __m128 ex = _mm_loadu_ps(aabbs.extentX + i);
+		const __m128 ey = _mm_loadu_ps(aabbs.extentY + i);
+		const __m128 ez = _mm_loadu_ps(aabbs.extentZ + i);
+		__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (std::size_t p = 0; p < planeCount; p++) {
+			__m128 dist = _mm_set1_ps(planes[p].w);
+			dist = _mm_add_ps(dist, _mm_mul_ps(cx, _mm_set1_ps(planes[p].x)));
+			dist = _mm_add_ps(dist, _mm_mul_ps(cy, _mm_set1_ps(planes[p].y)));
+			dist = _mm_add_ps(dist, _mm_mul_ps(cz, _mm_set1_ps(planes[p].z)));
+			dist = _mm_add_ps(dist, _mm_mul_ps(ex, _mm_set1_ps(absNormals[p].x)));
+			dist = _mm_add_ps(dist, _mm_mul_ps(ey, _mm_set1_ps(absNormals[p].y)));
+			dist = _mm_add_ps(dist, _mm_mul_ps(ez, _mm_set1_ps(absNormals[p].z)));
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+		}
+		visibleMask[i / 32] |= static_cast<uint32_t>(_mm_movemask_ps(visible)) << (i % 32);
+	}
+#endif
+	// scalar fallback and remainder
+	for (; i < aabbs.count; i++) {
+		bool visible = true;
+		for (std::size_t p = 0; p < planeCount && visible; p++) {
+			const float dist =
+				planes[p].x * aabbs.centerX[i] + planes[p].y * aabbs.centerY[i] + planes[p].z * aabbs.centerZ[i] + planes[p].w +
+				absNormals[p].x * aabbs.extentX[i] + absNormals[p].y * aabbs.extentY[i] + absNormals[p].z * aabbs.extentZ[i];
+			visible = dist >= 0.0f;
+		}
+		if (visible) visibleMask[i / 32] |= 1U << (i % 32);
+	}
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <stdint.h>
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -14,10 +16,27 @@ public:
 		Far    = 1 << 5,
 		None   = 0,
 	};
+	enum class Intersection {
+		Outside, Intersecting, Inside
+	};
+	// world space aabbs in center / half extent form, one array per component
+	struct AabbBatch {
+		const float* centerX;
+		const float* centerY;
+		const float* centerZ;
+		const float* extentX;
+		const float* extentY;
+		const float* extentZ;
+		std::size_t count;
+	};
 	FrustumCulling(const glm::mat4& projxview, Plane ignoredPlanes = Plane::None);
 
 	bool IsAabbVisible(const glm::vec3& aabbMin, const glm::vec3& aabbMax) const;
 	bool IsAabbVisible(const glm::vec3& aabbMin, const glm::vec3& aabbMax, const glm::mat4& model) const;
+	// aabb is in world space
+	Intersection ClassifyAabb(const glm::vec3& aabbMin, const glm::vec3& aabbMax) const;
+	// sets bit i of visibleMask if aabb i is visible. visibleMask needs (count + 31) / 32 words.
+	void CullAabbs(const AabbBatch& aabbs, uint32_t* visibleMask) const;
 
 private:
 	std::vector<glm::vec4> m_planes;
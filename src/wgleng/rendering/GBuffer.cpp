@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <array>
+#include <tuple>
 
 GBuffer::GBuffer(uint32_t width, uint32_t height)
     : m_width{width}, m_height{height} {
@@ -0,0 +1,17 @@
+#pragma once
+
+// WebGL2 extensions the renderer uses when they are available (see Renderer::CheckExtensionSupport).
+// emscripten implements the entry points in its webgl library, headless builds in GLRecorder.cpp
+#include <GLES3/gl3.h>
+
+// KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// WEBGL_multi_draw, shaders read gl_DrawID through GL_ANGLE_multi_draw
+extern "C" void glMultiDrawElementsInstancedWEBGL(GLenum mode, const GLsizei* counts, GLenum type,
+	const void* const* offsets, const GLsizei* instanceCounts, GLsizei drawCount);
+
+// WebGL2 getBufferSubData, GLES3 reads buffers back by mapping them which WebGL does not support
+extern "C" void glGetBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, void* data);
@@ -0,0 +1,61 @@
+#include "GLState.h"
+
+#include <algorithm>
+
+void GLState::UseProgram(GLuint program) {
+	if (Update(m_program, program)) glUseProgram(program);
+}
+void GLState::BindVertexArray(GLuint vertexArray) {
+	if (Update(m_vertexArray, vertexArray)) glBindVertexArray(vertexArray);
+}
+void GLState::BindFramebuffer(GLuint framebuffer) {
+	if (Update(m_framebuffer, framebuffer)) glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+void GLState::Viewport(int32_t width, int32_t height) {
+	Viewport(0, 0, width, height);
+}
+void GLState::Viewport(int32_t x, int32_t y, int32_t width, int32_t height) {
+	if (Update(m_viewport, {x, y, width, height})) glViewport(x, y, width, height);
+}
+void GLState::CullFace(GLenum face) {
+	if (Update(m_cullFace, face)) glCullFace(face);
+}
+void GLState::SetCapability(GLenum capability, bool enabled) {
+	GLuint* current = nullptr;
+	if (capability == GL_CULL_FACE) current = &m_cullFaceEnabled;
+	else if (capability == GL_DEPTH_TEST) current = &m_depthTestEnabled;
+	if (current && !Update(*current, static_cast<GLuint>(enabled))) return;
+	if (!current) m_issued++;
+	if (enabled) glEnable(capability);
+	else glDisable(capability);
+}
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture) {
+	// the unit is selected even if the bind is dropped, callers modify the texture through it
+	if (Update(m_activeTexture, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+	const int slot = target == GL_TEXTURE_2D ? 0 : target == GL_TEXTURE_2D_ARRAY ? 1 : -1;
+	if (unit < m_textureUnits && slot >= 0 && !Update(m_textures[unit][slot], texture)) return;
+	if (unit >= m_textureUnits || slot < 0) m_issued++;
+	glBindTexture(target, texture);
+}
+void GLState::BindUniformBuffer(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+	if (index < m_uniformBufferBindings && !Update(m_uniformBuffers[index], {buffer, offset, size})) return;
+	if (index >= m_uniformBufferBindings) m_issued++;
+	if (size == 0) glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+	else glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+}
+void GLState::Invalidate() {
+	m_program = m_unknown;
+	m_vertexArray = m_unknown;
+	m_framebuffer = m_unknown;
+	m_viewport = {-1, -1, -1, -1};
+	m_cullFace = m_unknown;
+	m_cullFaceEnabled = m_unknown;
+	m_depthTestEnabled = m_unknown;
+	m_activeTexture = m_unknown;
+	for (auto& unit : m_textures) std::ranges::fill(unit, m_unknown);
+	std::ranges::fill(m_uniformBuffers, UniformBufferRange{m_unknown, 0, 0});
+}
+void GLState::ResetCounters() {
+	m_issued = 0;
+	m_elided = 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <cstdint>
+
+// shadow copy of the gl state the renderer changes while drawing, calls that would set the current value are dropped.
+// code that changes this state directly (resource creation, imgui...) leaves the copy stale, call Invalidate afterwards
+class GLState {
+public:
+	GLState() = delete;
+
+	static void UseProgram(GLuint program);
+	static void BindVertexArray(GLuint vertexArray);
+	static void BindFramebuffer(GLuint framebuffer);
+	static void Viewport(int32_t width, int32_t height);
+	static void Viewport(int32_t x, int32_t y, int32_t width, int32_t height);
+	static void CullFace(GLenum face);
+	// GL_CULL_FACE and GL_DEPTH_TEST are tracked, others are always issued
+	static void SetCapability(GLenum capability, bool enabled);
+	// GL_TEXTURE_2D and GL_TEXTURE_2D_ARRAY on the first m_textureUnits units are tracked, unit is always left active
+	static void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	// whole buffer if size is 0
+	static void BindUniformBuffer(GLuint index, GLuint buffer, GLintptr offset = 0, GLsizeiptr size = 0);
+
+	// returns true if value differs from current and stores it, counts the change as issued or elided
+	template <typename T>
+	static bool Update(T& current, const T& value) {
+		if (current == value) {
+			m_elided++;
+			return false;
+		}
+		current = value;
+		m_issued++;
+		return true;
+	}
+
+	// forgets everything, the next call of each setter is issued
+	static void Invalidate();
+	// state changes of the frame, reset by ResetCounters
+	static uint32_t GetIssuedCount() { return m_issued; }
+	static uint32_t GetElidedCount() { return m_elided; }
+	static void ResetCounters();
+
+private:
+	constexpr static inline uint32_t m_textureUnits = 16;
+	constexpr static inline uint32_t m_uniformBufferBindings = 24; // WebGL2 minimum of GL_MAX_UNIFORM_BUFFER_BINDINGS
+
+	struct UniformBufferRange {
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+		bool operator==(const UniformBufferRange&) const = default;
+	};
+	struct ViewportRect {
+		int32_t x, y, width, height;
+		bool operator==(const ViewportRect&) const = default;
+	};
+
+	// Invalidate sets every value to m_unknown, no gl call passes it
+	constexpr static inline GLuint m_unknown = ~0U;
+	static inline GLuint m_program = m_unknown;
+	static inline GLuint m_vertexArray = m_unknown;
+	static inline GLuint m_framebuffer = m_unknown;
+	static inline ViewportRect m_viewport = {-1, -1, -1, -1};
+	static inline GLenum m_cullFace = m_unknown;
+	static inline GLuint m_cullFaceEnabled = m_unknown;
+	static inline GLuint m_depthTestEnabled = m_unknown;
+	static inline GLuint m_activeTexture = m_unknown;
+	static inline GLuint m_textures[m_textureUnits][2] = {}; // [unit][2d, 2d array]
+	static inline UniformBufferRange m_uniformBuffers[m_uniformBufferBindings] = {};
+
+	static inline uint32_t m_issued = 0;
+	static inline uint32_t m_elided = 0;
+};
@@ -0,0 +1,103 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+
+#include "GLState.h"
+
+GeometryArena::GeometryArena(uint32_t vertexSize, void (*setupAttributes)())
+	: m_setupAttributes{setupAttributes} {
+	m_vertices.elementSize = vertexSize;
+	m_indices.elementSize = sizeof(uint32_t);
+	glGenVertexArrays(1, &m_vao);
+}
+GeometryArena::~GeometryArena() {
+	if (m_vertices.buffer) glDeleteBuffers(1, &m_vertices.buffer);
+	if (m_indices.buffer) glDeleteBuffers(1, &m_indices.buffer);
+	glDeleteVertexArrays(1, &m_vao);
+}
+GeometryArena::Allocation GeometryArena::Allocate(const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexCount, GLenum indexType) {
+	const Allocation allocation{
+		.firstVertex = Reserve(m_vertices, vertexCount, GL_ARRAY_BUFFER),
+		.vertexCount = vertexCount,
+		.firstIndex = Reserve(m_indices, indexCount, GL_ELEMENT_ARRAY_BUFFER),
+		.indexCount = indexCount
+	};
+
+	// copy targets, binding the index buffer to GL_ELEMENT_ARRAY_BUFFER would change the bound vao
+	if (vertexCount > 0) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertices.buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(allocation.firstVertex) * m_vertices.elementSize,
+			static_cast<GLsizeiptr>(vertexCount) * m_vertices.elementSize, vertices);
+	}
+	if (indexCount > 0) {
+		std::vector<uint32_t> rebased(indexCount);
+		for (uint32_t i = 0; i < indexCount; i++) {
+			const uint32_t index = indexType == GL_UNSIGNED_SHORT ? static_cast<const uint16_t*>(indices)[i] : static_cast<const uint32_t*>(indices)[i];
+			rebased[i] = allocation.firstVertex + index;
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_indices.buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(allocation.firstIndex) * sizeof(uint32_t),
+			static_cast<GLsizeiptr>(indexCount) * sizeof(uint32_t), rebased.data());
+	}
+	return allocation;
+}
+void GeometryArena::Free(const Allocation& allocation) {
+	Release(m_vertices, {allocation.firstVertex, allocation.vertexCount});
+	Release(m_indices, {allocation.firstIndex, allocation.indexCount});
+}
+uint32_t GeometryArena::Reserve(Pool& pool, uint32_t count, GLenum target) {
+	if (count == 0) return 0;
+	auto it = std::ranges::find_if(pool.free, [&](const Range& range) { return range.count >= count; });
+	if (it == pool.free.end()) {
+		Grow(pool, count, target);
+		it = std::ranges::find_if(pool.free, [&](const Range& range) { return range.count >= count; });
+	}
+	const uint32_t offset = it->offset;
+	it->offset += count;
+	it->count -= count;
+	if (it->count == 0) pool.free.erase(it);
+	return offset;
+}
+void GeometryArena::Grow(Pool& pool, uint32_t count, GLenum target) {
+	// the free tail (if any) is extended, so only the missing part has to fit
+	const uint32_t tail = !pool.free.empty() && pool.free.back().offset + pool.free.back().count == pool.capacity ? pool.free.back().count : 0;
+	const uint32_t capacity = std::max({pool.capacity * 2, pool.capacity + count - tail, m_minCapacity});
+
+	// WebGL2 fixes the type of a buffer at its first bind, so it is bound to its own target (with the vao, the
+	// element array binding is part of it) before the copy targets. offsets stay the same, the vao only has to
+	// point at the new buffer
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	GLState::BindVertexArray(m_vao);
+	glBindBuffer(target, buffer);
+	glBufferData(target, static_cast<GLsizeiptr>(capacity) * pool.elementSize, nullptr, GL_STATIC_DRAW);
+	if (target == GL_ARRAY_BUFFER) m_setupAttributes();
+	GLState::BindVertexArray(0);
+
+	if (pool.buffer) {
+		glBindBuffer(GL_COPY_READ_BUFFER, pool.buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(pool.capacity) * pool.elementSize);
+		glDeleteBuffers(1, &pool.buffer);
+	}
+	pool.buffer = buffer;
+	Release(pool, {pool.capacity, capacity - pool.capacity});
+	pool.capacity = capacity;
+}
+void GeometryArena::Release(Pool& pool, Range range) {
+	if (range.count == 0) return;
+	auto next = std::ranges::lower_bound(pool.free, range.offset, {}, &Range::offset);
+	// merge with the neighbours
+	if (next != pool.free.end() && range.offset + range.count == next->offset) {
+		range.count += next->count;
+		next = pool.free.erase(next);
+	}
+	if (next != pool.free.begin()) {
+		auto prev = std::prev(next);
+		if (prev->offset + prev->count == range.offset) {
+			prev->count += range.count;
+			return;
+		}
+	}
+	pool.free.insert(next, range);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <cstdint>
+#include <vector>
+
+// vertex and index buffer pair shared by all static meshes of one vertex format, drawn with a single vao.
+// WebGL2 has no base vertex draws, so indices are stored rebased onto the mesh's first vertex and are always 32 bit.
+// freed ranges are reused first fit, the buffers double when nothing fits
+class GeometryArena {
+public:
+	struct Allocation {
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	// setupAttributes sets the vertex attribute pointers, it is called with the vao and vertex buffer bound
+	GeometryArena(uint32_t vertexSize, void (*setupAttributes)());
+	~GeometryArena();
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+	GeometryArena(GeometryArena&&) = delete;
+	GeometryArena& operator=(GeometryArena&&) = delete;
+
+	// indexType is GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	Allocation Allocate(const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexCount, GLenum indexType);
+	void Free(const Allocation& allocation);
+
+	GLuint GetVAO() const { return m_vao; }
+
+private:
+	struct Range {
+		uint32_t offset;
+		uint32_t count;
+	};
+	struct Pool {
+		GLuint buffer = 0;
+		uint32_t elementSize;
+		uint32_t capacity = 0; // in elements
+		std::vector<Range> free; // sorted by offset, never adjacent
+	};
+	uint32_t Reserve(Pool& pool, uint32_t count, GLenum target);
+	void Grow(Pool& pool, uint32_t count, GLenum target);
+	static void Release(Pool& pool, Range range);
+
+	constexpr static inline uint32_t m_minCapacity = 64 * 1024;
+	GLuint m_vao = 0;
+	void (*m_setupAttributes)();
+	Pool m_vertices;
+	Pool m_indices;
+};
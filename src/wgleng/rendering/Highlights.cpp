@@ -1,28 +1,34 @@
 #include "Highlights.h"
 
+#include <algorithm>
+
 uint8_t Highlights::AddHighlight(std::string_view name, const highlight& hl) {
 	uint8_t id = GetHighlightId(name);
 	if (id != 0) {
-		m_changed = true;
+		RemoveFromLookup(id);
 		m_highlights[id] = hl;
+		AddToLookup(id);
+		MarkChanged(id);
 		return id;
 	}
 	if (m_highlights.size() + 1 >= m_maxHighlights) return id;
 
-	m_changed = true;
 	id = m_highlights.size();
 	m_highlightIds[std::string(name)] = id;
 	m_highlights.push_back(hl);
+	AddToLookup(id);
+	MarkChanged(id);
 	return id;
 }
 
 uint8_t Highlights::AddHighlight(const highlight& hl) {
 	uint8_t id = 0;
 	if (m_highlights.size() + 1 >= m_maxHighlights) return id;
-	m_changed = true;
 
 	id = m_highlights.size();
 	m_highlights.push_back(hl);
+	AddToLookup(id);
+	MarkChanged(id);
 	return id;
 }
 
@@ -46,24 +52,70 @@ const std::vector<Highlights::highlight>& Highlights::GetHighlights() {
 }
 
 bool Highlights::GetClosestHighlightId(const glm::vec3& color, float epsilon, uint8_t& highlightId) {
-	for (unsigned int i = 0; i < m_highlights.size(); i++) {
-		const auto& h = m_highlights[i];
-		if (glm::distance(h.color, color) < epsilon) {
-			highlightId = i;
-			return true;
+	bool found = false;
+	float closest = epsilon;
+	const auto check = [&](uint8_t id) {
+		const float distance = glm::distance(m_highlights[id].color, color);
+		// ties go to the lowest id
+		if (distance < closest || (found && distance == closest && id < highlightId)) {
+			closest = distance;
+			highlightId = id;
+			found = true;
+		}
+	};
+	if (epsilon > m_lookupCellSize) {
+		for (uint32_t i = 0; i < m_highlights.size(); i++) check(i);
+		return found;
+	}
+	// anything within epsilon is at most one cell away
+	const glm::ivec3 center = GetLookupCellCoords(color);
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+			for (int z = -1; z <= 1; z++) {
+				const auto [begin, end] = m_colorLookup.equal_range(GetLookupCell(center + glm::ivec3{x, y, z}));
+				for (auto it = begin; it != end; ++it) check(it->second);
+			}
 		}
 	}
-	return false;
+	return found;
 }
 
 bool Highlights::HasChanged(bool reset) {
-	bool ret = m_changed;
-	if (reset) m_changed = false;
+	bool ret = m_changedBegin != m_changedEnd;
+	if (reset) m_changedBegin = m_changedEnd = 0;
 	return ret;
 }
 
+void Highlights::MarkChanged(uint32_t id) {
+	if (m_changedBegin == m_changedEnd) {
+		m_changedBegin = id;
+		m_changedEnd = id + 1;
+		return;
+	}
+	m_changedBegin = std::min(m_changedBegin, id);
+	m_changedEnd = std::max(m_changedEnd, id + 1);
+}
+glm::ivec3 Highlights::GetLookupCellCoords(const glm::vec3& color) {
+	return glm::ivec3(glm::floor(color / m_lookupCellSize));
+}
+uint64_t Highlights::GetLookupCell(const glm::ivec3& cell) {
+	// 21 bits per axis, colors are far inside that range
+	const auto axis = [](int32_t v) { return static_cast<uint64_t>(v) & 0x1fffff; };
+	return axis(cell.x) | axis(cell.y) << 21 | axis(cell.z) << 42;
+}
+void Highlights::AddToLookup(uint8_t id) {
+	m_colorLookup.emplace(GetLookupCell(GetLookupCellCoords(m_highlights[id].color)), id);
+}
+void Highlights::RemoveFromLookup(uint8_t id) {
+	const auto [begin, end] = m_colorLookup.equal_range(GetLookupCell(GetLookupCellCoords(m_highlights[id].color)));
+	for (auto it = begin; it != end; ++it) {
+		if (it->second != id) continue;
+		m_colorLookup.erase(it);
+		return;
+	}
+}
+
 void Highlights::Init() {
-	m_changed = true;
 	AddHighlight("default", { {0, 0, 0} });
 	AddHighlight("black",   { {-1, -1, -1} });
 	AddHighlight("white",   { {1, 1, 1} });
@@ -75,13 +127,13 @@ void Highlights::Init() {
 	AddHighlight("magenta", { {1, 0, 1} });
 }
 void Highlights::Deinit() {
-	m_changed = true;
+	m_changedBegin = m_changedEnd = 0;
 	m_highlightIds.clear();
+	m_colorLookup.clear();
 	m_highlights.clear();
 }
 
 void Highlights::Clear() {
-	m_changed = true;
 	Deinit();
 	Init();
 }
@@ -32,17 +32,30 @@ public:
 	static highlight GetHighlight(uint8_t highlightId);
 	static const std::vector<highlight>& GetHighlights();
 
+	// O(1) for epsilon up to m_lookupCellSize, larger epsilons scan every highlight
 	static bool GetClosestHighlightId(const glm::vec3& color, float epsilon, uint8_t& highlightId);
 
+	// highlight ids whose color changed since the last reset, [begin, end). the renderer uploads only these
 	static bool HasChanged(bool reset = false);
+	static std::pair<uint32_t, uint32_t> GetChangedRange() { return { m_changedBegin, m_changedEnd }; }
+	static constexpr uint32_t GetMaxHighlights() { return m_maxHighlights; }
 
 	static void Init();
 	static void Deinit();
 	static void Clear();
 
 private:
+	static void MarkChanged(uint32_t id);
+	static uint64_t GetLookupCell(const glm::ivec3& cell);
+	static glm::ivec3 GetLookupCellCoords(const glm::vec3& color);
+	static void AddToLookup(uint8_t id);
+	static void RemoveFromLookup(uint8_t id);
+
 	static inline constexpr uint32_t m_maxHighlights = 256;
-	static inline bool m_changed = false;
+	static inline constexpr float m_lookupCellSize = 0.02f;
+	static inline uint32_t m_changedBegin = 0;
+	static inline uint32_t m_changedEnd = 0;
 	static inline std::unordered_map<std::string, uint8_t> m_highlightIds;
+	static inline std::unordered_multimap<uint64_t, uint8_t> m_colorLookup; // color grid cell -> highlight ids
 	static inline std::vector<highlight> m_highlights;
 };
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "InstanceBvh.h"
+
+#include <algorithm>
+
+namespace {
+	float surfaceArea(const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
+		const glm::vec3 d = aabbMax - aabbMin;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+}
+
+int32_t InstanceBvh::Insert(const glm::vec3& aabbMin, const glm::vec3& aabbMax, uint32_t meshIndex, uint32_t instanceIndex) {
+	const int32_t leaf = AllocateNode();
+	Node& node = m_nodes[leaf];
+	node.height = 0;
+	node.meshIndex = meshIndex;
+	node.instanceIndex = instanceIndex;
+	SetFatAabb(node, aabbMin, aabbMax);
+	InsertLeaf(leaf);
+	return leaf;
+}
+
+void InstanceBvh::Remove(int32_t leaf) {
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+}
+
+void InstanceBvh::Move(int32_t leaf, const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
+	Node& node = m_nodes[leaf];
+	node.tightMin = aabbMin;
+	node.tightMax = aabbMax;
+	// still inside of the enlarged aabb, tree does not need to change
+	if (glm::all(glm::greaterThanEqual(aabbMin, node.min)) && glm::all(glm::lessThanEqual(aabbMax, node.max))) return;
+
+	RemoveLeaf(leaf);
+	SetFatAabb(m_nodes[leaf], aabbMin, aabbMax);
+	InsertLeaf(leaf);
+}
+
+void InstanceBvh::SetInstance(int32_t leaf, uint32_t meshIndex, uint32_t instanceIndex) {
+	m_nodes[leaf].meshIndex = meshIndex;
+	m_nodes[leaf].instanceIndex = instanceIndex;
+}
+
+void InstanceBvh::Clear() {
+	m_nodes.clear();
+	m_root = m_nullNode;
+	m_freeList = m_nullNode;
+}
+
+int32_t InstanceBvh::AllocateNode() {
+	int32_t index;
+	if (m_freeList != m_nullNode) {
+		index = m_freeList;
+		m_freeList = m_nodes[index].parent;
+	}
+	else {
+		index = static_cast<int32_t>(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+	Node& node = m_nodes[index];
+	node.parent = m_nullNode;
+	node.child1 = m_nullNode;
+	node.child2 = m_nullNode;
+	node.height = 0;
+	return index;
+}
+
+void InstanceBvh::FreeNode(int32_t index) {
+	m_nodes[index].parent = m_freeList;
+	m_nodes[index].height = -1;
+	m_freeList = index;
+}
+
+void InstanceBvh::SetFatAabb(Node& node, const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
+	// margin scales with size so big static props do not get reinserted by tiny moves
+	const glm::vec3 margin = (aabbMax - aabbMin) * 0.1f + 0.1f;
+	node.tightMin = aabbMin;
+	node.tightMax = aabbMax;
+	node.min = aabbMin - margin;
+	node.max = aabbMax + margin;
+}
+
+void InstanceBvh::InsertLeaf(int32_t leaf) {
+	if (m_root == m_nullNode) {
+		m_root = leaf;
+		m_nodes[leaf].parent = m_nullNode;
+		return;
+	}
+
+	// find best sibling, descending by surface area cost
+	const glm::vec3 leafMin = m_nodes[leaf].min;
+	const glm::vec3 leafMax = m_nodes[leaf].max;
+	int32_t index = m_root;
+	while (!m_nodes[index].IsLeaf()) {
+		const Node& node = m_nodes[index];
+		const float area = surfaceArea(node.min, node.max);
+		const float combinedArea = surfaceArea(glm::min(node.min, leafMin), glm::max(node.max, leafMax));
+
+		// cost of creating a new parent for this node and the new leaf
+		const float cost = 2.0f * combinedArea;
+		// minimum cost of pushing the leaf further down the tree
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		const auto childCost = [&](int32_t childIndex) {
+			const Node& child = m_nodes[childIndex];
+			const float newArea = surfaceArea(glm::min(child.min, leafMin), glm::max(child.max, leafMax));
+			if (child.IsLeaf()) return newArea + inheritanceCost;
+			return newArea - surfaceArea(child.min, child.max) + inheritanceCost;
+		};
+		const float cost1 = childCost(node.child1);
+		const float cost2 = childCost(node.child2);
+
+		if (cost < cost1 && cost < cost2) break;
+		index = cost1 < cost2 ? node.child1 : node.child2;
+	}
+	const int32_t sibling = index;
+
+	// create a new parent
+	const int32_t oldParent = m_nodes[sibling].parent;
+	const int32_t newParent = AllocateNode();
+	Node& parent = m_nodes[newParent];
+	parent.parent = oldParent;
+	parent.min = glm::min(m_nodes[sibling].min, leafMin);
+	parent.max = glm::max(m_nodes[sibling].max, leafMax);
+	parent.height = m_nodes[sibling].height + 1;
+	parent.child1 = sibling;
+	parent.child2 = leaf;
+	if (oldParent != m_nullNode) {
+		if (m_nodes[oldParent].child1 == sibling) m_nodes[oldParent].child1 = newParent;
+		else m_nodes[oldParent].child2 = newParent;
+	}
+	else {
+		m_root = newParent;
+	}
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	RefitAncestors(m_nodes[leaf].parent);
+}
+
+void InstanceBvh::RemoveLeaf(int32_t leaf) {
+	if (leaf == m_root) {
+		m_root = m_nullNode;
+		return;
+	}
+
+	const int32_t parent = m_nodes[leaf].parent;
+	const int32_t grandParent = m_nodes[parent].parent;
+	const int32_t sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	if (grandParent != m_nullNode) {
+		// destroy parent and connect sibling to grand parent
+		if (m_nodes[grandParent].child1 == parent) m_nodes[grandParent].child1 = sibling;
+		else m_nodes[grandParent].child2 = sibling;
+		m_nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+		RefitAncestors(grandParent);
+	}
+	else {
+		m_root = sibling;
+		m_nodes[sibling].parent = m_nullNode;
+		FreeNode(parent);
+	}
+}
+
+void InstanceBvh::RefitAncestors(int32_t index) {
+	while (index != m_nullNode) {
+		index = Balance(index);
+
+		Node& node = m_nodes[index];
+		const Node& child1 = m_nodes[node.child1];
+		const Node& child2 = m_nodes[node.child2];
+		node.height = 1 + std::max(child1.height, child2.height);
+		node.min = glm::min(child1.min, child2.min);
+		node.max = glm::max(child1.max, child2.max);
+
+		index = node.parent;
+	}
+}
+
+// if the tree is imbalanced, rotates A with its higher child and returns the new subtree root.
+// A has children B and C, B has children D and E, C has children F and G.
+int32_t InstanceBvh::Balance(int32_t iA) {
+	Node& A = m_nodes[iA];
+	if (A.IsLeaf() || A.height < 2) return iA;
+
+	const int32_t iB = A.child1;
+	const int32_t iC = A.child2;
+	Node& B = m_nodes[iB];
+	Node& C = m_nodes[iC];
+	const int32_t balance = C.height - B.height;
+
+	// rotate C up
+	if (balance > 1) {
+		const int32_t iF = C.child1;
+		const int32_t iG = C.child2;
+		Node& F = m_nodes[iF];
+		Node& G = m_nodes[iG];
+
+		// swap A and C
+		C.child1 = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+		if (C.parent != m_nullNode) {
+			if (m_nodes[C.parent].child1 == iA) m_nodes[C.parent].child1 = iC;
+			else m_nodes[C.parent].child2 = iC;
+		}
+		else {
+			m_root = iC;
+		}
+
+		// rotate
+		if (F.height > G.height) {
+			C.child2 = iF;
+			A.child2 = iG;
+			G.parent = iA;
+			A.min = glm::min(B.min, G.min);
+			A.max = glm::max(B.max, G.max);
+			C.min = glm::min(A.min, F.min);
+			C.max = glm::max(A.max, F.max);
+			A.height = 1 + std::max(B.height, G.height);
+			C.height = 1 + std::max(A.height, F.height);
+		}
+		else {
+			C.child2 = iG;
+			A.child2 = iF;
+			F.parent = iA;
+			A.min = glm::min(B.min, F.min);
+			A.max = glm::max(B.max, F.max);
+			C.min = glm::min(A.min, G.min);
+			C.max = glm::max(A.max, G.max);
+			A.height = 1 + std::max(B.height, F.height);
+			C.height = 1 + std::max(A.height, G.height);
+		}
+		return iC;
+	}
+
+	// rotate B up
+	if (balance < -1) {
+		const int32_t iD = B.child1;
+		const int32_t iE = B.child2;
+		Node& D = m_nodes[iD];
+		Node& E = m_nodes[iE];
+
+		// swap A and B
+		B.child1 = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+		if (B.parent != m_nullNode) {
+			if (m_nodes[B.parent].child1 == iA) m_nodes[B.parent].child1 = iB;
+			else m_nodes[B.parent].child2 = iB;
+		}
+		else {
+			m_root = iB;
+		}
+
+		// rotate
+		if (D.height > E.height) {
+			B.child2 = iD;
+			A.child1 = iE;
+			E.parent = iA;
+			A.min = glm::min(C.min, E.min);
+			A.max = glm::max(C.max, E.max);
+			B.min = glm::min(A.min, D.min);
+			B.max = glm::max(A.max, D.max);
+			A.height = 1 + std::max(C.height, E.height);
+			B.height = 1 + std::max(A.height, D.height);
+		}
+		else {
+			B.child2 = iE;
+			A.child1 = iD;
+			D.parent = iA;
+			A.min = glm::min(C.min, D.min);
+			A.max = glm::max(C.max, D.max);
+			B.min = glm::min(A.min, E.min);
+			B.max = glm::max(A.max, E.max);
+			A.height = 1 + std::max(C.height, D.height);
+			B.height = 1 + std::max(A.height, E.height);
+		}
+		return iB;
+	}
+
+	return iA;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <glm/glm.hpp>
+#include <span>
+#include <stdint.h>
+#include <vector>
+
+#include "FrustumCulling.h"
+
+// Dynamic bounding volume hierarchy over world space aabbs of mesh instances.
+// Leaves are kept in the tree with an enlarged aabb, so small movements only refit the leaf
+// instead of reinserting it. Tight aabbs are still used for the final leaf test.
+class InstanceBvh {
+public:
+	InstanceBvh() = default;
+
+	// returns leaf id
+	int32_t Insert(const glm::vec3& aabbMin, const glm::vec3& aabbMax, uint32_t meshIndex, uint32_t instanceIndex);
+	void Remove(int32_t leaf);
+	void Move(int32_t leaf, const glm::vec3& aabbMin, const glm::vec3& aabbMax);
+	void SetInstance(int32_t leaf, uint32_t meshIndex, uint32_t instanceIndex);
+	void Clear();
+
+	uint32_t GetHeight() const { return m_root == m_nullNode ? 0 : m_nodes[m_root].height; }
+	// enlarged bounds of all leaves, false if the tree is empty
+	bool GetBounds(glm::vec3& aabbMin, glm::vec3& aabbMax) const {
+		if (m_root == m_nullNode) return false;
+		aabbMin = m_nodes[m_root].min;
+		aabbMax = m_nodes[m_root].max;
+		return true;
+	}
+
+	// calls callback(meshIndex, instanceIndex, frustumMask) once for every leaf visible in at least one frustum.
+	// bit i of frustumMask is set if the leaf is visible in frustums[i]. Supports up to 32 frustums.
+	// leaves are collected in batches and tested with FrustumCulling::CullAabbs, callbacks keep the walk order
+	template <typename Callback>
+	void Cull(std::span<const FrustumCulling> frustums, Callback&& callback) const {
+		if (m_root == m_nullNode || frustums.empty()) return;
+		const uint32_t allFrustums = frustums.size() >= 32 ? ~0U : (1U << frustums.size()) - 1;
+
+		m_cullStack.clear();
+		m_cullStack.push_back({m_root, allFrustums, 0});
+		while (!m_cullStack.empty()) {
+			auto [index, active, inside] = m_cullStack.back();
+			m_cullStack.pop_back();
+
+			const Node& node = m_nodes[index];
+			if (node.IsLeaf()) {
+				if (m_leafBatch.count == m_leafBatchSize) CullLeafBatch(frustums, callback);
+				m_leafBatch.Add(index, node, active, inside);
+				continue;
+			}
+			// frustums that fully contain a parent also contain every child, so only test the rest
+			for (uint32_t test = active & ~inside; test != 0; test &= test - 1) {
+				const uint32_t f = std::countr_zero(test);
+				const auto result = frustums[f].ClassifyAabb(node.min, node.max);
+				if (result == FrustumCulling::Intersection::Outside) active &= ~(1U << f);
+				else if (result == FrustumCulling::Intersection::Inside) inside |= 1U << f;
+			}
+			if (active == 0) continue;
+
+			m_cullStack.push_back({node.child1, active, inside});
+			m_cullStack.push_back({node.child2, active, inside});
+		}
+		CullLeafBatch(frustums, callback);
+	}
+
+private:
+	static inline constexpr int32_t m_nullNode = -1;
+
+	struct Node {
+		bool IsLeaf() const { return child1 == m_nullNode; }
+
+		// enlarged for leaves
+		glm::vec3 min;
+		glm::vec3 max;
+		int32_t parent; // next free node if node is free
+		int32_t child1;
+		int32_t child2;
+		int32_t height; // leaf = 0, free = -1
+
+		// leaf only
+		glm::vec3 tightMin;
+		glm::vec3 tightMax;
+		uint32_t meshIndex;
+		uint32_t instanceIndex;
+	};
+	struct CullEntry {
+		int32_t node;
+		uint32_t active;
+		uint32_t inside;
+	};
+	// multiple of 32, one visibility mask word per 32 leaves
+	static inline constexpr uint32_t m_leafBatchSize = 256;
+	// tight aabbs of leaves in center / half extent form, see FrustumCulling::AabbBatch
+	struct LeafBatch {
+		std::array<int32_t, m_leafBatchSize> nodes;
+		std::array<uint32_t, m_leafBatchSize> active;
+		std::array<uint32_t, m_leafBatchSize> inside;
+		std::array<float, m_leafBatchSize> centerX, centerY, centerZ;
+		std::array<float, m_leafBatchSize> extentX, extentY, extentZ;
+		std::array<uint32_t, m_leafBatchSize / 32> visibleMask;
+		uint32_t count = 0;
+
+		void Add(int32_t index, const Node& node, uint32_t activeFrustums, uint32_t insideFrustums) {
+			const glm::vec3 center = (node.tightMax + node.tightMin) * 0.5f;
+			const glm::vec3 extent = (node.tightMax - node.tightMin) * 0.5f;
+			nodes[count] = index;
+			active[count] = activeFrustums;
+			inside[count] = insideFrustums;
+			centerX[count] = center.x;
+			centerY[count] = center.y;
+			centerZ[count] = center.z;
+			extentX[count] = extent.x;
+			extentY[count] = extent.y;
+			extentZ[count] = extent.z;
+			count++;
+		}
+	};
+
+	// tests the batched leaves against the frustums that do not contain their parents and empties the batch
+	template <typename Callback>
+	void CullLeafBatch(std::span<const FrustumCulling> frustums, Callback& callback) const {
+		auto& batch = m_leafBatch;
+		uint32_t tested = 0;
+		for (uint32_t i = 0; i < batch.count; i++) tested |= batch.active[i] & ~batch.inside[i];
+		const FrustumCulling::AabbBatch aabbs{
+			batch.centerX.data(), batch.centerY.data(), batch.centerZ.data(),
+			batch.extentX.data(), batch.extentY.data(), batch.extentZ.data(), batch.count
+		};
+		for (; tested != 0; tested &= tested - 1) {
+			const uint32_t f = std::countr_zero(tested);
+			frustums[f].CullAabbs(aabbs, batch.visibleMask.data());
+			for (uint32_t i = 0; i < batch.count; i++) {
+				const bool visible = batch.visibleMask[i / 32] >> (i % 32) & 1;
+				if (!visible && !(batch.inside[i] >> f & 1)) batch.active[i] &= ~(1U << f);
+			}
+		}
+		for (uint32_t i = 0; i < batch.count; i++) {
+			if (batch.active[i] == 0) continue;
+			const Node& node = m_nodes[batch.nodes[i]];
+			callback(node.meshIndex, node.instanceIndex, batch.active[i]);
+		}
+		batch.count = 0;
+	}
+
+	int32_t AllocateNode();
+	void FreeNode(int32_t index);
+	void InsertLeaf(int32_t leaf);
+	void RemoveLeaf(int32_t leaf);
+	int32_t Balance(int32_t index);
+	void SetFatAabb(Node& node, const glm::vec3& aabbMin, const glm::vec3& aabbMax);
+	void RefitAncestors(int32_t index);
+
+	std::vector<Node> m_nodes;
+	int32_t m_root = m_nullNode;
+	int32_t m_freeList = m_nullNode;
+	mutable std::vector<CullEntry> m_cullStack;
+	mutable LeafBatch m_leafBatch;
+};
@@ -1,41 +1,80 @@
 #include "Mesh.h"
 
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
 #include <vector>
 
+#include "GLState.h"
+#include "MeshPack.h"
+
 MeshImpl::MeshImpl(std::string_view name)
-	: m_name(name) {
-	glGenVertexArrays(1, &m_vao);
-	glGenBuffers(1, &m_vbo);
-	glGenBuffers(1, &m_ebo);
-}
+	: m_name(name) {}
 MeshImpl::~MeshImpl() {
-	if (m_vao == 0) return;
-	glDeleteBuffers(1, &m_ebo);
-	glDeleteBuffers(1, &m_vbo);
-	glDeleteVertexArrays(1, &m_vao);
+	Release();
 }
 
-void MeshImpl::Load(std::span<const Vertex> vertices, std::span<const Material> materials,
-	std::span<const uint32_t> indices, bool createAabb, bool wireframe) {
-	// materials
-	std::vector<uint32_t> mappedMaterials(materials.size());
-	for (std::size_t i = 0; i < mappedMaterials.size(); i++) {
-		const auto& material = materials[i];
-		// if material already exists, use that id
-		const auto& existingMaterials = MeshRegistry::GetMaterials();
-		bool found = false;
-		for (std::size_t j = 1; j < existingMaterials.size(); j++) {
-			if (glm::length(existingMaterials[j].diffuse - material.diffuse) < 0.004f) {
-				mappedMaterials[i] = j;
-				found = true;
-				break;
+namespace {
+	void setupVertexAttributes() {
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void*)offsetof(Vertex, materialId));
+	}
+	void setupQuantizedVertexAttributes() {
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(WMeshQuantizedVertex), (void*)offsetof(WMeshQuantizedVertex, position));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(WMeshQuantizedVertex), (void*)offsetof(WMeshQuantizedVertex, normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribIPointer(2, 1, GL_UNSIGNED_SHORT, sizeof(WMeshQuantizedVertex), (void*)offsetof(WMeshQuantizedVertex, materialId));
+	}
+
+	// maps a mesh's own material table onto the registry, reusing materials that already exist
+	std::vector<uint32_t> mapMaterials(std::span<const Material> materials) {
+		std::vector<uint32_t> mappedMaterials(materials.size());
+		for (std::size_t i = 0; i < mappedMaterials.size(); i++) {
+			const auto& material = materials[i];
+			// if material already exists, use that id
+			const auto& existingMaterials = MeshRegistry::GetMaterials();
+			bool found = false;
+			for (std::size_t j = 1; j < existingMaterials.size(); j++) {
+				if (glm::length(existingMaterials[j].diffuse - material.diffuse) < 0.004f) {
+					mappedMaterials[i] = j;
+					found = true;
+					break;
+				}
+			}
+			if (!found) {
+				MeshRegistry::CreateMaterial(material);
+				mappedMaterials[i] = existingMaterials.size() - 1;
 			}
 		}
-		if (!found) {
-			MeshRegistry::CreateMaterial(material);
-			mappedMaterials[i] = existingMaterials.size() - 1;
+		return mappedMaterials;
+	}
+
+	template <typename T>
+	std::vector<uint32_t> wireframeIndices(std::span<const T> indices) {
+		std::vector<uint32_t> wireframe;
+		wireframe.reserve(indices.size() * 2);
+		for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+			wireframe.push_back(indices[i]);
+			wireframe.push_back(indices[i + 1]);
+			wireframe.push_back(indices[i + 1]);
+			wireframe.push_back(indices[i + 2]);
+			wireframe.push_back(indices[i + 2]);
+			wireframe.push_back(indices[i]);
 		}
+		return wireframe;
 	}
+}
+
+void MeshImpl::Load(std::span<const Vertex> vertices, std::span<const Material> materials,
+	std::span<const uint32_t> indices, bool createAabb, bool wireframe, bool quantize, std::span<const WMeshLod> lods) {
+	// materials
+	const auto mappedMaterials = mapMaterials(materials);
 
 	// vertices
 	std::vector<Vertex> verts(vertices.size());
@@ -49,8 +88,10 @@ void MeshImpl::Load(std::span<const Vertex> vertices, std::span<const Material>
 		}
 	}
 
-	// aabb
-	if (createAabb) {
+	// aabb, quantized positions are stored relative to it
+	m_aabbMin = glm::vec3(0);
+	m_aabbMax = glm::vec3(0);
+	if (createAabb || quantize) {
 		m_aabbMin = glm::vec3(FLT_MAX);
 		m_aabbMax = glm::vec3(-FLT_MAX);
 		for (const auto& vert : verts) {
@@ -60,40 +101,242 @@ void MeshImpl::Load(std::span<const Vertex> vertices, std::span<const Material>
 	}
 
 	// wireframe
-	std::vector<uint32_t> wireframeIndices;
+	std::vector<uint32_t> lines;
+	if (wireframe) lines = wireframeIndices(indices);
+	const void* indexData = wireframe ? lines.data() : indices.data();
+	const std::size_t indexCount = wireframe ? lines.size() : indices.size();
+
+	if (quantize) {
+		std::vector<WMeshQuantizedVertex> packed(verts.size());
+		for (std::size_t i = 0; i < verts.size(); i++) {
+			const auto position = WMeshEncodePosition(verts[i].position, m_aabbMin, m_aabbMax);
+			const auto normal = WMeshEncodeNormal(verts[i].normal);
+			packed[i] = {
+				.position = {position.x, position.y, position.z},
+				.materialId = static_cast<uint16_t>(verts[i].materialId),
+				.normal = {normal.x, normal.y}
+			};
+		}
+		UploadQuantized(packed, indexData, indexCount, GL_UNSIGNED_INT);
+	}
+	else {
+		Upload(verts, indexData, indexCount, GL_UNSIGNED_INT);
+	}
+	const uint32_t usedLods = SetLods(lods, indices.size(), wireframe);
+	SetOccluderGeometry(indices, lods, usedLods, verts.size(), [&](uint32_t index) { return verts[index].position; });
+	if (!createAabb) {
+		m_aabbMin = glm::vec3(0);
+		m_aabbMax = glm::vec3(0);
+	}
+}
+bool MeshImpl::LoadPacked(std::span<const std::byte> data, bool wireframe) {
+	// validate
+	if (data.size() < sizeof(WMeshHeader)) {
+		printf("Mesh %s: pack too small\n", m_name.c_str());
+		return false;
+	}
+	WMeshHeader header;
+	memcpy(&header, data.data(), sizeof(header));
+	if (header.magic != WMESH_MAGIC || header.version != WMESH_VERSION) {
+		printf("Mesh %s: not a wmesh v%u pack\n", m_name.c_str(), WMESH_VERSION);
+		return false;
+	}
+	const bool quantized = header.vertexFormat == WMeshVertexFormat::QUANTIZED;
+	const std::size_t vertexSize = quantized ? sizeof(WMeshQuantizedVertex) : sizeof(Vertex);
+	const std::size_t indexSize = static_cast<std::size_t>(header.indexFormat);
+	const auto fits = [&](uint64_t offset, uint64_t count, uint64_t stride) {
+		return offset % 4 == 0 && offset + count * stride <= data.size();
+	};
+	if ((header.vertexFormat != WMeshVertexFormat::FLOAT32 && header.vertexFormat != WMeshVertexFormat::QUANTIZED) ||
+		(header.indexFormat != WMeshIndexFormat::UINT16 && header.indexFormat != WMeshIndexFormat::UINT32) ||
+		!fits(header.materialOffset, header.materialCount, sizeof(Material)) ||
+		!fits(header.lodOffset, header.lodCount, sizeof(WMeshLod)) ||
+		!fits(header.vertexOffset, header.vertexCount, vertexSize) ||
+		!fits(header.indexOffset, header.indexCount, indexSize)) {
+		printf("Mesh %s: corrupt wmesh pack\n", m_name.c_str());
+		return false;
+	}
+	// arena meshes share their buffers, an index past the vertices would draw another mesh
+	const std::byte* indexData = data.data() + header.indexOffset;
+	const auto indicesInRange = [&](auto indices) {
+		return std::ranges::all_of(indices, [&](uint32_t index) { return index < header.vertexCount; });
+	};
+	if (header.indexFormat == WMeshIndexFormat::UINT16 ?
+		!indicesInRange(std::span{reinterpret_cast<const uint16_t*>(indexData), header.indexCount}) :
+		!indicesInRange(std::span{reinterpret_cast<const uint32_t*>(indexData), header.indexCount})) {
+		printf("Mesh %s: wmesh pack index out of range\n", m_name.c_str());
+		return false;
+	}
+
+	// materials
+	const std::span materials{reinterpret_cast<const Material*>(data.data() + header.materialOffset), header.materialCount};
+	const auto mappedMaterials = mapMaterials(materials);
+	const auto mapMaterial = [&](uint32_t id) -> uint32_t {
+		return id < mappedMaterials.size() ? mappedMaterials[id] : 0;
+	};
+
+	// aabb is precomputed by objpacker
+	m_aabbMin = {header.aabbMin[0], header.aabbMin[1], header.aabbMin[2]};
+	m_aabbMax = {header.aabbMax[0], header.aabbMax[1], header.aabbMax[2]};
+
+	// indices are uploaded straight from the pack
+	GLenum indexType = header.indexFormat == WMeshIndexFormat::UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	std::size_t indexCount = header.indexCount;
+	std::vector<uint32_t> lines;
 	if (wireframe) {
-		wireframeIndices.reserve(indices.size() * 2);
-		for (std::size_t i = 0; i < indices.size(); i += 3) {
-			wireframeIndices.push_back(indices[i]);
-			wireframeIndices.push_back(indices[i + 1]);
-			wireframeIndices.push_back(indices[i + 1]);
-			wireframeIndices.push_back(indices[i + 2]);
-			wireframeIndices.push_back(indices[i + 2]);
-			wireframeIndices.push_back(indices[i]);
+		lines = header.indexFormat == WMeshIndexFormat::UINT16 ?
+			wireframeIndices(std::span{reinterpret_cast<const uint16_t*>(indexData), header.indexCount}) :
+			wireframeIndices(std::span{reinterpret_cast<const uint32_t*>(indexData), header.indexCount});
+		indexData = reinterpret_cast<const std::byte*>(lines.data());
+		indexType = GL_UNSIGNED_INT;
+		indexCount = lines.size();
+	}
+
+	// vertices, material ids always need remapping into the registry
+	const std::byte* vertexData = data.data() + header.vertexOffset;
+	if (quantized) {
+		std::vector<WMeshQuantizedVertex> verts(header.vertexCount);
+		memcpy(verts.data(), vertexData, verts.size() * sizeof(WMeshQuantizedVertex));
+		for (auto& vert : verts) vert.materialId = static_cast<uint16_t>(mapMaterial(vert.materialId));
+		UploadQuantized(verts, indexData, indexCount, indexType);
+	}
+	else {
+		std::vector<Vertex> verts(header.vertexCount);
+		memcpy(verts.data(), vertexData, verts.size() * sizeof(Vertex));
+		for (auto& vert : verts) vert.materialId = vert.materialId < 0 ? 0 : static_cast<int32_t>(mapMaterial(vert.materialId));
+		Upload(verts, indexData, indexCount, indexType);
+	}
+
+	std::vector<WMeshLod> lods(header.lodCount);
+	memcpy(lods.data(), data.data() + header.lodOffset, lods.size() * sizeof(WMeshLod));
+	const uint32_t usedLods = SetLods(lods, header.indexCount, wireframe);
+
+	// occluder geometry is read from the pack, indices may have been replaced by wireframe lines
+	const std::byte* packIndices = data.data() + header.indexOffset;
+	const auto getPosition = [&](uint32_t index) {
+		if (!quantized) {
+			glm::vec3 position;
+			memcpy(&position, vertexData + index * sizeof(Vertex) + offsetof(Vertex, position), sizeof(position));
+			return position;
 		}
-		indices = wireframeIndices;
+		glm::u16vec3 position;
+		memcpy(&position, vertexData + index * sizeof(WMeshQuantizedVertex) + offsetof(WMeshQuantizedVertex, position), sizeof(position));
+		return WMeshDecodePosition(position, m_aabbMin, m_aabbMax);
+	};
+	if (header.indexFormat == WMeshIndexFormat::UINT16) {
+		SetOccluderGeometry(std::span{reinterpret_cast<const uint16_t*>(packIndices), header.indexCount}, lods, usedLods, header.vertexCount, getPosition);
+	}
+	else {
+		SetOccluderGeometry(std::span{reinterpret_cast<const uint32_t*>(packIndices), header.indexCount}, lods, usedLods, header.vertexCount, getPosition);
+	}
+	return true;
+}
+void MeshImpl::Store(const void* vertices, std::size_t vertexCount, bool quantized, const void* indices, std::size_t indexCount, GLenum indexType) {
+	Release();
+	if (GeometryArena* arena = MeshRegistry::GetGeometryArena(quantized)) {
+		m_allocation = arena->Allocate(vertices, static_cast<uint32_t>(vertexCount), indices, static_cast<uint32_t>(indexCount), indexType);
+		m_arena = arena;
+		m_vao = arena->GetVAO();
+		m_indexType = GL_UNSIGNED_INT;
+		m_indexByteOffset = m_allocation.firstIndex * sizeof(uint32_t);
+		return;
 	}
 
-	glBindVertexArray(m_vao);
+	// own buffers
+	const std::size_t vertexSize = quantized ? sizeof(WMeshQuantizedVertex) : sizeof(Vertex);
+	const std::size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vbo);
+	glGenBuffers(1, &m_ebo);
+	GLState::BindVertexArray(m_vao);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * verts.size(), verts.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertexSize * vertexCount, vertices, GL_STATIC_DRAW);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glEnableVertexAttribArray(2);
-	glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void*)offsetof(Vertex, materialId));
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize * indexCount, indices, GL_STATIC_DRAW);
+	if (quantized) setupQuantizedVertexAttributes();
+	else setupVertexAttributes();
+	GLState::BindVertexArray(0);
+	m_indexType = indexType;
+	m_indexByteOffset = 0;
+}
+void MeshImpl::Release() {
+	if (m_arena) {
+		m_arena->Free(m_allocation);
+		m_arena = nullptr;
+	}
+	else if (m_vao) {
+		glDeleteBuffers(1, &m_ebo);
+		glDeleteBuffers(1, &m_vbo);
+		glDeleteVertexArrays(1, &m_vao);
+	}
+	m_vao = 0;
+	m_vbo = 0;
+	m_ebo = 0;
+}
+uint32_t MeshImpl::SetLods(std::span<const WMeshLod> lods, std::size_t indexCount, bool wireframe) {
+	// wireframe turns every 3 triangle indices into 6 line indices
+	const uint32_t scale = wireframe ? 2 : 1;
+	const uint32_t indexSize = m_indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	m_lods.clear();
+	for (const auto& lod : lods) {
+		if (m_lods.size() == WMESH_MAX_LODS) {
+			printf("Mesh %s: only %u lods are supported\n", m_name.c_str(), WMESH_MAX_LODS);
+			break;
+		}
+		if (static_cast<uint64_t>(lod.indexOffset) + lod.indexCount > indexCount || lod.indexOffset % 3 != 0 || lod.indexCount % 3 != 0) {
+			printf("Mesh %s: lod %zu is out of range, ignoring it\n", m_name.c_str(), m_lods.size());
+			break;
+		}
+		m_lods.push_back({lod.indexCount * scale, m_indexByteOffset + lod.indexOffset * scale * indexSize, lod.error});
+	}
+	const auto usedLods = static_cast<uint32_t>(m_lods.size());
+	if (m_lods.empty()) m_lods.push_back({static_cast<uint32_t>(indexCount * scale), m_indexByteOffset, 0});
+	return usedLods;
+}
+template <typename T, typename GetPosition>
+void MeshImpl::SetOccluderGeometry(std::span<const T> indices, std::span<const WMeshLod> lods, uint32_t usedLods, std::size_t vertexCount, GetPosition&& getPosition) {
+	m_occluderGeometry = {};
+	if (usedLods > 0) indices = indices.subspan(lods[usedLods - 1].indexOffset, lods[usedLods - 1].indexCount);
+	if (indices.size() / 3 > m_maxOccluderTriangles) return;
+
+	// only the vertices the lod uses
+	std::unordered_map<uint32_t, uint32_t> remap;
+	m_occluderGeometry.indices.reserve(indices.size());
+	for (const T index : indices) {
+		if (index >= vertexCount) {
+			m_occluderGeometry = {};
+			return;
+		}
+		const auto [it, inserted] = remap.try_emplace(index, static_cast<uint32_t>(m_occluderGeometry.positions.size()));
+		if (inserted) m_occluderGeometry.positions.push_back(getPosition(index));
+		m_occluderGeometry.indices.push_back(it->second);
+	}
+}
+void MeshImpl::Upload(std::span<const Vertex> vertices, const void* indices, std::size_t indexCount, GLenum indexType) {
+	Store(vertices.data(), vertices.size(), false, indices, indexCount, indexType);
 
-	m_drawCount = indices.size();
+	m_positionOffset = glm::vec3(0);
+	m_positionScale = glm::vec3(1);
+	m_quantized = false;
+}
+void MeshImpl::UploadQuantized(std::span<const WMeshQuantizedVertex> vertices, const void* indices, std::size_t indexCount, GLenum indexType) {
+	Store(vertices.data(), vertices.size(), true, indices, indexCount, indexType);
+
+	m_positionOffset = m_aabbMin;
+	m_positionScale = m_aabbMax - m_aabbMin;
+	m_quantized = true;
+}
+void MeshImpl::Bind() const {
+	GLState::BindVertexArray(m_vao);
+}
+bool MeshImpl::CanDrawWith(const MeshImpl& other) const {
+	// dequantization is set per draw, so quantized arena meshes with different bounds still share a call
+	return m_vao == other.m_vao && m_indexType == other.m_indexType && m_quantized == other.m_quantized;
 }
 void MeshImpl::Unload() {
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-	glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
-	m_drawCount = 0;
+	Release();
+	m_lods = {{0, 0, 0}};
+	m_occluderGeometry = {};
 }
 
 Mesh MeshRegistry::Create(std::string_view name) {
@@ -114,7 +357,19 @@ void MeshRegistry::CreateMaterial(const Material& material) {
 const std::vector<Material>& MeshRegistry::GetMaterials() {
 	return m_materials;
 }
+GeometryArena* MeshRegistry::GetGeometryArena(bool quantized) {
+	if (!m_geometryArenaEnabled) return nullptr;
+	auto& arena = quantized ? m_quantizedArena : m_arena;
+	if (!arena) {
+		arena = quantized ?
+			std::make_unique<GeometryArena>(sizeof(WMeshQuantizedVertex), setupQuantizedVertexAttributes) :
+			std::make_unique<GeometryArena>(sizeof(Vertex), setupVertexAttributes);
+	}
+	return arena.get();
+}
 void MeshRegistry::Clear() {
 	m_meshes.clear();
 	m_materials.clear();
+	m_arena.reset();
+	m_quantizedArena.reset();
 }
@@ -1,12 +1,16 @@
 #pragma once
 
 #include <GLES3/gl3.h>
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <span>
 
+#include "GeometryArena.h"
+#include "MeshPack.h"
 #include "Vertex.h"
 
 class MeshImpl;
@@ -19,8 +23,14 @@ public:
 	MeshImpl(const MeshImpl&) = delete;
 	MeshImpl& operator=(const MeshImpl&) = delete;
 
+	// quantize stores 12 byte vertices (see WMeshQuantizedVertex) on the gpu instead of 28 byte ones.
+	// lods are ranges of indices, if empty all indices form a single lod
 	void Load(std::span<const Vertex> vertices, std::span<const Material> materials,
-		std::span<const uint32_t> indices, bool createAabb = true, bool wireframe = false);
+		std::span<const uint32_t> indices, bool createAabb = true, bool wireframe = false, bool quantize = false,
+		std::span<const WMeshLod> lods = {});
+	// loads a .wmesh pack (see MeshPack.h), e.g. a fetched or mmapped file. the buffer can be freed afterwards.
+	// returns false if the pack is malformed
+	bool LoadPacked(std::span<const std::byte> data, bool wireframe = false);
 
 	// returns {aabb_min, aabb_max} if createAabb was true, otherwise {0, 0}
 	std::pair<glm::vec3, glm::vec3> GetAabb() const { return { m_aabbMin, m_aabbMax }; }
@@ -28,16 +38,60 @@ public:
 	void Unload();
 	const std::string& GetName() const { return m_name; }
 	GLuint GetVAO() const { return m_vao; }
-	std::size_t GetDrawCount() const { return m_drawCount; }
+	void Bind() const;
+	// true if other draws with the same bound state, so both can be drawn by one multi draw call
+	bool CanDrawWith(const MeshImpl& other) const;
+	bool IsQuantized() const { return m_quantized; }
+	// dequantization of each draw (see Renderer::DrawBatches): position = offset + stored position * scale,
+	// scale.w is 1 if normals are octahedral encoded
+	glm::vec4 GetPositionOffset() const { return {m_positionOffset, 0}; }
+	glm::vec4 GetPositionScale() const { return {m_positionScale, m_quantized ? 1 : 0}; }
+	// index count of lod 0
+	std::size_t GetDrawCount() const { return m_lods[0].indexCount; }
+	GLenum GetIndexType() const { return m_indexType; }
+
+	struct Lod {
+		uint32_t indexCount;
+		uint32_t indexByteOffset; // pass as the indices pointer of glDrawElements*
+		float error; // object space simplification error, 0 for lod 0
+	};
+	uint32_t GetLodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+	const Lod& GetLod(uint32_t lod) const { return m_lods[lod]; }
+
+	// cpu copy of the coarsest lod for occlusion culling, empty if it has more than m_maxOccluderTriangles triangles
+	struct OccluderGeometry {
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+	};
+	const OccluderGeometry& GetOccluderGeometry() const { return m_occluderGeometry; }
 
 private:
+	void Upload(std::span<const Vertex> vertices, const void* indices, std::size_t indexCount, GLenum indexType);
+	void UploadQuantized(std::span<const WMeshQuantizedVertex> vertices, const void* indices, std::size_t indexCount, GLenum indexType);
+	// into the geometry arena if enabled, own buffers otherwise
+	void Store(const void* vertices, std::size_t vertexCount, bool quantized, const void* indices, std::size_t indexCount, GLenum indexType);
+	void Release();
+	// returns how many of lods were used
+	uint32_t SetLods(std::span<const WMeshLod> lods, std::size_t indexCount, bool wireframe);
+	template <typename T, typename GetPosition>
+	void SetOccluderGeometry(std::span<const T> indices, std::span<const WMeshLod> lods, uint32_t usedLods, std::size_t vertexCount, GetPosition&& getPosition);
+
 	std::string m_name;
-	GLuint m_vao;
-	GLuint m_vbo;
-	GLuint m_ebo;
-	std::size_t m_drawCount;
+	GLuint m_vao = 0;
+	GLuint m_vbo = 0; // 0 in the arena
+	GLuint m_ebo = 0;
+	GeometryArena* m_arena = nullptr;
+	GeometryArena::Allocation m_allocation{};
+	uint32_t m_indexByteOffset = 0; // of the first index, lod offsets include it
+	std::vector<Lod> m_lods{{0, 0, 0}};
+	GLenum m_indexType = GL_UNSIGNED_INT;
+	constexpr static inline uint32_t m_maxOccluderTriangles = 256;
+	OccluderGeometry m_occluderGeometry;
 	glm::vec3 m_aabbMin{0};
 	glm::vec3 m_aabbMax{0};
+	glm::vec3 m_positionOffset{0};
+	glm::vec3 m_positionScale{1};
+	bool m_quantized = false;
 };
 
 class MeshRegistry {
@@ -49,6 +103,11 @@ public:
 	static Mesh Get(std::string_view name);
 	static void Destroy(std::string_view name);
 
+	// meshes loaded while enabled share one vao per vertex format (see GeometryArena), on by default
+	static void SetGeometryArenaEnabled(bool enabled) { m_geometryArenaEnabled = enabled; }
+	// nullptr if disabled
+	static GeometryArena* GetGeometryArena(bool quantized);
+
 	static void CreateMaterial(const Material& material);
 	static const std::vector<Material>& GetMaterials();
 	// TODO: delete materials. Requires changing all meshes that use the material
@@ -56,6 +115,10 @@ public:
 	static void Clear();
 
 private:
+	// declared before m_meshes, meshes free their ranges on destruction
+	static inline bool m_geometryArenaEnabled = true;
+	static inline std::unique_ptr<GeometryArena> m_arena;
+	static inline std::unique_ptr<GeometryArena> m_quantizedArena;
 	static inline std::unordered_map<std::string, MeshImpl> m_meshes;
 	static inline std::vector<Material> m_materials = {
 		{{1, 0, 1, 1}} // default material
@@ -0,0 +1,222 @@
+#include "MeshInstances.h"
+
+#include "../core/Components.h"
+#include "../core/PhysicsWorld.h"
+#include "../util/ModelMatrix.h"
+
+MeshInstanceStore::MeshInstanceStore(entt::registry& registry)
+	: m_registry{registry} {
+	m_registry.on_construct<MeshComponent>().connect<&MeshInstanceStore::OnChanged>(*this);
+	m_registry.on_update<MeshComponent>().connect<&MeshInstanceStore::OnChanged>(*this);
+	m_registry.on_destroy<MeshComponent>().connect<&MeshInstanceStore::OnChanged>(*this);
+	m_registry.on_construct<TransformComponent>().connect<&MeshInstanceStore::OnChanged>(*this);
+	m_registry.on_update<TransformComponent>().connect<&MeshInstanceStore::OnChanged>(*this);
+	m_registry.on_destroy<TransformComponent>().connect<&MeshInstanceStore::OnChanged>(*this);
+	m_registry.on_construct<RigidBodyComponent>().connect<&MeshInstanceStore::OnChanged>(*this);
+	m_registry.on_update<RigidBodyComponent>().connect<&MeshInstanceStore::OnChanged>(*this);
+	m_registry.on_destroy<RigidBodyComponent>().connect<&MeshInstanceStore::OnChanged>(*this);
+	m_registry.ctx().emplace<MeshInstanceStore*>(this);
+}
+MeshInstanceStore::~MeshInstanceStore() {
+	m_registry.on_construct<MeshComponent>().disconnect(this);
+	m_registry.on_update<MeshComponent>().disconnect(this);
+	m_registry.on_destroy<MeshComponent>().disconnect(this);
+	m_registry.on_construct<TransformComponent>().disconnect(this);
+	m_registry.on_update<TransformComponent>().disconnect(this);
+	m_registry.on_destroy<TransformComponent>().disconnect(this);
+	m_registry.on_construct<RigidBodyComponent>().disconnect(this);
+	m_registry.on_update<RigidBodyComponent>().disconnect(this);
+	m_registry.on_destroy<RigidBodyComponent>().disconnect(this);
+	m_registry.ctx().erase<MeshInstanceStore*>();
+}
+
+void MeshInstanceStore::OnChanged(entt::registry& /*reg*/, entt::entity entity) {
+	// components are not final yet (on_destroy is called before removal), so only remember the entity
+	m_dirty.push_back(entity);
+}
+
+void MeshInstanceStore::Highlight(entt::registry& registry, entt::entity entity, uint8_t highlightId) {
+	const auto meshComp = registry.try_get<MeshComponent>(entity);
+	if (!meshComp) return;
+	// entities already flagged are in the list
+	const auto store = registry.ctx().find<MeshInstanceStore*>();
+	if (store && meshComp->highlightId == 0 && !meshComp->hidden) (*store)->m_frameFlagged.push_back(entity);
+	meshComp->highlightId = highlightId;
+}
+void MeshInstanceStore::Hide(entt::registry& registry, entt::entity entity) {
+	const auto meshComp = registry.try_get<MeshComponent>(entity);
+	if (!meshComp) return;
+	const auto store = registry.ctx().find<MeshInstanceStore*>();
+	if (store && meshComp->highlightId == 0 && !meshComp->hidden) (*store)->m_frameFlagged.push_back(entity);
+	meshComp->hidden = true;
+}
+void MeshInstanceStore::ResetFrameFlags() {
+	for (const auto entity : m_frameFlagged) {
+		// destroyed entities are not found, even if their id was reused
+		if (const auto meshComp = m_registry.try_get<MeshComponent>(entity)) {
+			meshComp->hidden = false;
+			meshComp->highlightId = 0;
+		}
+	}
+	m_frameFlagged.clear();
+}
+
+void MeshInstanceStore::Update(const PhysicsWorld& physicsWorld) {
+	m_updatedCount = 0;
+
+	// entities changed through the registry
+	for (const auto entity : m_dirty) {
+		Refresh(entity);
+	}
+	m_dirty.clear();
+
+	// rigid bodies moved by the physics world. sleeping and static bodies keep their matrices.
+	const auto& bodies = physicsWorld.dynamicsWorld->getNonStaticRigidBodies();
+	for (int i = 0; i < bodies.size(); i++) {
+		const auto body = bodies[i];
+		if (!body->isActive()) continue;
+		const auto userData = static_cast<RigidBodyUserData*>(body->getUserPointer());
+		if (!userData) continue;
+		const auto it = m_slots.find(userData->entity);
+		if (it == m_slots.end()) continue;
+		auto& instances = m_meshInstances[it->second.meshIndex];
+		auto& model = instances.models[it->second.instanceIndex];
+		if (!ComputeModel(userData->entity, model)) continue;
+		m_updatedCount++;
+
+		glm::vec3 aabbMin, aabbMax;
+		ComputeWorldAabb(instances.mesh, model, aabbMin, aabbMax);
+		m_bvh.Move(instances.bvhLeaves[it->second.instanceIndex], aabbMin, aabbMax);
+	}
+}
+
+void MeshInstanceStore::Refresh(entt::entity entity) {
+	glm::mat4 model;
+	if (!m_registry.valid(entity) || !ComputeModel(entity, model)) {
+		Remove(entity);
+		return;
+	}
+	m_updatedCount++;
+	const Mesh mesh = m_registry.get<MeshComponent>(entity).mesh;
+	glm::vec3 aabbMin, aabbMax;
+	ComputeWorldAabb(mesh, model, aabbMin, aabbMax);
+	const auto rbComp = m_registry.try_get<RigidBodyComponent>(entity);
+	const uint8_t dynamic = rbComp && !rbComp->body->isStaticObject();
+
+	// already stored, update in place if mesh is the same
+	const auto slotIt = m_slots.find(entity);
+	if (slotIt != m_slots.end()) {
+		auto& instances = m_meshInstances[slotIt->second.meshIndex];
+		if (instances.mesh == mesh) {
+			const uint32_t index = slotIt->second.instanceIndex;
+			// an instance that moves after it was inserted stays dynamic, so an animated prop only invalidates
+			// the static casters once instead of every frame
+			const uint8_t moved = instances.models[index] != model;
+			if (!instances.dynamic[index] && (dynamic || moved)) m_staticRevision++;
+			instances.models[index] = model;
+			instances.dynamic[index] |= dynamic | moved;
+			m_bvh.Move(instances.bvhLeaves[index], aabbMin, aabbMax);
+			return;
+		}
+		Remove(entity);
+	}
+	if (!dynamic) m_staticRevision++;
+
+	// insert
+	auto [meshIt, inserted] = m_meshIndices.try_emplace(mesh, static_cast<uint32_t>(m_meshInstances.size()));
+	if (inserted && !m_freeMeshIndices.empty()) {
+		meshIt->second = m_freeMeshIndices.back();
+		m_freeMeshIndices.pop_back();
+		m_meshInstances[meshIt->second].mesh = mesh;
+	}
+	else if (inserted) m_meshInstances.push_back({.mesh = mesh, .entities = {}, .models = {}, .bvhLeaves = {}, .dynamic = {}});
+	auto& instances = m_meshInstances[meshIt->second];
+	m_slots[entity] = {
+		.meshIndex = meshIt->second,
+		.instanceIndex = static_cast<uint32_t>(instances.entities.size())
+	};
+	instances.entities.push_back(entity);
+	instances.models.push_back(model);
+	instances.dynamic.push_back(dynamic);
+	instances.bvhLeaves.push_back(m_bvh.Insert(aabbMin, aabbMax, meshIt->second, instances.entities.size() - 1));
+}
+
+void MeshInstanceStore::Remove(entt::entity entity) {
+	const auto it = m_slots.find(entity);
+	if (it == m_slots.end()) return;
+	const Slot slot = it->second;
+	m_slots.erase(it);
+
+	// swap with last instance to keep arrays dense
+	auto& instances = m_meshInstances[slot.meshIndex];
+	if (!instances.dynamic[slot.instanceIndex]) m_staticRevision++;
+	m_bvh.Remove(instances.bvhLeaves[slot.instanceIndex]);
+	if (slot.instanceIndex != instances.entities.size() - 1) {
+		instances.entities[slot.instanceIndex] = instances.entities.back();
+		instances.models[slot.instanceIndex] = instances.models.back();
+		instances.bvhLeaves[slot.instanceIndex] = instances.bvhLeaves.back();
+		instances.dynamic[slot.instanceIndex] = instances.dynamic.back();
+		m_slots[instances.entities[slot.instanceIndex]].instanceIndex = slot.instanceIndex;
+		m_bvh.SetInstance(instances.bvhLeaves[slot.instanceIndex], slot.meshIndex, slot.instanceIndex);
+	}
+	instances.entities.pop_back();
+	instances.models.pop_back();
+	instances.bvhLeaves.pop_back();
+	instances.dynamic.pop_back();
+
+	// the entry is reused by the next new mesh, the mesh itself may be destroyed by now
+	if (instances.entities.empty()) {
+		m_meshIndices.erase(instances.mesh);
+		instances.mesh = nullptr;
+		m_freeMeshIndices.push_back(slot.meshIndex);
+	}
+}
+
+bool MeshInstanceStore::ComputeModel(entt::entity entity, glm::mat4& model) const {
+	const auto meshComp = m_registry.try_get<MeshComponent>(entity);
+	if (!meshComp || !meshComp->mesh) return false;
+
+	// rigid body takes priority over transform
+	if (const auto rbComp = m_registry.try_get<RigidBodyComponent>(entity)) {
+		const auto body = rbComp->body;
+		if (!body) return false;
+
+		btTransform transform;
+		if (body->getMotionState()) body->getMotionState()->getWorldTransform(transform);
+		else transform = body->getWorldTransform();
+
+		transform.setOrigin(transform.getOrigin() + btVector3(meshComp->position.x, meshComp->position.y, meshComp->position.z));
+		glm::vec3 euler{};
+		transform.getRotation().getEulerZYX(euler.z, euler.y, euler.x);
+		glm::vec3 objPos = glm::vec3(transform.getOrigin().x(), transform.getOrigin().y(), transform.getOrigin().z());
+
+		model = computeModelMatrix(
+			objPos - meshComp->position, meshComp->position,
+			euler, glm::radians(meshComp->rotation),
+			meshComp->scale);
+		return true;
+	}
+	if (const auto transformComp = m_registry.try_get<TransformComponent>(entity)) {
+		model = computeModelMatrix(
+			transformComp->position, meshComp->position,
+			glm::radians(transformComp->rotation), glm::radians(meshComp->rotation),
+			transformComp->scale * meshComp->scale);
+		return true;
+	}
+	return false;
+}
+
+void MeshInstanceStore::ComputeWorldAabb(Mesh mesh, const glm::mat4& model, glm::vec3& aabbMin, glm::vec3& aabbMax) {
+	const auto [localMin, localMax] = mesh->GetAabb();
+	const glm::vec3 center = (localMax + localMin) * 0.5f;
+	const glm::vec3 extent = (localMax - localMin) * 0.5f;
+
+	const glm::mat3 basis{model};
+	const glm::vec3 worldCenter = basis * center + glm::vec3(model[3]);
+	const glm::vec3 worldExtent =
+		glm::abs(basis[0]) * extent.x +
+		glm::abs(basis[1]) * extent.y +
+		glm::abs(basis[2]) * extent.z;
+	aabbMin = worldCenter - worldExtent;
+	aabbMax = worldCenter + worldExtent;
+}
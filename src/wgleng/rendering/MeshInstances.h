@@ -0,0 +1,80 @@
+#pragma once
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "InstanceBvh.h"
+#include "Mesh.h"
+
+class PhysicsWorld;
+
+// Persistent model matrices for every entity that has a MeshComponent and a TransformComponent or RigidBodyComponent.
+// Matrices are only recomputed for entities that moved since the last update:
+//     - MeshComponent / TransformComponent / RigidBodyComponent changes are picked up through the registry
+//       (emplace, replace, patch). Changing their fields directly without patch will not be noticed.
+//     - rigid bodies are refreshed every update while they are awake in the physics world.
+// The store registers itself in the context of the registry, so the per frame flags can be set with only the registry.
+class MeshInstanceStore {
+public:
+	MeshInstanceStore(entt::registry& registry);
+	~MeshInstanceStore();
+	MeshInstanceStore(const MeshInstanceStore&) = delete;
+	MeshInstanceStore& operator=(const MeshInstanceStore&) = delete;
+	MeshInstanceStore(MeshInstanceStore&&) = delete;
+	MeshInstanceStore& operator=(MeshInstanceStore&&) = delete;
+
+	struct MeshInstances {
+		Mesh mesh;
+		std::vector<entt::entity> entities;
+		std::vector<glm::mat4> models;
+		std::vector<int32_t> bvhLeaves;
+		std::vector<uint8_t> dynamic; // 1 for non static rigid bodies and anything that moved after it was inserted
+	};
+
+	void Update(const PhysicsWorld& physicsWorld);
+
+	// per frame flags of MeshComponent, ResetFrameFlags clears them once the frame is rendered. only entities flagged
+	// through these are reset, so resetting does not walk every entity
+	static void Highlight(entt::registry& registry, entt::entity entity, uint8_t highlightId);
+	static void Hide(entt::registry& registry, entt::entity entity);
+	void ResetFrameFlags();
+
+	// index of a mesh stays the same while it has instances. entries without instances have no mesh and are reused
+	std::vector<MeshInstances>& GetMeshInstances() { return m_meshInstances; }
+	const std::vector<MeshInstances>& GetMeshInstances() const { return m_meshInstances; }
+	std::size_t GetInstanceCount() const { return m_slots.size(); }
+	// amount of model matrices recomputed during the last update
+	uint32_t GetUpdatedCount() const { return m_updatedCount; }
+	// changes whenever a static (not dynamic) instance is added or removed, or becomes dynamic
+	uint64_t GetStaticRevision() const { return m_staticRevision; }
+	// world space aabbs of all instances, refitted on every update
+	const InstanceBvh& GetBvh() const { return m_bvh; }
+
+	// world space aabb of the transformed local aabb of mesh
+	static void ComputeWorldAabb(Mesh mesh, const glm::mat4& model, glm::vec3& aabbMin, glm::vec3& aabbMax);
+
+private:
+	void OnChanged(entt::registry& reg, entt::entity entity);
+	void Refresh(entt::entity entity);
+	void Remove(entt::entity entity);
+	bool ComputeModel(entt::entity entity, glm::mat4& model) const;
+
+	struct Slot {
+		uint32_t meshIndex;
+		uint32_t instanceIndex;
+	};
+
+	entt::registry& m_registry;
+	std::vector<MeshInstances> m_meshInstances;
+	std::unordered_map<Mesh, uint32_t> m_meshIndices;
+	std::unordered_map<entt::entity, Slot> m_slots;
+	std::vector<entt::entity> m_dirty;
+	std::vector<entt::entity> m_frameFlagged;
+	std::vector<uint32_t> m_freeMeshIndices;
+	InstanceBvh m_bvh;
+	uint32_t m_updatedCount = 0;
+	uint64_t m_staticRevision = 0;
+};
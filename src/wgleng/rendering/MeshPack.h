@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+
+// .wmesh, binary mesh container written by objpacker. Shared with objpacker, so no engine includes here.
+// Little endian, every section starts 4 byte aligned, offsets are from the start of the file:
+//     WMeshHeader | materials (float4 diffuse) | lods | vertices | indices
+// All lods share the vertex buffer, each one is a range of the index buffer. Lod 0 is the full mesh.
+constexpr uint32_t WMESH_MAGIC = 0x48534d57; // "WMSH"
+constexpr uint32_t WMESH_VERSION = 2;
+constexpr uint16_t WMESH_NO_MATERIAL = 0xffff;
+constexpr uint32_t WMESH_MAX_LODS = 4;
+
+enum class WMeshVertexFormat : uint32_t {
+	FLOAT32   = 0, // same layout as Vertex, 28 bytes
+	QUANTIZED = 1, // WMeshQuantizedVertex, 12 bytes
+};
+enum class WMeshIndexFormat : uint32_t {
+	UINT16 = 2,
+	UINT32 = 4,
+};
+
+struct WMeshHeader {
+	uint32_t magic;
+	uint32_t version;
+	WMeshVertexFormat vertexFormat;
+	WMeshIndexFormat indexFormat;
+	uint32_t materialCount;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t lodCount;
+	uint32_t materialOffset;
+	uint32_t lodOffset;
+	uint32_t vertexOffset;
+	uint32_t indexOffset;
+	float aabbMin[3];
+	float aabbMax[3];
+};
+static_assert(sizeof(WMeshHeader) == 72);
+
+// error is the object space simplification error, used to pick a lod from projected screen size
+struct WMeshLod {
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	float error;
+	uint32_t reserved;
+};
+static_assert(sizeof(WMeshLod) == 16);
+
+// position is unorm16 inside the header aabb, normal is octahedral snorm16,
+// materialId indexes the file's material table or is WMESH_NO_MATERIAL
+struct WMeshQuantizedVertex {
+	uint16_t position[3];
+	uint16_t materialId;
+	int16_t normal[2];
+};
+static_assert(sizeof(WMeshQuantizedVertex) == 12);
+
+inline glm::i16vec2 WMeshEncodeNormal(glm::vec3 n) {
+	n /= glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+	glm::vec2 oct{n.x, n.y};
+	if (n.z < 0) {
+		oct = (1.0f - glm::abs(glm::vec2{n.y, n.x})) * glm::vec2{n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1};
+	}
+	return glm::i16vec2(glm::round(glm::clamp(oct, -1.0f, 1.0f) * 32767.0f));
+}
+inline glm::vec3 WMeshDecodeNormal(glm::i16vec2 encoded) {
+	const glm::vec2 oct = glm::max(glm::vec2(encoded) / 32767.0f, -1.0f);
+	glm::vec3 n{oct.x, oct.y, 1.0f - glm::abs(oct.x) - glm::abs(oct.y)};
+	const float t = glm::max(-n.z, 0.0f);
+	n.x += n.x >= 0 ? -t : t;
+	n.y += n.y >= 0 ? -t : t;
+	return glm::normalize(n);
+}
+
+inline glm::u16vec3 WMeshEncodePosition(const glm::vec3& p, const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
+	const glm::vec3 extent = glm::max(aabbMax - aabbMin, glm::vec3{1e-6f});
+	return glm::u16vec3(glm::round(glm::clamp((p - aabbMin) / extent, 0.0f, 1.0f) * 65535.0f));
+}
+inline glm::vec3 WMeshDecodePosition(const glm::u16vec3& p, const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
+	return aabbMin + glm::vec3(p) / 65535.0f * (aabbMax - aabbMin);
+}
@@ -0,0 +1,156 @@
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <utility>
+
+OcclusionCulling::OcclusionCulling() {
+	uint32_t width = m_width;
+	uint32_t height = m_height;
+	while (true) {
+		const uint32_t stride = (width + 7) / 8 * 8;
+		m_levels.push_back({width, height, stride, std::vector<float>(static_cast<std::size_t>(stride) * height, 1.0f)});
+		if (width == 1 && height == 1) break;
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+}
+void OcclusionCulling::Begin(const glm::mat4& projxview) {
+	m_projxview = projxview;
+	m_triangleCount = 0;
+	std::ranges::fill(m_levels[0].depth, 1.0f);
+}
+bool OcclusionCulling::RasterizeOccluder(const MeshImpl::OccluderGeometry& geometry, const glm::mat4& model) {
+	const auto triangles = static_cast<uint32_t>(geometry.indices.size() / 3);
+	if (m_triangleCount + triangles > m_maxTriangles) return false;
+	m_triangleCount += triangles;
+
+	const glm::mat4 transform = m_projxview * model;
+	m_screenPositions.resize(geometry.positions.size());
+	for (std::size_t i = 0; i < geometry.positions.size(); i++) {
+		const glm::vec4 clip = transform * glm::vec4(geometry.positions[i], 1);
+		if (clip.w <= 0 || clip.z < -clip.w) { // in front of the near plane
+			m_screenPositions[i] = {0, 0, -1};
+			continue;
+		}
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		m_screenPositions[i] = {(ndc.x * 0.5f + 0.5f) * m_width, (ndc.y * 0.5f + 0.5f) * m_height, ndc.z * 0.5f + 0.5f};
+	}
+	for (std::size_t i = 0; i + 2 < geometry.indices.size(); i += 3) {
+		const auto& a = m_screenPositions[geometry.indices[i]];
+		const auto& b = m_screenPositions[geometry.indices[i + 1]];
+		const auto& c = m_screenPositions[geometry.indices[i + 2]];
+		// clipping against the near plane is skipped, such triangles just do not occlude
+		if (a.z < 0 || b.z < 0 || c.z < 0) continue;
+		RasterizeTriangle(a, b, c);
+	}
+	return true;
+}
+void OcclusionCulling::RasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+	const auto edge = [](const glm::vec3& v0, const glm::vec3& v1, float x, float y) {
+		return (v1.x - v0.x) * (y - v0.y) - (v1.y - v0.y) * (x - v0.x);
+	};
+	// counter clockwise is front facing, back faces are hidden behind the front of a closed occluder anyway
+	const float area = edge(a, b, c.x, c.y);
+	if (area < 1e-6f) return;
+
+	// texels whose center is inside the bounds
+	const auto minX = static_cast<int32_t>(glm::max(glm::ceil(glm::min(a.x, glm::min(b.x, c.x)) - 0.5f), 0.0f));
+	const auto minY = static_cast<int32_t>(glm::max(glm::ceil(glm::min(a.y, glm::min(b.y, c.y)) - 0.5f), 0.0f));
+	const auto maxX = static_cast<int32_t>(glm::min(glm::floor(glm::max(a.x, glm::max(b.x, c.x)) - 0.5f), m_width - 1.0f));
+	const auto maxY = static_cast<int32_t>(glm::min(glm::floor(glm::max(a.y, glm::max(b.y, c.y)) - 0.5f), m_height - 1.0f));
+	if (minX > maxX || minY > maxY) return;
+
+	// edge functions are linear in x, stepped from the first texel center of each row
+	const float stepX0 = b.y - c.y, stepX1 = c.y - a.y, stepX2 = a.y - b.y;
+	const float invArea = 1.0f / area;
+	Level& level = m_levels[0];
+	for (int32_t y = minY; y <= maxY; y++) {
+		const float centerX = minX + 0.5f;
+		const float centerY = y + 0.5f;
+		const float row0 = edge(b, c, centerX, centerY);
+		const float row1 = edge(c, a, centerX, centerY);
+		const float row2 = edge(a, b, centerX, centerY);
+		// narrow the row to the span inside all edges, the inside test below still guards its ends
+		float first = 0.0f;
+		float last = static_cast<float>(maxX - minX);
+		for (const auto& [row, step] : {std::pair{row0, stepX0}, std::pair{row1, stepX1}, std::pair{row2, stepX2}}) {
+			if (step > 0) first = glm::max(first, glm::floor(-row / step));
+			else if (step < 0) last = glm::min(last, glm::ceil(-row / step));
+			else if (row < 0) last = -1.0f;
+		}
+		if (first > last) continue;
+		const auto begin = static_cast<int32_t>(first);
+		const auto end = static_cast<int32_t>(last) + 1;
+		float* depth = level.depth.data() + static_cast<std::size_t>(y) * level.stride + minX;
+		for (int32_t i = begin; i < end; i++) {
+			const float e0 = row0 + stepX0 * i;
+			const float e1 = row1 + stepX1 * i;
+			const float e2 = row2 + stepX2 * i;
+			const float z = (e0 * a.z + e1 * b.z + e2 * c.z) * invArea;
+			const bool inside = e0 >= 0 && e1 >= 0 && e2 >= 0;
+			depth[i] = inside ? glm::min(depth[i], z) : depth[i];
+		}
+	}
+}
+void OcclusionCulling::End() {
+	for (std::size_t l = 1; l < m_levels.size(); l++) {
+		const Level& src = m_levels[l - 1];
+		Level& dst = m_levels[l];
+		for (uint32_t y = 0; y < dst.height; y++) {
+			const float* row0 = src.depth.data() + static_cast<std::size_t>(y * 2) * src.stride;
+			const float* row1 = src.depth.data() + static_cast<std::size_t>(glm::min(y * 2 + 1, src.height - 1)) * src.stride;
+			float* out = dst.depth.data() + static_cast<std::size_t>(y) * dst.stride;
+			for (uint32_t x = 0; x < dst.width; x++) {
+				const uint32_t x1 = glm::min(x * 2 + 1, src.width - 1);
+				out[x] = glm::max(glm::max(row0[x * 2], row0[x1]), glm::max(row1[x * 2], row1[x1]));
+			}
+		}
+	}
+}
+bool OcclusionCulling::IsOccluded(const glm::vec3& aabbMin, const glm::vec3& aabbMax) const {
+	if (m_triangleCount == 0) return false;
+
+	// corners are the min corner plus any of the projected edges, in ndc
+	const glm::vec4 base = m_projxview * glm::vec4(aabbMin, 1);
+	const glm::vec3 size = aabbMax - aabbMin;
+	const glm::vec4 axisX = m_projxview[0] * size.x;
+	const glm::vec4 axisY = m_projxview[1] * size.y;
+	const glm::vec4 axisZ = m_projxview[2] * size.z;
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = 1.0f;
+	for (int i = 0; i < 8; i++) {
+		glm::vec4 clip = base;
+		if (i & 1) clip += axisX;
+		if (i & 2) clip += axisY;
+		if (i & 4) clip += axisZ;
+		if (clip.w <= 0 || clip.z < -clip.w) return false; // crosses the near plane
+		const float invW = 1.0f / clip.w;
+		minX = glm::min(minX, clip.x * invW);
+		minY = glm::min(minY, clip.y * invW);
+		maxX = glm::max(maxX, clip.x * invW);
+		maxY = glm::max(maxY, clip.y * invW);
+		minZ = glm::min(minZ, clip.z * invW);
+	}
+	const glm::vec2 screenMin{(minX * 0.5f + 0.5f) * m_width, (minY * 0.5f + 0.5f) * m_height};
+	const glm::vec2 screenMax{(maxX * 0.5f + 0.5f) * m_width, (maxY * 0.5f + 0.5f) * m_height};
+	const float nearestDepth = minZ * 0.5f + 0.5f;
+	if (screenMax.x < 0 || screenMax.y < 0 || screenMin.x >= m_width || screenMin.y >= m_height) return false;
+
+	// every texel the rectangle touches
+	const auto x0 = static_cast<uint32_t>(glm::max(screenMin.x, 0.0f));
+	const auto y0 = static_cast<uint32_t>(glm::max(screenMin.y, 0.0f));
+	const auto x1 = static_cast<uint32_t>(glm::min(screenMax.x, m_width - 1.0f));
+	const auto y1 = static_cast<uint32_t>(glm::min(screenMax.y, m_height - 1.0f));
+	uint32_t l = 0;
+	while (l + 1 < m_levels.size() &&
+		((x1 >> l) - (x0 >> l) + 1 > m_maxTestTexels || (y1 >> l) - (y0 >> l) + 1 > m_maxTestTexels)) l++;
+
+	const Level& level = m_levels[l];
+	for (uint32_t y = y0 >> l; y <= y1 >> l; y++) {
+		const float* row = level.depth.data() + static_cast<std::size_t>(y) * level.stride;
+		for (uint32_t x = x0 >> l; x <= x1 >> l; x++) {
+			if (nearestDepth <= row[x]) return false;
+		}
+	}
+	return true;
+}
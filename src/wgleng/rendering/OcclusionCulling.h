@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+#include "Mesh.h"
+
+// Software occlusion culling for the camera. Occluder meshes are rasterized into a small depth buffer,
+// instance aabbs are then tested against a max depth pyramid built from it.
+// Buffers are plain float rows padded to multiples of 8, so the clear, reduce and test loops auto vectorize
+// (wasm simd128 with -msimd128). Coverage is sampled at texel centers, occluder edges are not conservative.
+class OcclusionCulling {
+public:
+	OcclusionCulling();
+
+	// clears the depth buffer
+	void Begin(const glm::mat4& projxview);
+	// returns false if the triangle budget of the frame is used up, nothing is drawn then
+	bool RasterizeOccluder(const MeshImpl::OccluderGeometry& geometry, const glm::mat4& model);
+	// builds the pyramid, call before IsOccluded
+	void End();
+
+	// aabb is in world space. false if nothing was rasterized
+	bool IsOccluded(const glm::vec3& aabbMin, const glm::vec3& aabbMax) const;
+
+	uint32_t GetRasterizedTriangleCount() const { return m_triangleCount; }
+
+private:
+	struct Level {
+		uint32_t width;
+		uint32_t height;
+		uint32_t stride; // width rounded up to 8
+		std::vector<float> depth; // [0, 1], 1 is the far plane
+	};
+	void RasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+	constexpr static inline uint32_t m_width = 256;
+	constexpr static inline uint32_t m_height = 128;
+	constexpr static inline uint32_t m_maxTriangles = 8192; // per frame
+	// the pyramid level tested against covers the aabb with at most this many texels per axis
+	constexpr static inline uint32_t m_maxTestTexels = 4;
+
+	glm::mat4 m_projxview{1};
+	std::vector<Level> m_levels; // 0 is the rasterized depth, level i + 1 is the max of 2x2 texels of level i
+	std::vector<glm::vec3> m_screenPositions; // scratch, x y in texels, z depth, w < 0 marked by a negative z
+	uint32_t m_triangleCount = 0;
+};
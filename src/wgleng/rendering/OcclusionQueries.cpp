@@ -0,0 +1,123 @@
+#include "OcclusionQueries.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLState.h"
+
+OcclusionQueries::OcclusionQueries() {
+	const uint8_t vertices[] = {
+		0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0,
+		0, 0, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1,
+	};
+	const uint8_t indices[] = {
+		0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+		3, 6, 2, 3, 7, 6, 1, 2, 6, 1, 6, 5, 0, 4, 7, 0, 7, 3,
+	};
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vbo);
+	glGenBuffers(1, &m_ebo);
+	GLState::BindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_UNSIGNED_BYTE, GL_FALSE, 3, nullptr);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	GLState::BindVertexArray(0);
+}
+OcclusionQueries::~OcclusionQueries() {
+	Clear();
+	glDeleteBuffers(1, &m_vbo);
+	glDeleteBuffers(1, &m_ebo);
+	glDeleteVertexArrays(1, &m_vao);
+}
+void OcclusionQueries::Update(const glm::vec3& cameraPosition, float nearPlane) {
+	m_frame++;
+	m_proxies.clear();
+	m_cameraPosition = cameraPosition;
+	m_nearPlane = nearPlane;
+
+	for (auto it = m_entries.begin(); it != m_entries.end();) {
+		Entry& entry = it->second;
+		if (entry.query) {
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint passed = GL_TRUE;
+				glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT, &passed);
+				entry.visible = passed != GL_FALSE;
+				m_freeQueries.push_back(entry.query);
+				entry.query = 0;
+			}
+		}
+		// destroyed or long culled entities
+		if (!entry.query && m_frame - entry.lastUsedFrame > m_maxUnusedFrames) it = m_entries.erase(it);
+		else ++it;
+	}
+}
+bool OcclusionQueries::Test(entt::entity entity, const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
+	if (aabbMin == aabbMax) return true; // mesh without aabb
+	Entry& entry = m_entries[entity];
+	entry.lastUsedFrame = m_frame;
+
+	// the near plane would cut away the faces in front of the camera
+	const glm::vec3 padding{m_nearPlane * 2};
+	if (glm::all(glm::greaterThan(m_cameraPosition, aabbMin - padding)) && glm::all(glm::lessThan(m_cameraPosition, aabbMax + padding))) {
+		entry.visible = true;
+		return true;
+	}
+	if (entry.query) return entry.visible;
+	// spread the retests of visible entities over the interval
+	const bool due = !entry.visible || (m_frame + static_cast<uint32_t>(entt::to_integral(entity))) % m_visibleTestInterval == 0;
+	if (due) m_proxies.push_back({&entry, aabbMin, aabbMax});
+	return entry.visible;
+}
+void OcclusionQueries::Draw(ShaderProgram& program) {
+	m_issuedCount = static_cast<uint32_t>(m_proxies.size());
+	if (m_proxies.empty()) return;
+
+	program.Use();
+	const GLint minLocation = program.GetUniformLocation("aabbMin");
+	const GLint maxLocation = program.GetUniformLocation("aabbMax");
+	GLState::BindVertexArray(m_vao);
+	// back faces still pass where the near plane cuts the front ones
+	GLState::SetCapability(GL_CULL_FACE, false);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_LEQUAL);
+	for (const auto& proxy : m_proxies) {
+		// padded so faces lying on the surface of the entity itself pass the depth test
+		const glm::vec3 padding = (proxy.aabbMax - proxy.aabbMin) * 0.01f + 0.01f;
+		glUniform3fv(minLocation, 1, glm::value_ptr(proxy.aabbMin - padding));
+		glUniform3fv(maxLocation, 1, glm::value_ptr(proxy.aabbMax + padding));
+		proxy.entry->query = AcquireQuery();
+		glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, proxy.entry->query);
+		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, nullptr);
+		glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+	}
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	GLState::SetCapability(GL_CULL_FACE, true);
+	m_proxies.clear();
+}
+void OcclusionQueries::Clear() {
+	for (const auto& [entity, entry] : m_entries) {
+		if (entry.query) m_freeQueries.push_back(entry.query);
+	}
+	if (!m_freeQueries.empty()) glDeleteQueries(static_cast<GLsizei>(m_freeQueries.size()), m_freeQueries.data());
+	m_freeQueries.clear();
+	m_entries.clear();
+	m_proxies.clear();
+	m_issuedCount = 0;
+}
+GLuint OcclusionQueries::AcquireQuery() {
+	if (m_freeQueries.empty()) {
+		GLuint query;
+		glGenQueries(1, &query);
+		return query;
+	}
+	const GLuint query = m_freeQueries.back();
+	m_freeQueries.pop_back();
+	return query;
+}
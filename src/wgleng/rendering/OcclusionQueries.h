@@ -0,0 +1,68 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "ShaderProgram.h"
+
+// Hardware occlusion queries for expensive entities. The world aabb of a tested entity is drawn against the
+// depth of the gbuffer with GL_ANY_SAMPLES_PASSED_CONSERVATIVE, results are read back once available, usually
+// one or two frames later. Until then the last known result decides whether the entity is drawn:
+//     - hidden entities are tested every frame, so they reappear a frame or two after becoming visible
+//     - visible entities are retested every m_visibleTestInterval frames
+//     - new entities and entities the camera is inside of count as visible
+class OcclusionQueries {
+public:
+	OcclusionQueries();
+	~OcclusionQueries();
+	OcclusionQueries(const OcclusionQueries&) = delete;
+	OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+	OcclusionQueries(OcclusionQueries&&) = delete;
+	OcclusionQueries& operator=(OcclusionQueries&&) = delete;
+
+	// collects finished queries and forgets the tests of the last frame, call once per frame before Test
+	void Update(const glm::vec3& cameraPosition, float nearPlane);
+	// returns the last known visibility and schedules a test of the aabb if one is due
+	bool Test(entt::entity entity, const glm::vec3& aabbMin, const glm::vec3& aabbMax);
+	// draws the aabbs scheduled by Test into the bound framebuffer, depth and color are left untouched
+	void Draw(ShaderProgram& program);
+	// deletes all queries, every entity counts as visible again
+	void Clear();
+
+	// queries issued by the last Draw
+	uint32_t GetIssuedCount() const { return m_issuedCount; }
+
+private:
+	struct Entry {
+		GLuint query = 0; // 0 if none is in flight
+		bool visible = true;
+		uint32_t lastUsedFrame = 0;
+	};
+	struct Proxy {
+		Entry* entry; // nodes of m_entries stay in place until Update erases them
+		glm::vec3 aabbMin;
+		glm::vec3 aabbMax;
+	};
+	GLuint AcquireQuery();
+
+	constexpr static inline uint32_t m_visibleTestInterval = 4;
+	// entries of entities that were not tested for this many frames are removed
+	constexpr static inline uint32_t m_maxUnusedFrames = 120;
+
+	std::unordered_map<entt::entity, Entry> m_entries;
+	std::vector<Proxy> m_proxies; // tests of this frame
+	std::vector<GLuint> m_freeQueries;
+	glm::vec3 m_cameraPosition{0};
+	float m_nearPlane = 0;
+	uint32_t m_frame = 0;
+	uint32_t m_issuedCount = 0;
+
+	// unit cube, scaled to the aabb in the vertex shader
+	GLuint m_vao = 0;
+	GLuint m_vbo = 0;
+	GLuint m_ebo = 0;
+};
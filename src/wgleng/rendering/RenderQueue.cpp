@@ -0,0 +1,41 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <array>
+#include <glm/common.hpp>
+
+uint64_t RenderQueue::MakeKey(uint32_t pass, uint32_t program, uint32_t vertexArray, uint32_t material, float depth) {
+	const auto quantizedDepth = static_cast<uint64_t>(glm::clamp(depth, 0.0f, 1.0f) * 0xFFFFFF);
+	return static_cast<uint64_t>(pass & 0xFF) << 56 |
+		static_cast<uint64_t>(program & 0xFF) << 48 |
+		static_cast<uint64_t>(vertexArray & 0xFFFF) << 32 |
+		static_cast<uint64_t>(material & 0xFF) << 24 |
+		quantizedDepth;
+}
+void RenderQueue::Sort() {
+	if (m_items.size() < 2) return;
+	// histograms of all 8 bytes in one pass
+	std::array<std::array<uint32_t, 256>, 8> counts{};
+	for (const auto& item : m_items) {
+		for (int byte = 0; byte < 8; byte++) counts[byte][(item.key >> (byte * 8)) & 0xFF]++;
+	}
+	m_scratch.resize(m_items.size());
+	for (int byte = 0; byte < 8; byte++) {
+		auto& count = counts[byte];
+		if (count[(m_items[0].key >> (byte * 8)) & 0xFF] == m_items.size()) continue; // already in order
+		uint32_t offset = 0;
+		for (auto& c : count) {
+			const uint32_t n = c;
+			c = offset;
+			offset += n;
+		}
+		for (const auto& item : m_items) m_scratch[count[(item.key >> (byte * 8)) & 0xFF]++] = item;
+		std::swap(m_items, m_scratch);
+	}
+}
+std::span<const RenderQueue::Item> RenderQueue::GetPass(uint32_t pass) const {
+	const auto passOf = [](const Item& item) { return static_cast<uint32_t>(item.key >> 56); };
+	const auto begin = std::ranges::partition_point(m_items, [&](const Item& item) { return passOf(item) < pass; });
+	const auto end = std::ranges::partition_point(begin, m_items.end(), [&](const Item& item) { return passOf(item) <= pass; });
+	return {begin, end};
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// draw items ordered by a 64 bit key, so items sharing state end up next to each other.
+// key fields from most to least significant:
+//   pass 8 | program 8 | vertex array 16 | material 8 | depth 24
+// program and vertex array are the low bits of the gl names, a collision only costs a state change
+class RenderQueue {
+public:
+	struct Item {
+		uint64_t key;
+		uint32_t index; // into the caller's draw data
+	};
+
+	// depth is normalized to [0, 1], smaller is drawn first
+	static uint64_t MakeKey(uint32_t pass, uint32_t program, uint32_t vertexArray, uint32_t material, float depth);
+
+	void Clear() { m_items.clear(); }
+	void Push(uint64_t key, uint32_t index) { m_items.push_back({key, index}); }
+	// stable lsd radix sort, bytes that are equal in all keys are skipped
+	void Sort();
+
+	const std::vector<Item>& GetItems() const { return m_items; }
+	// sorted items of one pass
+	std::span<const Item> GetPass(uint32_t pass) const;
+
+private:
+	std::vector<Item> m_items;
+	std::vector<Item> m_scratch;
+};
@@ -1,6 +1,12 @@
 #include "Renderer.h"
 
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#ifndef WGLENG_HEADLESS
 #include <emscripten/fetch.h>
+#include <emscripten/html5.h>
+#endif
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <unordered_map>
@@ -13,12 +19,28 @@
 #include "../vendor/imgui/imgui_impl_opengl3.h"
 #include "Debug.h"
 #include "FrustumCulling.h"
+#include "GLExtensions.h"
+#include "GLState.h"
 #include "Highlights.h"
 #include "Text.h"
 
+namespace {
+	// world space center and half extent of a local aabb from the 3 stored rows of the model matrix.
+	// scalar, it runs for every receiver and caster
+	void transformAabb(const glm::vec4* rows, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& center, glm::vec3& extent) {
+		const glm::vec3 localCenter = (localMin + localMax) * 0.5f;
+		const glm::vec3 localExtent = (localMax - localMin) * 0.5f;
+		for (int r = 0; r < 3; r++) {
+			center[r] = rows[r].x * localCenter.x + rows[r].y * localCenter.y + rows[r].z * localCenter.z + rows[r].w;
+			extent[r] = std::abs(rows[r].x) * localExtent.x + std::abs(rows[r].y) * localExtent.y + std::abs(rows[r].z) * localExtent.z;
+		}
+	}
+}
+
 Renderer::Renderer()
 	: m_viewportWidth{640}, m_viewportHeight{480} {
 	CheckExtensionSupport();
+	m_highlightUniform.Resize(sizeof(HighlightUniform));
 	SetSettings(m_settings, true);
 
 	// GL settings
@@ -30,7 +52,9 @@ Renderer::Renderer()
 
 	glClearColor(0.5f, 0.4f, 0.3f, 1.0f);
 }
-Renderer::~Renderer() = default;
+Renderer::~Renderer() {
+	ShaderProgram::ClearCache();
+}
 void Renderer::SetViewportSize(int32_t width, int32_t height) {
 	if (m_viewportWidth == width && m_viewportHeight == height) return;
 	m_viewportWidth = width;
@@ -51,12 +75,13 @@ void Renderer::LoadShaderFromFile(const std::string& file) {
 			m_shaderLoadingOutput.pop_front();
 			const auto prog = m_shaderLoadingPrograms.front();
 			m_shaderLoadingPrograms.pop_front();
-			(*prog)->Load(vert.c_str(), frag.c_str());
+			prog->Load(vert.c_str(), frag.c_str());
 		}
-		SetupUniforms();
+		m_shadersFetching = false;
 		return;
 	}
 
+#ifndef WGLENG_HEADLESS
 	emscripten_fetch_attr_t attr;
 	emscripten_fetch_attr_init(&attr);
 	attr.requestMethod[0] = 'G';
@@ -90,20 +115,33 @@ void Renderer::LoadShaderFromFile(const std::string& file) {
 		emscripten_fetch_close(fetch);
 	};
 	emscripten_fetch(&attr, ("http://localhost:8000/rendering/" + std::string(file)).c_str());
+#endif
 }
 void Renderer::ReloadShaders(ShaderType shaders) {
 	if (shaders == ShaderType::NONE) return;
-	if (m_shadersLoading) return;
+	if (m_shadersLoading) { // reload again once the current programs are swapped in
+		m_queuedShaders |= shaders;
+		return;
+	}
 	m_shadersLoading = true;
 	printf("Loading shaders ...\n");
+	if (m_queuedCascades) {
+		m_loadingCascades = std::move(m_queuedCascades);
+		m_queuedCascades.reset();
+	}
+	const uint32_t cascadeCount = m_loadingCascades ? m_loadingCascades->splits.size() : m_csmbuffer.GetFrustumCount();
 
 	// mesh
 	if (!!(shaders & ShaderType::MESH)) {
-		m_meshProgram = std::make_unique<ShaderProgram>("mesh");
-		m_meshProgram->SetConstant("MODELS_PER_UBO", std::to_string(m_matricesPerUniformBuffer));
+		auto& meshProgram = QueueShader(m_meshProgram, "mesh");
+		meshProgram->SetConstant("INSTANCES_PER_ROW", std::to_string(m_instancesPerRow));
+		meshProgram->SetConstant("INSTANCE_INDICES_WIDTH", std::to_string(m_instanceIndicesWidth));
+		meshProgram->SetConstant("MULTI_DRAW", m_multiDrawSupported ? "1" : "0");
+		meshProgram->SetConstant("MULTI_DRAW_OFFSETS", std::to_string(m_maxMultiDraws / 4));
+		meshProgram->SetConstant("MULTI_DRAWS", std::to_string(m_maxMultiDraws));
 
         #ifdef SHADER_HOT_RELOAD
-		m_shaderLoadingPrograms.push_back(&m_meshProgram);
+		m_shaderLoadingPrograms.push_back(meshProgram.get());
 		m_shaderLoadingQueue.push_back("shaders/mesh.vs");
 		m_shaderLoadingQueue.push_back("shaders/mesh.fs");
         #else
@@ -113,46 +151,30 @@ void Renderer::ReloadShaders(ShaderType shaders) {
 		const GLchar fragmentSource[] = {
                 #include "shaders/mesh.fs"
 		};
-		m_meshProgram->Load(vertexSource, fragmentSource);
+		meshProgram->Load(vertexSource, fragmentSource);
         #endif
 	}
 	// lighting
 	if (!!(shaders & ShaderType::LIGHTING)) {
-		m_lightingProgram = std::make_unique<ShaderProgram>("lighting");
-		m_lightingProgram->SetConstant("MATERIALS_PER_UBO", std::to_string(m_materialsPerUniformBuffer));
-		const auto& highlights = Highlights::GetHighlights();
-		m_lightingProgram->SetConstant("HIGHLIGHT_COUNT", std::to_string(highlights.size()));
-		m_lightingProgram->SetConstant("HIGHLIGHT_COLORS", [&] {
-			std::string str = "";
-			for (int i = 0; i < highlights.size(); i++) {
-				str += std::format("vec3({},{},{})", highlights[i].color.r, highlights[i].color.g, highlights[i].color.b)
-						+ (i == highlights.size() - 1 ? "" : ",");
-			}
-			return str;
-		}());
-		m_lightingProgram->SetConstant("OUTLINES",
+		auto& lightingProgram = QueueShader(m_lightingProgram, "lighting");
+		lightingProgram->SetConstant("MATERIALS_PER_UBO", std::to_string(m_materialsPerUniformBuffer));
+		lightingProgram->SetConstant("MAX_HIGHLIGHTS", std::to_string(Highlights::GetMaxHighlights()));
+		lightingProgram->SetConstant("OUTLINES",
 			m_settings.outlines == RendererSettings::OutlinePreset::OFF ? "0" : "1"
 		);
-		m_lightingProgram->SetConstant("SHADOWS",
+		lightingProgram->SetConstant("SHADOWS",
 			m_settings.shadows == RendererSettings::ShadowPreset::OFF ? "0" : "1"
 		);
-		std::string pcf = "1";
-		if (m_settings.shadows == RendererSettings::ShadowPreset::OFF) pcf = "0";
-		if (m_settings.shadows == RendererSettings::ShadowPreset::LOW) pcf = "0";
-		m_lightingProgram->SetConstant("SHADOW_PCF", pcf);
-		m_lightingProgram->SetConstant("MAX_FRUSTUMS", std::to_string(m_maxCSMFrustums));
-		m_lightingProgram->SetConstant("CASCADE_COUNT", std::to_string(m_csmbuffer.GetFrustumCount()));
-		m_lightingProgram->SetConstant("CASCADE_SPLITS", [&] {
-			std::string str = "";
-			const auto& cascades = m_csmbuffer.GetCascades();
-			for (int i = 0; i < cascades.size(); i++) {
-				str += std::to_string(cascades[i]) + (i == cascades.size() - 1 ? "" : ",");
-			}
-			return str;
-		}());
+		// pcf kernel, see getShadow in light.fs
+		std::string pcf = "0";
+		if (m_settings.shadows == RendererSettings::ShadowPreset::MEDIUM) pcf = "1";
+		if (m_settings.shadows == RendererSettings::ShadowPreset::HIGH) pcf = "2";
+		lightingProgram->SetConstant("SHADOW_PCF", pcf);
+		lightingProgram->SetConstant("MAX_FRUSTUMS", std::to_string(m_maxCSMFrustums));
+		lightingProgram->SetConstant("CASCADE_COUNT", std::to_string(cascadeCount));
 
         #ifdef SHADER_HOT_RELOAD
-		m_shaderLoadingPrograms.push_back(&m_lightingProgram);
+		m_shaderLoadingPrograms.push_back(lightingProgram.get());
 		m_shaderLoadingQueue.push_back("shaders/light.vs");
 		m_shaderLoadingQueue.push_back("shaders/light.fs");
         #else
@@ -162,21 +184,25 @@ void Renderer::ReloadShaders(ShaderType shaders) {
 		const GLchar fragmentSource[] = {
                 #include "shaders/light.fs"
 		};
-		m_lightingProgram->Load(vertexSource, fragmentSource);
+		lightingProgram->Load(vertexSource, fragmentSource);
         #endif
 	}
 	// csm
 	if (!!(shaders & ShaderType::CSM)) {
-		m_csmPrograms.resize(m_csmbuffer.GetFrustumCount());
-		for (int i = 0; i < m_csmPrograms.size(); i++) {
-			auto& csmProgram = m_csmPrograms[i];
+		m_loadingCsmPrograms.resize(cascadeCount);
+		for (int i = 0; i < m_loadingCsmPrograms.size(); i++) {
+			auto& csmProgram = m_loadingCsmPrograms[i];
 			csmProgram = std::make_unique<ShaderProgram>("csm");
 			csmProgram->SetConstant("FRUSTUM_INDEX", std::to_string(i));
-			csmProgram->SetConstant("MODELS_PER_UBO", std::to_string(m_matricesPerUniformBuffer));
+			csmProgram->SetConstant("INSTANCES_PER_ROW", std::to_string(m_instancesPerRow));
+			csmProgram->SetConstant("INSTANCE_INDICES_WIDTH", std::to_string(m_instanceIndicesWidth));
 			csmProgram->SetConstant("MAX_FRUSTUMS", std::to_string(m_maxCSMFrustums));
+			csmProgram->SetConstant("MULTI_DRAW", m_multiDrawSupported ? "1" : "0");
+			csmProgram->SetConstant("MULTI_DRAW_OFFSETS", std::to_string(m_maxMultiDraws / 4));
+			csmProgram->SetConstant("MULTI_DRAWS", std::to_string(m_maxMultiDraws));
 
             #ifdef SHADER_HOT_RELOAD
-			m_shaderLoadingPrograms.push_back(&csmProgram);
+			m_shaderLoadingPrograms.push_back(csmProgram.get());
 			m_shaderLoadingQueue.push_back("shaders/csm.vs");
 			m_shaderLoadingQueue.push_back("shaders/csm.fs");
             #else
@@ -192,10 +218,10 @@ void Renderer::ReloadShaders(ShaderType shaders) {
 	}
 	// text
 	if (!!(shaders & ShaderType::TEXT)) {
-		m_textProgram = std::make_unique<ShaderProgram>("text");
+		auto& textProgram = QueueShader(m_textProgram, "text");
 
 		#ifdef SHADER_HOT_RELOAD
-		m_shaderLoadingPrograms.push_back(&m_textProgram);
+		m_shaderLoadingPrograms.push_back(textProgram.get());
 		m_shaderLoadingQueue.push_back("shaders/text.vs");
 		m_shaderLoadingQueue.push_back("shaders/text.fs");
 		#else
@@ -205,19 +231,19 @@ void Renderer::ReloadShaders(ShaderType shaders) {
 		const GLchar fragmentSource[] = {
 					#include "shaders/text.fs"
 		};
-		m_textProgram->Load(vertexSource, fragmentSource);
+		textProgram->Load(vertexSource, fragmentSource);
 		#endif
 	}
 	// text
 	if (!!(shaders & ShaderType::FXAA)) {
-		m_fxaaProgram = std::make_unique<ShaderProgram>("fxaa");
+		auto& fxaaProgram = QueueShader(m_fxaaProgram, "fxaa");
 		std::string val = "0";
 		if (m_settings.fxaa == RendererSettings::FXAAPreset::LOW) val = "1";
 		else if (m_settings.fxaa == RendererSettings::FXAAPreset::HIGH) val = "2";
-		m_fxaaProgram->SetConstant("FXAA_PRESET", val);
+		fxaaProgram->SetConstant("FXAA_PRESET", val);
 
 		#ifdef SHADER_HOT_RELOAD
-		m_shaderLoadingPrograms.push_back(&m_fxaaProgram);
+		m_shaderLoadingPrograms.push_back(fxaaProgram.get());
 		m_shaderLoadingQueue.push_back("shaders/fxaa.vs");
 		m_shaderLoadingQueue.push_back("shaders/fxaa.fs");
 		#else
@@ -227,15 +253,15 @@ void Renderer::ReloadShaders(ShaderType shaders) {
 		const GLchar fragmentSource[] = {
 					#include "shaders/fxaa.fs"
 		};
-		m_fxaaProgram->Load(vertexSource, fragmentSource);
+		fxaaProgram->Load(vertexSource, fragmentSource);
 		#endif
 	}
 	// debug
 	if (!!(shaders & ShaderType::DEBUG)) {
-		m_debugProgram = std::make_unique<ShaderProgram>("debug");
+		auto& debugProgram = QueueShader(m_debugProgram, "debug");
 
         #ifdef SHADER_HOT_RELOAD
-		m_shaderLoadingPrograms.push_back(&m_debugProgram);
+		m_shaderLoadingPrograms.push_back(debugProgram.get());
 		m_shaderLoadingQueue.push_back("shaders/debug.vs");
 		m_shaderLoadingQueue.push_back("shaders/debug.fs");
         #else
@@ -245,82 +271,145 @@ void Renderer::ReloadShaders(ShaderType shaders) {
 		const GLchar fragmentSource[] = {
                 #include "shaders/debug.fs"
 		};
-		m_debugProgram->Load(vertexSource, fragmentSource);
+		debugProgram->Load(vertexSource, fragmentSource);
+        #endif
+	}
+	// occlusion queries
+	if (!!(shaders & ShaderType::OCCLUSION)) {
+		auto& occlusionProgram = QueueShader(m_occlusionProgram, "occlusion");
+
+        #ifdef SHADER_HOT_RELOAD
+		m_shaderLoadingPrograms.push_back(occlusionProgram.get());
+		m_shaderLoadingQueue.push_back("shaders/occlusion.vs");
+		m_shaderLoadingQueue.push_back("shaders/occlusion.fs");
+        #else
+		const GLchar vertexSource[] = {
+                #include "shaders/occlusion.vs"
+		};
+		const GLchar fragmentSource[] = {
+                #include "shaders/occlusion.fs"
+		};
+		occlusionProgram->Load(vertexSource, fragmentSource);
+        #endif
+	}
+	// depth reduction for sample distribution shadow maps
+	if (!!(shaders & ShaderType::DEPTH_REDUCTION)) {
+		auto& depthReductionProgram = QueueShader(m_depthReductionProgram, "depthreduce");
+		depthReductionProgram->SetConstant("WIDTH", std::to_string(DepthReduction::GetWidth()));
+		depthReductionProgram->SetConstant("HEIGHT", std::to_string(DepthReduction::GetHeight()));
+
+        #ifdef SHADER_HOT_RELOAD
+		m_shaderLoadingPrograms.push_back(depthReductionProgram.get());
+		m_shaderLoadingQueue.push_back("shaders/depthreduce.vs");
+		m_shaderLoadingQueue.push_back("shaders/depthreduce.fs");
+        #else
+		const GLchar vertexSource[] = {
+                #include "shaders/depthreduce.vs"
+		};
+		const GLchar fragmentSource[] = {
+                #include "shaders/depthreduce.fs"
+		};
+		depthReductionProgram->Load(vertexSource, fragmentSource);
         #endif
 	}
 
     #ifdef SHADER_HOT_RELOAD
+	m_shadersFetching = true;
 	std::string shaderFileToLoad = m_shaderLoadingQueue.front();
 	m_shaderLoadingQueue.pop_front();
 	LoadShaderFromFile(shaderFileToLoad);
     #else
-	SetupUniforms();
+	// nothing to draw with yet, so the first load blocks
+	if (!m_shadersReady) UpdateShaderLoading(true);
     #endif
 }
+std::unique_ptr<ShaderProgram>& Renderer::QueueShader(std::unique_ptr<ShaderProgram>& target, std::string_view name) {
+	return m_loadingShaders.emplace_back(&target, std::make_unique<ShaderProgram>(name)).program;
+}
+void Renderer::UpdateShaderLoading(bool wait) {
+	if (!m_shadersLoading || m_shadersFetching) return;
+	// the old programs stay in use until every new one is linked
+	for (auto& [target, program] : m_loadingShaders) {
+		if (wait) program->WaitLoading();
+		else if (program->IsLoading()) return;
+	}
+	for (auto& program : m_loadingCsmPrograms) {
+		if (wait) program->WaitLoading();
+		else if (program->IsLoading()) return;
+	}
+
+	for (auto& [target, program] : m_loadingShaders) *target = std::move(program);
+	m_loadingShaders.clear();
+	if (!m_loadingCsmPrograms.empty()) m_csmPrograms = std::move(m_loadingCsmPrograms);
+	m_loadingCsmPrograms.clear();
+	ApplyLoadingCascades();
+	SetupUniforms();
+
+	m_shadersLoading = false;
+	m_shadersReady = true;
+	printf("Shaders loaded.\n");
+	const ShaderType queued = m_queuedShaders;
+	m_queuedShaders = ShaderType::NONE;
+	ReloadShaders(queued);
+}
+void Renderer::ApplyLoadingCascades() {
+	if (!m_loadingCascades) return;
+	// static layers toggled while the cascades were pending are created with them
+	const bool staticLayers = m_settings.shadowCache.enabled && m_settings.shadowCache.cacheStaticCasters;
+	m_csmbuffer.SetCascades(m_loadingCascades->splits, m_loadingCascades->resolutions, staticLayers);
+	m_loadingCascades.reset();
+}
 void Renderer::SetupUniforms() {
 	// setup uniforms
 	m_nextUniformBindingIndex = 0;
 
-	m_cameraUniform.SetBindingIndex(GetNextUniformBindingIndex());
-	m_cameraUniform.Bind();
-
-	m_modelUniform.SetBindingIndex(GetNextUniformBindingIndex());
+	m_cameraBinding = GetNextUniformBindingIndex();
 
-	m_lightingInfoUniform.SetBindingIndex(GetNextUniformBindingIndex());
-	m_lightingInfoUniform.Bind();
+	m_lightingInfoBinding = GetNextUniformBindingIndex();
 
 	m_materialUniform.SetBindingIndex(GetNextUniformBindingIndex());
 	m_materialUniform.Bind();
 
-	m_csmUniform.SetBindingIndex(GetNextUniformBindingIndex());
-	m_csmUniform.Bind();
+	m_highlightUniform.SetBindingIndex(GetNextUniformBindingIndex());
+	m_highlightUniform.Bind(0, sizeof(HighlightUniform));
 
-	m_textUniform.SetBindingIndex(GetNextUniformBindingIndex());
-	m_textUniform.Bind();
+	m_csmBinding = GetNextUniformBindingIndex();
 
-	m_meshProgram->AddUniformBufferBinding("CameraUniform", m_cameraUniform.GetBindingIndex());
-	m_meshProgram->AddUniformBufferBinding("ModelMatricesUniform", m_modelUniform.GetBindingIndex());
+	m_textBinding = GetNextUniformBindingIndex();
 
-	m_lightingProgram->AddUniformBufferBinding("LightingInfoUniform", m_lightingInfoUniform.GetBindingIndex());
-	m_lightingProgram->AddUniformBufferBinding("CSMUniform", m_csmUniform.GetBindingIndex());
+	m_meshProgram->AddUniformBufferBinding("CameraUniform", m_cameraBinding);
+
+	m_lightingProgram->AddUniformBufferBinding("LightingInfoUniform", m_lightingInfoBinding);
+	m_lightingProgram->AddUniformBufferBinding("CSMUniform", m_csmBinding);
 	m_lightingProgram->AddUniformBufferBinding("MaterialUniform", m_materialUniform.GetBindingIndex());
+	m_lightingProgram->AddUniformBufferBinding("HighlightUniform", m_highlightUniform.GetBindingIndex());
 
-	m_textProgram->AddUniformBufferBinding("TextUniform", m_textUniform.GetBindingIndex());
+	m_textProgram->AddUniformBufferBinding("TextUniform", m_textBinding);
 
 	for (auto& csmProgram : m_csmPrograms) {
-		csmProgram->AddUniformBufferBinding("CSMUniform", m_csmUniform.GetBindingIndex());
-		csmProgram->AddUniformBufferBinding("ModelMatricesUniform", m_modelUniform.GetBindingIndex());
+		csmProgram->AddUniformBufferBinding("CSMUniform", m_csmBinding);
 	}
 
-	m_debugProgram->AddUniformBufferBinding("CameraUniform", m_cameraUniform.GetBindingIndex());
+	m_debugProgram->AddUniformBufferBinding("CameraUniform", m_cameraBinding);
 
-	m_shadersLoading = false;
-	printf("Shaders loaded.\n");
+	m_occlusionProgram->AddUniformBufferBinding("CameraUniform", m_cameraBinding);
 }
 void Renderer::CheckExtensionSupport() {
 	//auto exts = emscripten_webgl_get_supported_extensions();
 	//printf("%s\n", exts);
-}
-void Renderer::SetFramebuffer(uint32_t framebuffer) {
-	if (m_currentFramebuffer == framebuffer) return;
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-	m_currentFramebuffer = framebuffer;
-}
-void Renderer::SetRenderSize(uint32_t x, uint32_t y) {
-	if (m_currentRenderSizeX == x && m_currentRenderSizeY == y) return;
-	glViewport(0, 0, static_cast<int32_t>(x), static_cast<int32_t>(y));
-	m_currentRenderSizeX = x;
-	m_currentRenderSizeY = y;
-}
-void Renderer::SetFaceCullingFront() {
-	if (m_faceCullingFront) return;
-	glCullFace(GL_FRONT);
-	m_faceCullingFront = true;
-}
-void Renderer::SetFaceCullingBack() {
-	if (!m_faceCullingFront) return;
-	glCullFace(GL_BACK);
-	m_faceCullingFront = false;
+	const auto enableExtension = [](const char* name) {
+#ifdef WGLENG_HEADLESS
+		// GLRecorder implements plain GLES3 plus multi draw
+		return std::string_view(name) == "WEBGL_multi_draw";
+#else
+		const bool supported = emscripten_webgl_enable_extension(emscripten_webgl_get_current_context(), name);
+		if (!supported) printf("Extension %s is not supported\n", name);
+		return supported;
+#endif
+	};
+	Metrics::SetGpuTimerSupported(enableExtension("EXT_disjoint_timer_query_webgl2"));
+	ShaderProgram::SetParallelCompileSupported(enableExtension("KHR_parallel_shader_compile"));
+	m_multiDrawSupported = enableExtension("WEBGL_multi_draw");
 }
 void Renderer::SetSettings(const RendererSettings& settings, bool force) {
 	ShaderType shaders = ShaderType::NONE;
@@ -337,75 +426,111 @@ void Renderer::SetSettings(const RendererSettings& settings, bool force) {
 	if (force || m_settings.shadows != settings.shadows) {
 		m_settings.shadows = settings.shadows;
 		shaders |= ShaderType::LIGHTING | ShaderType::CSM;
+		// far cascades cover more ground per texel anyway, they get smaller shadow maps in the atlas
 		if (m_settings.shadows == RendererSettings::ShadowPreset::LOW) {
-			m_csmbuffer.ResizeAndSetCascades(1024, 1024, {200, 600});
+			m_queuedCascades = CascadeSetup{{200, 600}, {1024, 512}};
 		}
 		else if (m_settings.shadows == RendererSettings::ShadowPreset::MEDIUM) {
-			m_csmbuffer.ResizeAndSetCascades(2048, 2048, {150, 500, 1000});
+			m_queuedCascades = CascadeSetup{{150, 500, 1000}, {2048, 1024, 1024}};
 		}
 		else if (m_settings.shadows == RendererSettings::ShadowPreset::HIGH) {
-			m_csmbuffer.ResizeAndSetCascades(4096, 4096, {100, 300, 800, 1500});
+			m_queuedCascades = CascadeSetup{{100, 300, 800, 1500}, {4096, 2048, 2048, 1024}};
 		}
 		else {
-			m_csmbuffer.ResizeAndSetCascades(1, 1, {100});
+			m_queuedCascades = CascadeSetup{{100}, {1}};
 		}
 	}
 	if (force || m_settings.outlines != settings.outlines) {
 		m_settings.outlines = settings.outlines;
 		shaders |= ShaderType::LIGHTING;
 	}
+	m_settings.occlusion = settings.occlusion;
+	if (m_settings.occlusionQueries != settings.occlusionQueries) {
+		m_settings.occlusionQueries = settings.occlusionQueries;
+		m_occlusionQueries.Clear();
+	}
+	if (force || m_settings.shadowCache != settings.shadowCache) {
+		m_settings.shadowCache = settings.shadowCache;
+		// pending cascades rebuild the atlas anyway, ApplyLoadingCascades picks this up
+		if (!m_queuedCascades && !m_loadingCascades) {
+			m_csmbuffer.SetStaticLayersEnabled(m_settings.shadowCache.enabled && m_settings.shadowCache.cacheStaticCasters);
+		}
+		m_csmbuffer.InvalidateCache();
+	}
+	if (force || m_settings.shadowSplits != settings.shadowSplits) {
+		m_settings.shadowSplits = settings.shadowSplits;
+		m_depthReduction.Clear();
+		m_csmbuffer.ResetSplits();
+		m_csmbuffer.InvalidateCache();
+	}
 
 	if (force) shaders = ShaderType::ALL;
 	ReloadShaders(shaders);
 }
 void Renderer::Render(bool isHidden, const std::shared_ptr<Scene>& scene) {
-	// check for shader reloads
-	if (Highlights::HasChanged(true)) {
-		ReloadShaders(ShaderType::LIGHTING);
-	}
-
-	if (isHidden || m_shadersLoading || !scene || !scene->GetCamera()) {
+	UpdateShaderLoading(false);
+	if (isHidden || !m_shadersReady || !scene || !scene->GetCamera()) {
 		DebugDraw::Clear();
 		ImGui::Render();
 		return;
 	}
 	auto& camera = scene->GetCamera();
+	// imgui and resource creation bind things behind the state cache's back
+	GLState::Invalidate();
+	GLState::ResetCounters();
+	m_streamBuffer.BeginFrame();
+	m_uniformUploadBytes = 0;
 
-	const auto csmMatrices = m_csmbuffer.GetLightSpaceMatrices(camera, scene->sunlightDir);
-
+	// recompute matrices of moved entities only, the cascades reach up to the bounds of all of them
 	Metrics::MeasureDurationStart(Metric::UPDATE_MESHES);
+	auto& store = scene->GetMeshInstances();
+	store.Update(scene->GetPhysicsWorld());
+	glm::vec3 sceneMin{FLT_MAX}, sceneMax{-FLT_MAX};
+	store.GetBvh().GetBounds(sceneMin, sceneMax);
+
+	if (IsSampleDistributionUsed()) FitCascadeSplits(camera);
+	std::vector<glm::mat4> csmMatrices;
+	if (IsShadowCacheUsed()) {
+		m_csmbuffer.UpdateCachedCascades(camera, scene->sunlightDir, m_settings.shadowCache.refitTexels, m_settings.shadowCache.farCascadeInterval,
+			sceneMin, sceneMax);
+		csmMatrices = m_csmbuffer.GetCachedMatrices();
+	}
+	else csmMatrices = m_csmbuffer.GetLightSpaceMatrices(camera, scene->sunlightDir, sceneMin, sceneMax);
+
 	UpdateRenderableMeshes(scene, csmMatrices);
-	Metrics::MeasureDurationStop(Metric::UPDATE_MESHES, true);
+	Metrics::MeasureDurationStop(Metric::UPDATE_MESHES);
 
-	Metrics::MeasureDurationStart(Metric::UPDATE_UNIFORMS);
-	UpdateUniforms(scene, csmMatrices);
-	Metrics::MeasureDurationStop(Metric::UPDATE_UNIFORMS, true);
+	Metrics::MeasureGpuDurationStart(Metric::UPDATE_UNIFORMS);
+	UpdateUniforms(scene);
+	Metrics::MeasureGpuDurationStop(Metric::UPDATE_UNIFORMS);
 
 	// setup for shadows
 	if (m_settings.shadows != RendererSettings::ShadowPreset::OFF) {
-		SetRenderSize(m_csmbuffer.GetWidth(), m_csmbuffer.GetHeight());
-		SetFaceCullingFront();
+		GLState::CullFace(GL_FRONT);
 
-		Metrics::MeasureDurationStart(Metric::RENDER_SHADOWS);
+		Metrics::MeasureGpuDurationStart(Metric::RENDER_SHADOWS);
 		RenderShadowMaps();
-		Metrics::MeasureDurationStop(Metric::RENDER_SHADOWS, true);
+		Metrics::MeasureGpuDurationStop(Metric::RENDER_SHADOWS);
 	}
 
 	// setup for meshes
-	SetRenderSize(m_settings.resolution.width, m_settings.resolution.height);
-	SetFaceCullingBack();
+	GLState::Viewport(m_settings.resolution.width, m_settings.resolution.height);
+	GLState::CullFace(GL_BACK);
 
 	// setup gbuffer
-	SetFramebuffer(m_gbuffer.GetFBO());
+	GLState::BindFramebuffer(m_gbuffer.GetFBO());
 	glClear(GL_DEPTH_BUFFER_BIT);
 	glm::uvec4 uclearColor{0};
 	glm::vec4 fclearColor{0};
 	glClearBufferuiv(GL_COLOR, 0, glm::value_ptr(uclearColor));
 	glClearBufferfv(GL_COLOR, 1, glm::value_ptr(fclearColor));
 
-	Metrics::MeasureDurationStart(Metric::RENDER_MESHES);
+	Metrics::MeasureGpuDurationStart(Metric::RENDER_MESHES);
 	RenderMeshes();
-	Metrics::MeasureDurationStop(Metric::RENDER_MESHES, true);
+	Metrics::MeasureGpuDurationStop(Metric::RENDER_MESHES);
+
+	// tested against the depth of the meshes, results decide about the next frames
+	if (m_settings.occlusionQueries == RendererSettings::OcclusionQueryPreset::ON) m_occlusionQueries.Draw(*m_occlusionProgram);
 
 	Metrics::SetStaticMetric(Metric::TRIANGLES_TOTAL, m_totalDrawnTriangleCount);
 	Metrics::SetStaticMetric(Metric::DRAWN_ENTITES, m_totalDrawnEntityCount);
@@ -414,29 +539,39 @@ void Renderer::Render(bool isHidden, const std::shared_ptr<Scene>& scene) {
 
 	RenderDebug(scene);
 
-	Metrics::MeasureDurationStart(Metric::RENDER_TEXT);
+	Metrics::MeasureGpuDurationStart(Metric::RENDER_TEXT);
 	RenderText(scene);
-	Metrics::MeasureDurationStop(Metric::RENDER_TEXT, true);
+	Metrics::MeasureGpuDurationStop(Metric::RENDER_TEXT);
+
+	// depth range for the cascade splits of a later frame
+	if (IsSampleDistributionUsed()) {
+		m_depthReduction.Reduce(*m_depthReductionProgram, m_gbuffer.GetDepthTexture());
+		GLState::Viewport(m_settings.resolution.width, m_settings.resolution.height);
+	}
 
 	// lighting
-	if (m_settings.fxaa != RendererSettings::FXAAPreset::OFF) SetFramebuffer(m_fxaabuffer.GetFBO());
+	if (m_settings.fxaa != RendererSettings::FXAAPreset::OFF) GLState::BindFramebuffer(m_fxaabuffer.GetFBO());
 	else {
-		SetFramebuffer(0);
-		SetRenderSize(m_viewportWidth, m_viewportHeight);
+		GLState::BindFramebuffer(0);
+		GLState::Viewport(m_viewportWidth, m_viewportHeight);
 	}
 
-	Metrics::MeasureDurationStart(Metric::RENDER_LIGHTING);
+	Metrics::MeasureGpuDurationStart(Metric::RENDER_LIGHTING);
 	RenderLighting();
-	Metrics::MeasureDurationStop(Metric::RENDER_LIGHTING, true);
+	Metrics::MeasureGpuDurationStop(Metric::RENDER_LIGHTING);
 
 	// FXAA
 	if (m_settings.fxaa != RendererSettings::FXAAPreset::OFF) {
-		SetFramebuffer(0);
-		SetRenderSize(m_viewportWidth, m_viewportHeight);
-		Metrics::MeasureDurationStart(Metric::RENDER_FXAA);
+		GLState::BindFramebuffer(0);
+		GLState::Viewport(m_viewportWidth, m_viewportHeight);
+		Metrics::MeasureGpuDurationStart(Metric::RENDER_FXAA);
 		RenderFXAA();
-		Metrics::MeasureDurationStop(Metric::RENDER_FXAA, true);
+		Metrics::MeasureGpuDurationStop(Metric::RENDER_FXAA);
 	}
+	m_streamBuffer.EndFrame();
+	Metrics::SetStaticMetric(Metric::UPLOADED_BYTES, m_streamBuffer.GetFrameUploadBytes() + m_uniformUploadBytes);
+	Metrics::SetStaticMetric(Metric::STATE_CHANGES, static_cast<uint64_t>(GLState::GetIssuedCount()));
+	Metrics::SetStaticMetric(Metric::STATE_CHANGES_ELIDED, static_cast<uint64_t>(GLState::GetElidedCount()));
 	// imgui
 	Metrics::Show();
 	ImGui::Render();
@@ -446,136 +581,310 @@ void Renderer::Render(bool isHidden, const std::shared_ptr<Scene>& scene) {
 void Renderer::UpdateRenderableMeshes(const std::shared_ptr<Scene>& scene, const std::vector<glm::mat4>& csmMatrices) {
 	auto& reg = scene->registry;
 
-	// get matrices
-	std::unordered_map<Mesh, std::vector<glm::mat4>> meshMatrices;
-
-	reg.group<RigidBodyComponent, MeshComponent>().each(
-		[&](auto& rbComp, auto& meshComp) {
-			const auto body = rbComp.body;
-			if (!body || meshComp.hidden || meshComp.hiddenPersistent) {
-				meshComp.hidden = false;
-				meshComp.highlightId = 0;
-				return;
-			}
-
-			btTransform transform;
-			if (body->getMotionState()) body->getMotionState()->getWorldTransform(transform);
-			else transform = body->getWorldTransform();
-
-			transform.setOrigin(transform.getOrigin() + btVector3(meshComp.position.x, meshComp.position.y, meshComp.position.z));
-			glm::vec3 euler{};
-			transform.getRotation().getEulerZYX(euler.z, euler.y, euler.x);
-			glm::vec3 objPos = glm::vec3(transform.getOrigin().x(), transform.getOrigin().y(), transform.getOrigin().z());
-
-			glm::mat4 model = computeModelMatrix(
-				objPos - meshComp.position, meshComp.position,
-				euler, glm::radians(meshComp.rotation),
-				meshComp.scale);
-
-			// !!!! EXTRA DATA PACKED INTO MATRIX, REQUIRES RESETING IN SHADER !!!!
-			model[3][3] = meshComp.highlightId;
-			meshComp.highlightId = 0;
-
-			meshMatrices[meshComp.mesh].push_back(model);
-		});
-	reg.group<TransformComponent>(entt::get<MeshComponent>, entt::exclude<RigidBodyComponent>).each(
-		[&](auto& transformComp, auto& meshComp) {
-			if (meshComp.hidden || meshComp.hiddenPersistent) {
-				meshComp.hidden = false;
-				return;
-			}
-
-			glm::mat4 model = computeModelMatrix(
-				transformComp.position, meshComp.position,
-				glm::radians(transformComp.rotation), glm::radians(meshComp.rotation),
-				transformComp.scale * meshComp.scale);
-
-			// !!!! EXTRA DATA PACKED INTO MATRIX, REQUIRES RESETING IN SHADER !!!!
-			model[3][3] = meshComp.highlightId;
-			meshComp.highlightId = 0;
+	auto& store = scene->GetMeshInstances();
+	auto& meshInstances = store.GetMeshInstances();
 
-			meshMatrices[meshComp.mesh].push_back(model);
-		});
-
-	// setup batching
-	std::vector<glm::mat4>& matricesToUpload = m_renderableMeshesState.matricesToUpload;
-	matricesToUpload.clear();
-	std::vector<std::vector<MeshBatch>*> batchesList;
-	batchesList.reserve(csmMatrices.size() + 1);
-	m_renderableMeshesState.worldBatch.clear();
-	batchesList.emplace_back(&m_renderableMeshesState.worldBatch);
-	m_renderableMeshesState.csmBatches.resize(csmMatrices.size());
-	for (auto& batch : m_renderableMeshesState.csmBatches) {
-		batch.clear();
-		batchesList.emplace_back(&batch);
+	const bool shadowCache = IsShadowCacheUsed();
+	auto& cachedCascades = m_csmbuffer.GetCachedCascades();
+	const bool staticLayers = shadowCache && m_csmbuffer.HasStaticLayers();
+	if (shadowCache && (&store != m_shadowCacheStore || store.GetStaticRevision() != m_shadowCacheRevision)) {
+		m_csmbuffer.InvalidateStaticLayers();
+		m_shadowCacheStore = &store;
+		m_shadowCacheRevision = store.GetStaticRevision();
 	}
 
-	// setup frustum culling
+	// setup frustum culling, cached cascades that are not due keep their depth and are skipped.
+	// the casters of every drawn cascade are filtered by the receivers the camera sees once the walk is done
+	const auto cascadeCount = static_cast<uint32_t>(csmMatrices.size());
+	const bool shadows = m_settings.shadows != RendererSettings::ShadowPreset::OFF;
 	std::vector<FrustumCulling> frustums;
+	std::vector<uint32_t> frustumCascades; // [frustum - 1] -> cascade
+	uint32_t receiverCascades = 0;
 	frustums.reserve(csmMatrices.size() + 1);
 	glm::mat4 projxview = scene->GetCamera()->GetProjectionMatrix() * scene->GetCamera()->GetViewMatrix();
 	frustums.emplace_back(projxview);
-	for (auto i = 0; i < csmMatrices.size(); i++) {
+	for (uint32_t i = 0; i < cascadeCount; i++) {
+		if (shadowCache && !cachedCascades[i].due) continue;
+		if (shadows) receiverCascades |= 1U << i;
 		frustums.emplace_back(csmMatrices[i]);
+		frustumCascades.push_back(i);
+	}
+
+	// frustum cull all views in a single tree walk
+	auto& frustumInstances = m_renderableMeshesState.frustumInstances;
+	frustumInstances.resize(1 + cascadeCount * 2);
+	for (auto& perMesh : frustumInstances) {
+		perMesh.resize(meshInstances.size() * WMESH_MAX_LODS);
+		for (auto& visible : perMesh) visible.clear();
 	}
 
-	// frustum cull and batch
-	uint32_t currentUboOffset = 0;
-	for (auto i = 0; i < frustums.size(); i++) {
-		auto& frustum = frustums[i];
-		auto& batches = *batchesList[i];
-		for (auto& [mesh, mats] : meshMatrices) {
-			MeshBatch batch;
-			batch.mesh = mesh;
-			batch.instanceOffset = currentUboOffset;
-			batch.instanceCount = 0;
-			const auto aabb = mesh->GetAabb();
-			for (auto& mat : mats) {
-				// frustum cull
-				auto fixedMat = mat;
-				fixedMat[3][3] = 0; // remove extra data
-				if (!frustum.IsAabbVisible(aabb.first, aabb.second, fixedMat)) continue;
-				matricesToUpload.push_back(mat);
-
-				// batch
-				batch.instanceCount++;
-				currentUboOffset++;
-				if (batch.instanceCount == m_matricesPerUniformBuffer) {
-					// fix ubo offset alignment
-					const auto alignment = m_modelUniform.GetOffsetAlignment();
-					const auto padding = alignment - (currentUboOffset * sizeof(glm::mat4) % alignment);
-					currentUboOffset += padding / sizeof(glm::mat4);
-					matricesToUpload.resize(currentUboOffset);
-
-					// save batch
-					batches.push_back(batch);
-					batch.instanceOffset = currentUboOffset;
-					batch.instanceCount = 0;
+	// lods are picked by projecting their simplification error onto the main camera, shadows use the same distance
+	const auto& camera = scene->GetCamera();
+	const float pixelsPerUnitAtDistance1 = camera->GetProjectionMatrix()[1][1] * 0.5f * m_settings.resolution.height;
+	const auto selectLod = [](Mesh mesh, float pixelsPerUnit, float maxErrorPixels) {
+		uint32_t lod = mesh->GetLodCount() - 1;
+		while (lod > 0 && mesh->GetLod(lod).error * pixelsPerUnit > maxErrorPixels) lod--;
+		return lod;
+	};
+
+	auto& nearestDistances = m_renderableMeshesState.nearestDistances;
+	nearestDistances.assign(meshInstances.size() * WMESH_MAX_LODS, camera->GetFarPlane());
+
+	auto& occluders = m_renderableMeshesState.occluders;
+	occluders.clear();
+	const bool occlusionCulling = m_settings.occlusion == RendererSettings::OcclusionPreset::ON;
+	const bool occlusionQueries = m_settings.occlusionQueries == RendererSettings::OcclusionQueryPreset::ON;
+	if (occlusionQueries) m_occlusionQueries.Update(camera->position, camera->GetNearPlane());
+	uint64_t queryOccludedCount = 0;
+
+	auto& receivers = m_renderableMeshesState.receivers;
+	receivers.assign(cascadeCount, {glm::vec3{FLT_MAX}, glm::vec3{-FLT_MAX}});
+	const auto& cascadeSplits = m_csmbuffer.GetSplits();
+
+	auto& instanceTransforms = m_renderableMeshesState.instanceTransforms;
+	instanceTransforms.clear();
+	store.GetBvh().Cull(frustums, [&](uint32_t meshIndex, uint32_t instanceIndex, uint32_t frustumMask) {
+		auto& instances = meshInstances[meshIndex];
+		const auto& meshComp = reg.get<MeshComponent>(instances.entities[instanceIndex]);
+		if (meshComp.hidden || meshComp.hiddenPersistent) return;
+
+		// rows of the affine part, every visible instance is stored once and referenced by each frustum
+		const auto& model = instances.models[instanceIndex];
+		const uint32_t instanceRef = static_cast<uint32_t>(instanceTransforms.size() / 3) | (static_cast<uint32_t>(meshComp.highlightId) << 24);
+		instanceTransforms.emplace_back(model[0][0], model[1][0], model[2][0], model[3][0]);
+		instanceTransforms.emplace_back(model[0][1], model[1][1], model[2][1], model[3][1]);
+		instanceTransforms.emplace_back(model[0][2], model[1][2], model[2][2], model[3][2]);
+
+		uint32_t lod = 0;
+		uint32_t shadowLod = 0;
+		const float distance = glm::max(glm::distance(camera->position, glm::vec3(model[3])), camera->GetNearPlane());
+		if (instances.mesh->GetLodCount() > 1) {
+			const float scale = glm::sqrt(glm::max(glm::max(
+				glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+				glm::dot(glm::vec3(model[1]), glm::vec3(model[1]))),
+				glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))));
+			const float pixelsPerUnit = pixelsPerUnitAtDistance1 * scale / distance;
+			lod = selectLod(instances.mesh, pixelsPerUnit, m_lodErrorPixels);
+			shadowLod = selectLod(instances.mesh, pixelsPerUnit, m_lodErrorPixels * m_shadowLodBias);
+		}
+		// expensive instances the last finished query found hidden are skipped by the camera
+		if (occlusionQueries && (frustumMask & 1) && instances.mesh->GetLod(lod).indexCount >= m_minQueryTriangles * 3) {
+			glm::vec3 worldMin, worldMax;
+			MeshInstanceStore::ComputeWorldAabb(instances.mesh, model, worldMin, worldMax);
+			if (!m_occlusionQueries.Test(instances.entities[instanceIndex], worldMin, worldMax)) {
+				frustumMask &= ~1U;
+				queryOccludedCount++;
+			}
+		}
+		if (frustumMask & 1) {
+			float& nearest = nearestDistances[meshIndex * WMESH_MAX_LODS + lod];
+			nearest = glm::min(nearest, distance);
+			if (occlusionCulling && !instances.mesh->GetOccluderGeometry().indices.empty()) {
+				const auto* flags = reg.try_get<FlagComponent>(instances.entities[instanceIndex]);
+				if (flags && flags->flags & EntityFlags::OCCLUDER) occluders.push_back({instances.mesh, &model, distance});
+			}
+			// receivers in light clip space. the lighting pass picks the cascade by view depth, the last one also
+			// covers everything behind it
+			if (receiverCascades) {
+				const auto [localMin, localMax] = instances.mesh->GetAabb();
+				const bool hasAabb = localMin != localMax;
+				glm::vec3 center, extent;
+				transformAabb(&instanceTransforms[instanceTransforms.size() - 3], localMin, localMax, center, extent);
+				const glm::vec3& front = camera->GetFront();
+				const float viewDepth = front.x * (center.x - camera->position.x) + front.y * (center.y - camera->position.y) + front.z * (center.z - camera->position.z);
+				const float radius = std::sqrt(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+				for (uint32_t cascades = receiverCascades; cascades != 0; cascades &= cascades - 1) {
+					const uint32_t c = std::countr_zero(cascades);
+					if (c > 0 && viewDepth + radius < cascadeSplits[c - 1]) continue;
+					if (c + 1 < cascadeCount && viewDepth - radius > cascadeSplits[c]) continue;
+					auto& bounds = receivers[c];
+					if (!hasAabb) {
+						bounds = {glm::vec3{-FLT_MAX}, glm::vec3{FLT_MAX}};
+						continue;
+					}
+					glm::vec3 clipMin, clipMax;
+					CSMBuffer::GetLightClipBounds(csmMatrices[c], center, extent, clipMin, clipMax);
+					bounds.min.x = clipMin.x < bounds.min.x ? clipMin.x : bounds.min.x;
+					bounds.min.y = clipMin.y < bounds.min.y ? clipMin.y : bounds.min.y;
+					bounds.min.z = clipMin.z < bounds.min.z ? clipMin.z : bounds.min.z;
+					bounds.max.x = clipMax.x > bounds.max.x ? clipMax.x : bounds.max.x;
+					bounds.max.y = clipMax.y > bounds.max.y ? clipMax.y : bounds.max.y;
+					bounds.max.z = clipMax.z > bounds.max.z ? clipMax.z : bounds.max.z;
 				}
 			}
-			if (batch.instanceCount == 0) continue;
-			// fix ubo offset alignment
-			const auto alignment = m_modelUniform.GetOffsetAlignment();
-			const auto padding = alignment - (currentUboOffset * sizeof(glm::mat4) % alignment);
-			currentUboOffset += padding / sizeof(glm::mat4);
-			matricesToUpload.resize(currentUboOffset);
-
-			// save batch
-			batches.push_back(batch);
+			frustumInstances[0][meshIndex * WMESH_MAX_LODS + lod].push_back(instanceRef);
+		}
+
+		for (frustumMask &= ~1U; frustumMask != 0; frustumMask &= frustumMask - 1) {
+			const uint32_t cascade = frustumCascades[std::countr_zero(frustumMask) - 1];
+			uint32_t pass = 1 + cascade;
+			if (staticLayers && !instances.dynamic[instanceIndex]) {
+				if (cachedCascades[cascade].staticLayerValid) continue;
+				pass += cascadeCount;
+			}
+			frustumInstances[pass][meshIndex * WMESH_MAX_LODS + shadowLod].push_back(instanceRef);
+		}
+	});
+
+	// casters that can not shadow any receiver are dropped. static layers are kept between frames, so their
+	// casters are not filtered
+	FitShadowCascades(store.GetBvh(), csmMatrices, receiverCascades);
+	for (uint32_t cascades = receiverCascades; cascades != 0; cascades &= cascades - 1) {
+		const uint32_t c = std::countr_zero(cascades);
+		const auto& casters = m_renderableMeshesState.casters[c];
+		for (std::size_t m = 0; m < frustumInstances[1 + c].size(); m++) {
+			auto& visible = frustumInstances[1 + c][m];
+			if (visible.empty()) continue;
+			const auto [localMin, localMax] = meshInstances[m / WMESH_MAX_LODS].mesh->GetAabb();
+			if (localMin == localMax) continue; // mesh has no aabb
+			std::erase_if(visible, [&](uint32_t instanceRef) {
+				glm::vec3 center, extent, clipMin, clipMax;
+				transformAabb(&instanceTransforms[(instanceRef & 0xFFFFFF) * 3], localMin, localMax, center, extent);
+				CSMBuffer::GetLightClipBounds(csmMatrices[c], center, extent, clipMin, clipMax);
+				// beside the receivers as seen from the light, or behind all of them
+				return clipMax.x < casters.min.x || clipMin.x > casters.max.x
+					|| clipMax.y < casters.min.y || clipMin.y > casters.max.y || clipMin.z > casters.max.z;
+			});
+		}
+	}
+
+	// occlusion culling, only for the camera. hidden instances may still cast visible shadows
+	uint64_t occludedCount = 0;
+	if (!occluders.empty()) {
+		// nearest first, they hide the most
+		std::ranges::sort(occluders, {}, &RenderableState::Occluder::distance);
+		m_occlusionCulling.Begin(projxview);
+		for (const auto& occluder : occluders) {
+			if (!m_occlusionCulling.RasterizeOccluder(occluder.mesh->GetOccluderGeometry(), *occluder.model)) break;
+		}
+		m_occlusionCulling.End();
+
+		for (std::size_t m = 0; m < frustumInstances[0].size(); m++) {
+			auto& visible = frustumInstances[0][m];
+			if (visible.empty()) continue;
+			const auto [localMin, localMax] = meshInstances[m / WMESH_MAX_LODS].mesh->GetAabb();
+			if (localMin == localMax) continue; // mesh has no aabb
+			const glm::vec3 center = (localMin + localMax) * 0.5f;
+			const glm::vec3 extent = (localMax - localMin) * 0.5f;
+			std::erase_if(visible, [&](uint32_t instanceRef) {
+				// world aabb from the stored rows of the model matrix
+				const glm::vec4* rows = &instanceTransforms[(instanceRef & 0xFFFFFF) * 3];
+				glm::vec3 worldCenter, worldExtent;
+				for (int r = 0; r < 3; r++) {
+					worldCenter[r] = glm::dot(glm::vec3(rows[r]), center) + rows[r].w;
+					worldExtent[r] = glm::dot(glm::abs(glm::vec3(rows[r])), extent);
+				}
+				const bool occluded = m_occlusionCulling.IsOccluded(worldCenter - worldExtent, worldCenter + worldExtent);
+				occludedCount += occluded;
+				return occluded;
+			});
+		}
+	}
+	Metrics::SetStaticMetric(Metric::OCCLUDED_ENTITES, occludedCount + queryOccludedCount);
+	Metrics::SetStaticMetric(Metric::QUERY_OCCLUDED_ENTITES, queryOccludedCount);
+
+	// reset per frame state
+	store.ResetFrameFlags();
+
+	// batch, one per mesh lod and frustum
+	std::vector<uint32_t>& instanceIndices = m_renderableMeshesState.instanceIndices;
+	instanceIndices.clear();
+	auto& batches = m_renderableMeshesState.batches;
+	batches.clear();
+	auto& queue = m_renderableMeshesState.queue;
+	queue.Clear();
+	for (uint32_t i = 0; i < frustumInstances.size(); i++) {
+		GLuint program = 0;
+		if (i == 0) program = m_meshProgram->GetId();
+		else if ((i - 1) % cascadeCount < m_csmPrograms.size()) program = m_csmPrograms[(i - 1) % cascadeCount]->GetId();
+		for (std::size_t m = 0; m < meshInstances.size() * WMESH_MAX_LODS; m++) {
+			const auto& visible = frustumInstances[i][m];
+			if (visible.empty()) continue;
+			const Mesh mesh = meshInstances[m / WMESH_MAX_LODS].mesh;
+			const auto lod = static_cast<uint32_t>(m % WMESH_MAX_LODS);
+			// front to back for the camera, shadow maps have no use for it. arena meshes share a vao, so they end up
+			// next to each other and are drawn together
+			const float depth = i == 0 ? nearestDistances[m] / camera->GetFarPlane() : 0.0f;
+			queue.Push(RenderQueue::MakeKey(i, program, mesh->GetVAO(), 0, depth), static_cast<uint32_t>(batches.size()));
+			batches.push_back({
+				.mesh = mesh,
+				.lod = lod,
+				.instanceOffset = static_cast<uint32_t>(instanceIndices.size()),
+				.instanceCount = static_cast<uint32_t>(visible.size())
+			});
+			instanceIndices.insert(instanceIndices.end(), visible.begin(), visible.end());
 		}
 	}
+	queue.Sort();
 }
-void Renderer::UpdateUniforms(const std::shared_ptr<Scene>& scene, const std::vector<glm::mat4>& csmMatrices) {
+void Renderer::FitShadowCascades(const InstanceBvh& bvh, const std::vector<glm::mat4>& csmMatrices, uint32_t receiverCascades) {
+	auto& state = m_renderableMeshesState;
+	state.lightSpaceMatrices = csmMatrices;
+	state.depthBiasScales = glm::vec4{1};
+	// without receivers nothing has to be drawn
+	state.casters.assign(csmMatrices.size(), {glm::vec3{FLT_MAX}, glm::vec3{-FLT_MAX}});
+	glm::vec3 sceneMin, sceneMax;
+	if (!receiverCascades || !bvh.GetBounds(sceneMin, sceneMax)) return;
+	const glm::vec3 sceneCenter = (sceneMin + sceneMax) * 0.5f;
+	const glm::vec3 sceneExtent = (sceneMax - sceneMin) * 0.5f;
+
+	const bool shadowCache = IsShadowCacheUsed();
+	for (uint32_t cascades = receiverCascades; cascades != 0; cascades &= cascades - 1) {
+		const uint32_t c = std::countr_zero(cascades);
+		const auto& receivers = state.receivers[c];
+		if (receivers.min.x > receivers.max.x) continue;
+		const float padding = m_receiverPaddingTexels * 2.0f / static_cast<float>(m_csmbuffer.GetResolution(c));
+		// the receiver bounds extruded toward the light, up to the near plane which already reaches the scene bounds
+		glm::vec3 clipSceneMin, clipSceneMax;
+		CSMBuffer::GetLightClipBounds(csmMatrices[c], sceneCenter, sceneExtent, clipSceneMin, clipSceneMax);
+		auto& casters = state.casters[c];
+		casters.min = {glm::max(receivers.min.x - padding, -1.0f), glm::max(receivers.min.y - padding, -1.0f), glm::max(clipSceneMin.z, -1.0f)};
+		casters.max = {glm::min(receivers.max.x + padding, 1.0f), glm::min(receivers.max.y + padding, 1.0f), glm::min(receivers.max.z, 1.0f)};
+		// cached cascades keep their matrix until they are placed again, their near plane follows the scene bounds
+		if (shadowCache || casters.max.z - casters.min.z < 1e-4f) continue;
+
+		// the farthest receiver stays a bit in front of the far plane, the lighting pass ignores depths close to 1
+		const float farZ = glm::min(casters.max.z + (casters.max.z - casters.min.z) * 0.05f, 1.0f);
+		state.lightSpaceMatrices[c] = CSMBuffer::FitToBounds(csmMatrices[c], {-1, -1, casters.min.z}, {1, 1, farZ});
+		state.depthBiasScales[c] = 2.0f / (farZ - casters.min.z);
+	}
+}
+bool Renderer::IsShadowCacheUsed() const {
+	return m_settings.shadowCache.enabled && m_settings.shadows != RendererSettings::ShadowPreset::OFF && !IsSampleDistributionUsed();
+}
+bool Renderer::IsSampleDistributionUsed() const {
+	return m_settings.shadowSplits == RendererSettings::ShadowSplitPreset::SAMPLE_DISTRIBUTION && m_settings.shadows != RendererSettings::ShadowPreset::OFF;
+}
+void Renderer::FitCascadeSplits(const std::shared_ptr<Camera>& camera) {
+	float minDepth, maxDepth;
+	if (!m_depthReduction.Collect(minDepth, maxDepth)) return; // the last splits stay
+	if (minDepth > maxDepth) {
+		m_csmbuffer.ResetSplits();
+		return;
+	}
+	// view depth like linearDepth in light.fs
+	const float nearPlane = camera->GetNearPlane();
+	const float farPlane = camera->GetFarPlane();
+	const auto linearDepth = [&](float depth) {
+		const float z = depth * 2.0f - 1.0f;
+		return 2.0f * nearPlane * farPlane / (farPlane + nearPlane - z * (farPlane - nearPlane));
+	};
+	const float minView = glm::max(linearDepth(minDepth) * (1.0f - m_depthRangePadding), nearPlane);
+	const float maxView = glm::min(linearDepth(maxDepth) * (1.0f + m_depthRangePadding), farPlane);
+	m_csmbuffer.FitSplits(minView, glm::max(maxView, minView * 2.0f));
+}
+void Renderer::UpdateUniforms(const std::shared_ptr<Scene>& scene) {
 	auto& camera = scene->GetCamera();
 	camera->Update(m_settings.resolution.width, m_settings.resolution.height);
 	const glm::mat4 camProjView = camera->GetProjectionMatrix() * camera->GetViewMatrix();
 
-	m_cameraUniform.Update({
+	// per frame blocks live in the stream buffer and are bound where they were written
+	m_streamBuffer.UploadUniform(CameraUniform{
 		.projxview = camProjView,
 		.nearFarPlane = {camera->GetNearPlane(), camera->GetFarPlane()}
-	});
+	}, m_cameraBinding);
 
-	m_lightingInfoUniform.Update({
+	m_streamBuffer.UploadUniform(LightingInfoUniform{
 		.sunlightDir = glm::normalize(scene->sunlightDir),
 		.sunlightColor = {1.0, 0.7, 0.8, 3.0},
 		.cameraPos = camera->position,
@@ -584,7 +893,7 @@ void Renderer::UpdateUniforms(const std::shared_ptr<Scene>& scene, const std::ve
 			camera->GetNearPlane(), camera->GetFarPlane()
 		},
 		.invProjView = glm::inverse(camProjView)
-	});
+	}, m_lightingInfoBinding);
 
 	const std::size_t materialCount = MeshRegistry::GetMaterials().size();
 	if (m_materialCount != materialCount) { // could be made more efficient but meh
@@ -592,44 +901,79 @@ void Renderer::UpdateUniforms(const std::shared_ptr<Scene>& scene, const std::ve
 		std::ranges::copy(MeshRegistry::GetMaterials(), materialData.materials);
 		m_materialUniform.Update(materialData);
 		m_materialCount = materialCount;
+		m_uniformUploadBytes += sizeof(MaterialUniform);
 	}
 
-	if (m_settings.shadows != RendererSettings::ShadowPreset::OFF) {
-		CSMUniform csmData;
-		std::ranges::copy(csmMatrices, csmData.lightSpaceMatrices);
-		m_csmUniform.Update(csmData);
+	// only highlights added or changed since the last frame are uploaded
+	if (Highlights::HasChanged()) {
+		const auto [begin, end] = Highlights::GetChangedRange();
+		const auto& highlights = Highlights::GetHighlights();
+		std::vector<glm::vec4> colors;
+		colors.reserve(end - begin);
+		for (uint32_t i = begin; i < end && i < highlights.size(); i++) colors.emplace_back(highlights[i].color, 0);
+		m_highlightUniform.Update(begin * sizeof(glm::vec4), colors.size() * sizeof(glm::vec4), colors.data());
+		m_uniformUploadBytes += colors.size() * sizeof(glm::vec4);
+		Highlights::HasChanged(true);
 	}
 
-	// resize ubo if needed
-	const auto& mats = m_renderableMeshesState.matricesToUpload;
-	const uint32_t requiredSize = (mats.size() + m_matricesPerUniformBuffer) * sizeof(glm::mat4);
-	if (m_modelUniform.GetSize() < requiredSize) {
-		m_modelUniform.Resize(requiredSize + sizeof(glm::mat4) * m_matricesPerUniformBuffer);
+	// the lighting shader declares the block even without shadows, so it is always bound
+	CSMUniform csmData{};
+	std::ranges::copy(m_renderableMeshesState.lightSpaceMatrices, csmData.lightSpaceMatrices);
+	csmData.depthBiasScales = m_renderableMeshesState.depthBiasScales;
+	std::ranges::copy(m_csmbuffer.GetSplits(), &csmData.cascadeSplits[0]);
+	for (uint32_t i = 0; i < m_csmbuffer.GetFrustumCount(); i++) csmData.atlasScaleOffsets[i] = m_csmbuffer.GetAtlasScaleOffset(i);
+	m_streamBuffer.UploadUniform(csmData, m_csmBinding);
+
+	// upload instances
+	const auto& transforms = m_renderableMeshesState.instanceTransforms;
+	if (!transforms.empty()) {
+		const auto allocation = m_streamBuffer.Upload(transforms.data(), transforms.size() * sizeof(glm::vec4), sizeof(glm::vec4));
+		m_instanceTransforms.Update(allocation.buffer, allocation.offset, transforms.size());
+	}
+	const auto& indices = m_renderableMeshesState.instanceIndices;
+	if (!indices.empty()) {
+		const auto allocation = m_streamBuffer.Upload(indices.data(), indices.size() * sizeof(uint32_t), sizeof(uint32_t));
+		m_instanceIndices.Update(allocation.buffer, allocation.offset, indices.size());
 	}
-	// upload matrices
-	m_modelUniform.Update(0, mats.size() * sizeof(glm::mat4), mats.data());
 }
 void Renderer::RenderShadowMaps() {
 	uint64_t vertexCount = 0;
 	uint64_t entityCount = 0;
-	for (int i = 0; i < m_csmbuffer.GetFBOs().size(); i++) {
+	// while a new cascade count compiles there may be fewer programs than cascades
+	const std::size_t cascadeCount = std::min<std::size_t>(m_csmbuffer.GetFrustumCount(), m_csmPrograms.size());
+	const bool shadowCache = IsShadowCacheUsed();
+	auto& cachedCascades = m_csmbuffer.GetCachedCascades();
+	const auto& queue = m_renderableMeshesState.queue;
+	for (int i = 0; i < cascadeCount; i++) {
+		if (shadowCache && !cachedCascades[i].due) continue;
 		const auto& csmProgram = m_csmPrograms[i];
 		csmProgram->Use();
-		const GLuint fbo = m_csmbuffer.GetFBOs()[i];
-		SetFramebuffer(fbo);
-		glClear(GL_DEPTH_BUFFER_BIT);
-		uint32_t currentVao = 0;
-		for (const auto& batch : m_renderableMeshesState.csmBatches[i]) {
-			const auto vao = batch.mesh->GetVAO();
-			if (currentVao != vao) {
-				glBindVertexArray(vao);
-				currentVao = vao;
-			}
-			m_modelUniform.Bind(batch.instanceOffset * sizeof(glm::mat4), m_matricesPerUniformBuffer * sizeof(glm::mat4));
-			glDrawElementsInstanced(GL_TRIANGLES, batch.mesh->GetDrawCount(), GL_UNSIGNED_INT, nullptr, batch.instanceCount);
-			vertexCount += batch.instanceCount * batch.mesh->GetDrawCount();
-			entityCount += batch.instanceCount;
+		csmProgram->SetTexture("tInstanceTransforms", GL_TEXTURE_2D, 0, m_instanceTransforms.GetTexture());
+		csmProgram->SetTexture("tInstanceIndices", GL_TEXTURE_2D, 1, m_instanceIndices.GetTexture());
+		const auto items = queue.GetPass(i + 1);
+		if (!shadowCache || !m_csmbuffer.HasStaticLayers()) {
+			m_csmbuffer.BindCascade(i, false);
+			m_csmbuffer.ClearCascade(i);
+			DrawBatches(items, GL_TRIANGLES, *csmProgram, vertexCount, entityCount);
+			if (shadowCache) cachedCascades[i].staticLayerValid = true;
+			continue;
 		}
+
+		// static casters only change the static layer, dynamic ones are drawn over a copy of it
+		auto& cascade = cachedCascades[i];
+		bool copy = cascade.hasDynamicCasters || !items.empty();
+		if (!cascade.staticLayerValid) {
+			m_csmbuffer.BindCascade(i, true);
+			m_csmbuffer.ClearCascade(i);
+			DrawBatches(queue.GetPass(i + 1 + m_csmbuffer.GetFrustumCount()), GL_TRIANGLES, *csmProgram, vertexCount, entityCount);
+			cascade.staticLayerValid = true;
+			copy = true;
+		}
+		if (copy) {
+			m_csmbuffer.CopyStaticLayer(i);
+			DrawBatches(items, GL_TRIANGLES, *csmProgram, vertexCount, entityCount);
+		}
+		cascade.hasDynamicCasters = !items.empty();
 	}
 	uint64_t triCount = vertexCount / 3;
 	m_totalDrawnTriangleCount += triCount;
@@ -642,31 +986,69 @@ void Renderer::RenderMeshes() {
 	uint64_t entityCount = 0;
 	const int drawType = m_showWireframe ? GL_LINES : GL_TRIANGLES;
 	m_meshProgram->Use();
-	uint32_t currentVao = 0;
-	for (const auto& batch : m_renderableMeshesState.worldBatch) {
-		const auto vao = batch.mesh->GetVAO();
-		if (currentVao != vao) {
-			glBindVertexArray(vao);
-			currentVao = vao;
-		}
-		m_modelUniform.Bind(batch.instanceOffset * sizeof(glm::mat4), m_matricesPerUniformBuffer * sizeof(glm::mat4));
-		glDrawElementsInstanced(drawType, batch.mesh->GetDrawCount(), GL_UNSIGNED_INT, nullptr, batch.instanceCount);
-		vertexCount += batch.instanceCount * batch.mesh->GetDrawCount();
-		entityCount += batch.instanceCount;
-	}
+	m_meshProgram->SetTexture("tInstanceTransforms", GL_TEXTURE_2D, 0, m_instanceTransforms.GetTexture());
+	m_meshProgram->SetTexture("tInstanceIndices", GL_TEXTURE_2D, 1, m_instanceIndices.GetTexture());
+	DrawBatches(m_renderableMeshesState.queue.GetPass(0), drawType, *m_meshProgram, vertexCount, entityCount);
 	uint64_t triCount = vertexCount / 3;
 	m_totalDrawnTriangleCount += triCount;
 	Metrics::SetStaticMetric(Metric::TRIANGLES_MESHES, triCount);
 	m_totalDrawnEntityCount += entityCount;
 	Metrics::SetStaticMetric(Metric::MESH_ENTITES, entityCount);
 }
-void Renderer::RenderDebug(const std::shared_ptr<Scene>& scene) const {
+void Renderer::DrawBatches(std::span<const RenderQueue::Item> items, GLenum mode, ShaderProgram& program, uint64_t& vertexCount, uint64_t& entityCount) {
+	const auto& batches = m_renderableMeshesState.batches;
+	const GLint drawOffsetsLocation = program.GetUniformLocation("drawOffsets");
+	const GLint positionOffsetsLocation = program.GetUniformLocation("drawPositionOffsets");
+	const GLint positionScalesLocation = program.GetUniformLocation("drawPositionScales");
+	std::array<GLsizei, m_maxMultiDraws> counts;
+	std::array<const void*, m_maxMultiDraws> offsets;
+	std::array<GLsizei, m_maxMultiDraws> instanceCounts;
+	std::array<GLint, m_maxMultiDraws> drawOffsets;
+	std::array<glm::vec4, m_maxMultiDraws> positionOffsets;
+	std::array<glm::vec4, m_maxMultiDraws> positionScales;
+	Mesh currentMesh = nullptr;
+	for (std::size_t begin = 0; begin < items.size();) {
+		const MeshBatch& first = batches[items[begin].index];
+		if (!currentMesh || !currentMesh->CanDrawWith(*first.mesh)) {
+			first.mesh->Bind();
+			currentMesh = first.mesh;
+		}
+
+		// lods and meshes that share the bound state, the queue keeps them next to each other
+		std::size_t end = begin + 1;
+		while (m_multiDrawSupported && end < items.size() && end - begin < m_maxMultiDraws && batches[items[end].index].mesh->CanDrawWith(*first.mesh)) end++;
+
+		for (std::size_t i = begin; i < end; i++) {
+			const auto& batch = batches[items[i].index];
+			const auto& lod = batch.mesh->GetLod(batch.lod);
+			vertexCount += batch.instanceCount * lod.indexCount;
+			entityCount += batch.instanceCount;
+			counts[i - begin] = static_cast<GLsizei>(lod.indexCount);
+			offsets[i - begin] = reinterpret_cast<const void*>(static_cast<uintptr_t>(lod.indexByteOffset));
+			instanceCounts[i - begin] = static_cast<GLsizei>(batch.instanceCount);
+			drawOffsets[i - begin] = static_cast<GLint>(batch.instanceOffset);
+			positionOffsets[i - begin] = batch.mesh->GetPositionOffset();
+			positionScales[i - begin] = batch.mesh->GetPositionScale();
+		}
+		const auto drawCount = static_cast<GLsizei>(end - begin);
+		glUniform4iv(drawOffsetsLocation, (drawCount + 3) / 4, drawOffsets.data());
+		glUniform4fv(positionOffsetsLocation, drawCount, glm::value_ptr(positionOffsets[0]));
+		glUniform4fv(positionScalesLocation, drawCount, glm::value_ptr(positionScales[0]));
+		if (m_multiDrawSupported) {
+			glMultiDrawElementsInstancedWEBGL(mode, counts.data(), first.mesh->GetIndexType(), offsets.data(), instanceCounts.data(), drawCount);
+		} else {
+			glDrawElementsInstanced(mode, counts[0], first.mesh->GetIndexType(), offsets[0], instanceCounts[0]);
+		}
+		begin = end;
+	}
+}
+void Renderer::RenderDebug(const std::shared_ptr<Scene>& scene) {
 	if (DebugDraw::IsEnabled()) {
 		m_debugProgram->Use();
 		DebugDraw::GetDrawer()->setDebugMode(btIDebugDraw::DBG_DrawWireframe | btIDebugDraw::DBG_DrawContactPoints);
 		scene->GetPhysicsWorld().dynamicsWorld->setDebugDrawer(DebugDraw::GetDrawer());
 		scene->GetPhysicsWorld().dynamicsWorld->debugDrawWorld();
-		DebugDraw::Draw();
+		DebugDraw::Draw(m_streamBuffer);
 	}
 }
 void Renderer::RenderText(const std::shared_ptr<Scene>& scene) {
@@ -724,7 +1106,7 @@ void Renderer::RenderText(const std::shared_ptr<Scene>& scene) {
 	}
 
 	// draw 3d texts
-	glDisable(GL_CULL_FACE);
+	GLState::SetCapability(GL_CULL_FACE, false);
 	m_textProgram->Use();
 	for (auto& [fontName, textArray] : textMap) {
 		// set font texture
@@ -746,11 +1128,11 @@ void Renderer::RenderText(const std::shared_ptr<Scene>& scene) {
 				model = glm::rotate(model, glm::radians(text->rotation.z), glm::vec3(0, 0, 1));
 				model = glm::scale(model, text->scale);
 			}
-			m_textUniform.Update({
+			m_streamBuffer.UploadUniform(TextUniform{
 				.projxview = camProjView,
 				.model = model
-			});
-			glBindVertexArray(text->GetVAO());
+			}, m_textBinding);
+			GLState::BindVertexArray(text->GetVAO());
 			glDrawArrays(GL_TRIANGLES, 0, text->GetDrawCount());
 			// remove 3d text
 			std::swap(textArray[i], textArray.back());
@@ -759,7 +1141,7 @@ void Renderer::RenderText(const std::shared_ptr<Scene>& scene) {
 		}
 	}
 	// 2d text
-	glDisable(GL_DEPTH_TEST);
+	GLState::SetCapability(GL_DEPTH_TEST, false);
 	const glm::mat4 ortho = glm::ortho(
 		0.0f, static_cast<float>(m_settings.resolution.width),
 		0.0f, static_cast<float>(m_settings.resolution.height));
@@ -788,23 +1170,23 @@ void Renderer::RenderText(const std::shared_ptr<Scene>& scene) {
 				model = glm::rotate(model, glm::radians(text->rotation.z), glm::vec3(0, 0, 1));
 				model = glm::scale(model, textScale);
 			}
-			m_textUniform.Update({
+			m_streamBuffer.UploadUniform(TextUniform{
 				.projxview = ortho,
 				.model = model
-			});
-			glBindVertexArray(text->GetVAO());
+			}, m_textBinding);
+			GLState::BindVertexArray(text->GetVAO());
 			glDrawArrays(GL_TRIANGLES, 0, text->GetDrawCount());
 		}
 	}
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	GLState::SetCapability(GL_DEPTH_TEST, true);
+	GLState::SetCapability(GL_CULL_FACE, true);
 }
 void Renderer::RenderLighting() const {
 	m_lightingProgram->Use();
 	m_lightingProgram->SetTexture("tDepth", GL_TEXTURE_2D, 0, m_gbuffer.GetDepthTexture());
 	m_lightingProgram->SetTexture("tMaterial", GL_TEXTURE_2D, 1, m_gbuffer.GetMaterialTexture());
 	m_lightingProgram->SetTexture("tNormal", GL_TEXTURE_2D, 2, m_gbuffer.GetNormalTexture());
-	m_lightingProgram->SetTexture("tShadow", GL_TEXTURE_2D_ARRAY, 3, m_csmbuffer.GetDepthTextureArray());
+	m_lightingProgram->SetTexture("tShadow", GL_TEXTURE_2D, 3, m_csmbuffer.GetDepthTexture());
 	glDrawArrays(GL_TRIANGLES, 0, 3);
 }
 void Renderer::RenderFXAA() const {
@@ -1,14 +1,22 @@
 #pragma once
 
 #include <deque>
+#include <optional>
 #include <string>
 
 #include "../core/Scene.h"
 #include "CSMBuffer.h"
+#include "DataTexture.h"
+#include "DepthReduction.h"
 #include "FXAABuffer.h"
 #include "GBuffer.h"
+#include "Highlights.h"
 #include "Mesh.h"
+#include "OcclusionCulling.h"
+#include "OcclusionQueries.h"
+#include "RenderQueue.h"
 #include "ShaderProgram.h"
+#include "StreamBuffer.h"
 #include "UniformBuffer.h"
 
 struct RendererSettings {
@@ -26,6 +34,29 @@ struct RendererSettings {
 	enum class OutlinePreset {
 		OFF, ON
 	} outlines = OutlinePreset::ON;
+	// cpu occlusion culling of the camera view against EntityFlags::OCCLUDER meshes
+	enum class OcclusionPreset {
+		OFF, ON
+	} occlusion = OcclusionPreset::ON;
+	// gpu occlusion queries for instances with many triangles, hidden ones show up again one or two frames late
+	enum class OcclusionQueryPreset {
+		OFF, ON
+	} occlusionQueries = OcclusionQueryPreset::OFF;
+	// cascades stay in place between frames and are only redrawn when due, see CSMBuffer::CachedCascade.
+	// off by default: dynamic casters in far cascades lag up to farCascadeInterval - 1 frames, and hiding a static
+	// caster (MeshComponent::hidden) does not remove it from the static layers
+	struct ShadowCacheSettings {
+		bool enabled = false;
+		uint32_t farCascadeInterval = 4; // cascades after the first are redrawn every this many frames
+		uint32_t refitTexels = 32; // how far the camera may move before a cascade is placed again
+		bool cacheStaticCasters = false; // keeps the static casters in a second depth atlas, doubles shadow map memory
+		bool operator==(const ShadowCacheSettings&) const = default;
+	} shadowCache{};
+	// sample distribution shadow maps, the cascade splits follow the depth range the camera sees. it is reduced from
+	// the gbuffer and read back a frame or two late. cascades move every frame, so the shadow cache is not used
+	enum class ShadowSplitPreset {
+		FIXED, SAMPLE_DISTRIBUTION
+	} shadowSplits = ShadowSplitPreset::FIXED;
 }; 
 
 class Renderer {
@@ -51,6 +82,8 @@ public:
 		CSM      = 1U << 3,
 		TEXT     = 1U << 4,
 		FXAA     = 1U << 5,
+		OCCLUSION = 1U << 6,
+		DEPTH_REDUCTION = 1U << 7,
 	};
 
 	const RendererSettings& GetSettings() const { return m_settings; }
@@ -61,14 +94,11 @@ public:
 	bool IsWireframeShown() const { return m_showWireframe; }
 
 private:
+#ifdef WGLENG_HEADLESS
+	// bench/EngineBench.cpp times the render steps one by one
+	friend class RendererBench;
+#endif
 	void CheckExtensionSupport();
-	void SetFramebuffer(uint32_t framebuffer);
-	uint32_t m_currentFramebuffer = 0;
-	void SetRenderSize(uint32_t x, uint32_t y);
-	uint32_t m_currentRenderSizeX = 0, m_currentRenderSizeY = 0;
-	void SetFaceCullingFront();
-	void SetFaceCullingBack();
-	bool m_faceCullingFront = false;
 private:
 
 	// options
@@ -76,28 +106,61 @@ private:
 	bool m_showWireframe = false;
 	int32_t m_viewportWidth, m_viewportHeight;
 
-	constexpr static inline uint32_t m_matricesPerUniformBuffer = 256;
+	// instance data textures, see DataTexture. WebGL2 guarantees 2048 texels per dimension
+	constexpr static inline uint32_t m_instancesPerRow = 512;
+	constexpr static inline uint32_t m_instanceIndicesWidth = 2048;
 	constexpr static inline uint32_t m_maxCSMFrustums = 4;
 	constexpr static inline uint32_t m_materialsPerUniformBuffer = 1024;
+	// coarsest lod whose simplification error projects to at most this many pixels is drawn
+	constexpr static inline float m_lodErrorPixels = 1.0f;
+	// shadow maps are low resolution and blurred, so casters tolerate a bigger error
+	constexpr static inline float m_shadowLodBias = 4.0f;
+	// draws per glMultiDrawElementsInstancedWEBGL call, multiple of 4 (offsets are packed into ivec4s). the vertex
+	// shaders take 2.25 uniform vectors per draw, WebGL2 guarantees 256
+	constexpr static inline uint32_t m_maxMultiDraws = 64;
+	bool m_multiDrawSupported = false;
 
 	// buffers
 	GBuffer m_gbuffer;
 	CSMBuffer m_csmbuffer;
 	FXAABuffer m_fxaabuffer;
+	// cascades of a shadow preset, the lighting and csm programs are compiled for them. they replace the ones of
+	// m_csmbuffer in the same step that swaps in those programs, until then the old programs draw the old cascades
+	struct CascadeSetup {
+		std::vector<float> splits;
+		std::vector<uint32_t> resolutions;
+	};
+	std::optional<CascadeSetup> m_queuedCascades; // picked up by the next shader load
+	std::optional<CascadeSetup> m_loadingCascades; // of the programs loading now
+	void ApplyLoadingCascades();
 
 	// shaders
 	void LoadShaderFromFile(const std::string& file);
 	void SetupUniforms();
+	// programs compile in the background and replace the current ones once all of them are linked
+	std::unique_ptr<ShaderProgram>& QueueShader(std::unique_ptr<ShaderProgram>& target, std::string_view name);
+	void UpdateShaderLoading(bool wait);
+	struct LoadingShader {
+		std::unique_ptr<ShaderProgram>* target;
+		std::unique_ptr<ShaderProgram> program;
+	};
 	bool m_shadersLoading = false;
+	bool m_shadersFetching = false;
+	bool m_shadersReady = false;
+	ShaderType m_queuedShaders = ShaderType::NONE;
+	std::vector<LoadingShader> m_loadingShaders;
+	std::vector<std::unique_ptr<ShaderProgram>> m_loadingCsmPrograms;
 	std::deque<std::string> m_shaderLoadingQueue;
 	std::deque<std::string> m_shaderLoadingOutput;
-	std::deque<std::unique_ptr<ShaderProgram>*> m_shaderLoadingPrograms;
+	std::deque<ShaderProgram*> m_shaderLoadingPrograms;
 
 	std::unique_ptr<ShaderProgram> m_debugProgram;
 	std::unique_ptr<ShaderProgram> m_meshProgram;
 	std::unique_ptr<ShaderProgram> m_lightingProgram;
 	std::unique_ptr<ShaderProgram> m_textProgram;
 	std::unique_ptr<ShaderProgram> m_fxaaProgram;
+	std::unique_ptr<ShaderProgram> m_occlusionProgram;
+	std::unique_ptr<ShaderProgram> m_depthReductionProgram;
 	std::vector<std::unique_ptr<ShaderProgram>> m_csmPrograms;
 
 	// uniforms
@@ -106,7 +169,8 @@ private:
 
 	struct MeshBatch {
 		Mesh mesh;
-		uint32_t instanceOffset;
+		uint32_t lod;
+		uint32_t instanceOffset; // first entry in RenderableState::instanceIndices
 		uint32_t instanceCount;
 	};
 	struct CameraUniform {
@@ -116,7 +180,11 @@ private:
 	};
 	struct CSMUniform {
 		glm::mat4 lightSpaceMatrices[m_maxCSMFrustums];
+		glm::vec4 depthBiasScales; // per cascade, keeps the depth bias in world units when the depth range shrinks
+		glm::vec4 cascadeSplits; // far view depth per cascade
+		glm::vec4 atlasScaleOffsets[m_maxCSMFrustums]; // see CSMBuffer::GetAtlasScaleOffset
 	};
+	static_assert(m_maxCSMFrustums <= 4, "CSMUniform holds one depth bias scale and split per cascade in a vec4");
 	struct LightingInfoUniform {
 		glm::vec3 sunlightDir;
 		float p1;
@@ -129,34 +197,82 @@ private:
 	struct MaterialUniform {
 		Material materials[m_materialsPerUniformBuffer];
 	};
+	struct HighlightUniform {
+		glm::vec4 colors[Highlights::GetMaxHighlights()]; // rgb, a unused
+	};
 	struct TextUniform {
 		glm::mat4 projxview;
 		glm::mat4 model;
 	};
 
-	UniformBuffer<void> m_modelUniform; // uses dynamic amount of glm::mat4's
-	UniformBuffer<CameraUniform> m_cameraUniform;
-	UniformBuffer<CSMUniform> m_csmUniform;
-	UniformBuffer<LightingInfoUniform> m_lightingInfoUniform;
+	// per frame data (camera, lighting, csm, text, instances, debug lines) is written to the stream buffer
+	StreamBuffer m_streamBuffer{64 * 1024};
+	uint64_t m_uniformUploadBytes = 0; // persistent uniform buffer updates of the current frame
+	GLuint m_cameraBinding = 0;
+	GLuint m_csmBinding = 0;
+	GLuint m_lightingInfoBinding = 0;
+	GLuint m_textBinding = 0;
 	UniformBuffer<MaterialUniform> m_materialUniform;
-	UniformBuffer<TextUniform> m_textUniform;
+	UniformBuffer<void> m_highlightUniform; // uses HighlightUniform layout, updated per changed range
+	DataTexture m_instanceTransforms{GL_RGBA32F, GL_RGBA, GL_FLOAT, sizeof(glm::vec4), m_instancesPerRow * 3};
+	DataTexture m_instanceIndices{GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, sizeof(uint32_t), m_instanceIndicesWidth};
 
 	// render steps
 	uint64_t m_totalDrawnTriangleCount{0};
 	uint64_t m_totalDrawnEntityCount{0};
 	struct RenderableState {
-		std::vector<glm::mat4> matricesToUpload;
-		std::vector<MeshBatch> worldBatch;
-		std::vector<std::vector<MeshBatch>> csmBatches;
+		std::vector<std::vector<std::vector<uint32_t>>> frustumInstances; // [pass][MeshInstanceStore mesh * WMESH_MAX_LODS + lod] -> instance indices
+		std::vector<float> nearestDistances; // [mesh * WMESH_MAX_LODS + lod] camera distance of the nearest visible instance
+		std::vector<glm::vec4> instanceTransforms; // 3 rows of the affine model matrix per visible instance
+		std::vector<uint32_t> instanceIndices; // transform index | highlight id << 24, batches are ranges of this
+		std::vector<MeshBatch> batches;
+		// indices into batches. passes are 0 camera, 1 + cascade for all (or only dynamic) casters
+		// and 1 + cascade count + cascade for the static casters of cascades with a static layer to redraw
+		RenderQueue queue;
+		struct Occluder {
+			Mesh mesh;
+			const glm::mat4* model;
+			float distance;
+		};
+		std::vector<Occluder> occluders; // visible to the camera
+		struct Bounds {
+			glm::vec3 min;
+			glm::vec3 max;
+		};
+		std::vector<Bounds> receivers; // [cascade] light clip space bounds of the camera visible instances in its slice
+		std::vector<Bounds> casters; // [cascade] light clip space volume that can shadow the receivers
+		std::vector<glm::mat4> lightSpaceMatrices; // [cascade] depth range fitted to the drawn casters and the receivers
+		glm::vec4 depthBiasScales{1};
 	} m_renderableMeshesState;
+	OcclusionCulling m_occlusionCulling;
+	OcclusionQueries m_occlusionQueries;
+	// lods with fewer triangles are cheaper to draw than to query
+	constexpr static inline uint32_t m_minQueryTriangles = 2048;
 	void UpdateRenderableMeshes(const std::shared_ptr<Scene>& scene, const std::vector<glm::mat4>& csmMatrices);
+	bool IsShadowCacheUsed() const;
+	bool IsSampleDistributionUsed() const;
+	// moves the cascade splits to the depth range of the last finished reduction
+	void FitCascadeSplits(const std::shared_ptr<Camera>& camera);
+	DepthReduction m_depthReduction;
+	// the reduction samples sparsely and is a frame or two old, the range is grown by this fraction
+	constexpr static inline float m_depthRangePadding = 0.1f;
+	// fits the cascades in receiverCascades to their receivers: the caster volume is the receiver bounds extruded
+	// toward the light, the depth range of uncached cascades shrinks to the scene bounds and the farthest receiver
+	void FitShadowCascades(const InstanceBvh& bvh, const std::vector<glm::mat4>& csmMatrices, uint32_t receiverCascades);
+	// shadow map texels the receiver bounds are grown by, covers the pcf kernel
+	constexpr static inline float m_receiverPaddingTexels = 4.0f;
+	// static layers are redrawn when the static instances of the store change
+	const MeshInstanceStore* m_shadowCacheStore = nullptr;
+	uint64_t m_shadowCacheRevision = 0;
 
 	std::size_t m_materialCount{0};
-	void UpdateUniforms(const std::shared_ptr<Scene>& scene, const std::vector<glm::mat4>& csmMatrices);
+	void UpdateUniforms(const std::shared_ptr<Scene>& scene);
 
 	void RenderShadowMaps();
 	void RenderMeshes();
-	void RenderDebug(const std::shared_ptr<Scene>& scene) const;
+	// submits batches with the bound program, consecutive batches that share draw state (see MeshImpl::CanDrawWith) use one multi draw
+	void DrawBatches(std::span<const RenderQueue::Item> items, GLenum mode, ShaderProgram& program, uint64_t& vertexCount, uint64_t& entityCount);
+	void RenderDebug(const std::shared_ptr<Scene>& scene);
 	void RenderText(const std::shared_ptr<Scene>& scene);
 	void RenderLighting() const;
 	void RenderFXAA() const;
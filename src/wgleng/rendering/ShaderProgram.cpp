@@ -2,6 +2,9 @@
 
 #include <stdio.h>
 
+#include "GLExtensions.h"
+#include "GLState.h"
+
 bool ShaderProgram::CheckCompileErrors(const unsigned int shader, const int type) const {
     int success;
     char infoLog[1024];
@@ -23,21 +26,37 @@ bool ShaderProgram::CheckCompileErrors(const unsigned int shader, const int type
     return true;
 }
 
-void ShaderProgram::CreateShader(GLuint program, const GLchar *source, GLenum type) {
-    std::string src(source);
-    for (const auto& [name, value] : m_shaderConstans) {
-        size_t pos = 0;
-        while ((pos = src.find(name, pos)) != std::string::npos) {
-            src.replace(pos, name.length(), value);
-            pos += value.length();
+std::string ShaderProgram::ReplaceConstants(const GLchar* source) const {
+    // single pass over the source, every <<NAME>> is looked up once
+    const std::string_view src(source);
+    std::string result;
+    result.reserve(src.size());
+    std::size_t pos = 0;
+    while (pos < src.size()) {
+        const std::size_t begin = src.find("<<", pos);
+        if (begin == std::string_view::npos) break;
+        const std::size_t end = src.find(">>", begin + 2);
+        if (end == std::string_view::npos) break;
+        const auto it = m_shaderConstans.find(src.substr(begin + 2, end - begin - 2));
+        if (it == m_shaderConstans.end()) { // not a constant, keep it
+            result.append(src, pos, begin + 2 - pos);
+            pos = begin + 2;
+            continue;
         }
+        result.append(src, pos, begin - pos);
+        result += it->second;
+        pos = end + 2;
     }
+    result.append(src, pos);
+    return result;
+}
 
-    source = src.c_str();
+void ShaderProgram::CreateShader(GLuint program, const std::string& source, GLenum type) {
+    // compile status is checked after linking, querying it here would wait for the compiler
+    const GLchar* src = source.c_str();
     const GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, nullptr);
+    glShaderSource(shader, 1, &src, nullptr);
     glCompileShader(shader);
-    (void)CheckCompileErrors(shader, 1);
     glAttachShader(program, shader);
     glDeleteShader(shader);
 }
@@ -45,26 +64,71 @@ void ShaderProgram::CreateShader(GLuint program, const GLchar *source, GLenum ty
 ShaderProgram::ShaderProgram(std::string_view shaderName) 
     : m_shaderName{shaderName} {}
 
-ShaderProgram::~ShaderProgram() {
-    if (m_program) glDeleteProgram(m_program);
-}
+ShaderProgram::~ShaderProgram() = default; // programs are owned by the variant cache
 
 void ShaderProgram::SetConstant(std::string_view name, std::string_view value) {
-    m_shaderConstans["<<" + std::string(name) + ">>"] = std::string(value);
+    m_shaderConstans.insert_or_assign(std::string(name), std::string(value));
 }
 
 void ShaderProgram::Load(const GLchar *vertexSource, const GLchar *fragmentSource) {
-    if (m_program) glDeleteProgram(m_program);
-    m_program = glCreateProgram();
+    const std::string vertex = vertexSource ? ReplaceConstants(vertexSource) : "";
+    const std::string fragment = fragmentSource ? ReplaceConstants(fragmentSource) : "";
+    std::string key = m_shaderName;
+    key += '\0';
+    key += vertex;
+    key += '\0';
+    key += fragment;
 
-    if (vertexSource) CreateShader(m_program, vertexSource, GL_VERTEX_SHADER);
-    if (fragmentSource) CreateShader(m_program, fragmentSource, GL_FRAGMENT_SHADER);
-    glLinkProgram(m_program);
-    if (!CheckCompileErrors(m_program, 0)) {
-        printf("Error: shader %s is not valid.\n", m_shaderName.c_str());
-		glDeleteProgram(m_program);
-		m_program = 0;
+    auto [it, inserted] = m_variants.try_emplace(std::move(key), Variant{0, false});
+    m_loading = &it->second;
+    if (!inserted) return;
+
+    const GLuint program = glCreateProgram();
+    if (vertexSource) CreateShader(program, vertex, GL_VERTEX_SHADER);
+    if (fragmentSource) CreateShader(program, fragment, GL_FRAGMENT_SHADER);
+    glLinkProgram(program);
+    m_loading->program = program;
+}
+
+bool ShaderProgram::IsLoading() {
+    return PollLoading(false);
+}
+
+void ShaderProgram::WaitLoading() {
+    (void)PollLoading(true);
+}
+
+bool ShaderProgram::PollLoading(bool wait) {
+    if (!m_loading) return false;
+    Variant& variant = *m_loading;
+    if (!variant.linked) {
+        if (m_parallelCompileSupported && !wait) {
+            GLint completed = GL_FALSE;
+            glGetProgramiv(variant.program, GL_COMPLETION_STATUS_KHR, &completed);
+            if (!completed) return true;
+        }
+        variant.linked = true;
+        if (!CheckCompileErrors(variant.program, 0)) {
+            GLuint shaders[2];
+            GLsizei shaderCount = 0;
+            glGetAttachedShaders(variant.program, 2, &shaderCount, shaders);
+            for (GLsizei i = 0; i < shaderCount; i++) (void)CheckCompileErrors(shaders[i], 1);
+            printf("Error: shader %s is not valid.\n", m_shaderName.c_str());
+            glDeleteProgram(variant.program);
+            variant.program = 0;
+        }
+    }
+    m_program = variant.program;
+    m_loading = nullptr;
+    m_uniformLocations.clear();
+    return false;
+}
+
+void ShaderProgram::ClearCache() {
+    for (const auto& [key, variant] : m_variants) {
+        if (variant.program) glDeleteProgram(variant.program);
     }
+    m_variants.clear();
 }
 
 void ShaderProgram::Use() const {
@@ -72,7 +136,7 @@ void ShaderProgram::Use() const {
         printf("Error: shader %s is not valid.\n", m_shaderName.c_str());
 	    return;
     }
-    glUseProgram(m_program);
+    GLState::UseProgram(m_program);
 }
 
 void ShaderProgram::AddUniformBufferBinding(std::string_view name, GLuint bindingIndex) const {
@@ -93,16 +157,18 @@ void ShaderProgram::SetTexture(std::string_view name, GLenum target, GLuint inde
         printf("Error: shader %s is not valid.\n", m_shaderName.c_str());
 	    return;
     }
-    GLuint location;
-    const auto it = m_uniformLocations.find(name.data());
-    if (it != m_uniformLocations.end()) {
-        location = it->second;
-    } else {
-        location = glGetUniformLocation(m_program, name.data());
-        m_uniformLocations[name.data()] = location;
-    }
+    Uniform& uniform = GetUniform(name);
+    if (GLState::Update(uniform.samplerUnit, static_cast<GLint>(index))) glUniform1i(uniform.location, index);
+    GLState::BindTexture(index, target, texture);
+}
 
-    glUniform1i(location, index);
-    glActiveTexture(GL_TEXTURE0 + index);
-    glBindTexture(target, texture);
+GLint ShaderProgram::GetUniformLocation(std::string_view name) {
+    return GetUniform(name).location;
 }
+
+ShaderProgram::Uniform& ShaderProgram::GetUniform(std::string_view name) {
+    const auto it = m_uniformLocations.find(name);
+    if (it != m_uniformLocations.end()) return it->second;
+    const GLint location = glGetUniformLocation(m_program, name.data());
+    return m_uniformLocations.emplace(name, Uniform{location, -1}).first->second;
+}
\ No newline at end of file
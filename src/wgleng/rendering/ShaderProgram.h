@@ -2,6 +2,7 @@
 
 #include <string_view>
 #include <GLES3/gl3.h>
+#include <map>
 #include <unordered_map>
 #include <string>
 
@@ -15,20 +16,52 @@ public:
     ShaderProgram& operator=(ShaderProgram&&) = delete;
 
     void SetConstant(std::string_view name, std::string_view value);
+    // starts compiling, the program is usable once IsLoading() returns false.
+    // programs are cached by their final source, loading a known variant again does not compile anything
     void Load(const GLchar* vertexSource, const GLchar* fragmentSource);
+    // polls the link status, only blocks if KHR_parallel_shader_compile is not available
+    bool IsLoading();
+    void WaitLoading();
 
     void Use() const;
     GLuint GetId() const { return m_program; }
 
     void AddUniformBufferBinding(std::string_view name, GLuint bindingIndex) const;
 
+    // the sampler uniform is only set when its unit changes, so use the same unit per sampler name for a program
     void SetTexture(std::string_view name, GLenum target, GLuint index, GLuint texture);
+    // cached, -1 if the uniform does not exist
+    GLint GetUniformLocation(std::string_view name);
+
+    static void SetParallelCompileSupported(bool supported) { m_parallelCompileSupported = supported; }
+    // deletes all cached programs, no ShaderProgram may be used afterwards
+    static void ClearCache();
 
 private:
+    struct Variant {
+        GLuint program;
+        bool linked; // link status was checked, program is 0 if linking failed
+    };
     bool CheckCompileErrors(const unsigned int shader, const int type) const;
-    void CreateShader(GLuint program, const GLchar *source, GLenum type);
+    bool PollLoading(bool wait);
+    std::string ReplaceConstants(const GLchar* source) const;
+    void CreateShader(GLuint program, const std::string& source, GLenum type);
     GLuint m_program{0};
+    Variant* m_loading{nullptr};
     std::string m_shaderName;
-    std::unordered_map<std::string, GLuint> m_uniformLocations;
-    std::unordered_map<std::string, std::string> m_shaderConstans;
-};
\ No newline at end of file
+    struct StringHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+    };
+    struct Uniform {
+        GLint location;
+        GLint samplerUnit; // last value set by SetTexture, -1 if never set
+    };
+    Uniform& GetUniform(std::string_view name);
+    // looked up with string_view every frame, must not allocate
+    std::unordered_map<std::string, Uniform, StringHash, std::equal_to<>> m_uniformLocations;
+    std::map<std::string, std::string, std::less<>> m_shaderConstans;
+
+    static inline bool m_parallelCompileSupported = false;
+    static inline std::unordered_map<std::string, Variant> m_variants;
+};
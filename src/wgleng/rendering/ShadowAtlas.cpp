@@ -0,0 +1,43 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>
+#include <bit>
+
+void ShadowAtlas::Reset(uint32_t width, uint32_t height) {
+	m_width = width;
+	m_height = height;
+	m_free.clear();
+	Tile(0, 0, width, height);
+}
+bool ShadowAtlas::Allocate(uint32_t size, Rect& rect) {
+	size = std::bit_ceil(std::max(size, 1U));
+	auto best = m_free.end();
+	for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+		if (it->size >= size && (best == m_free.end() || it->size < best->size)) best = it;
+	}
+	if (best == m_free.end()) return false;
+
+	rect = *best;
+	m_free.erase(best);
+	// keep the lower left quarter, the others stay free
+	while (rect.size > size) {
+		rect.size /= 2;
+		m_free.push_back({rect.x + rect.size, rect.y, rect.size});
+		m_free.push_back({rect.x, rect.y + rect.size, rect.size});
+		m_free.push_back({rect.x + rect.size, rect.y + rect.size, rect.size});
+	}
+	return true;
+}
+void ShadowAtlas::Free(const Rect& rect) {
+	m_free.push_back(rect);
+}
+void ShadowAtlas::Tile(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+	if (width == 0 || height == 0) return;
+	// a row or column of squares along the longer side, then the strips left over next to and above it
+	const uint32_t size = std::bit_floor(std::min(width, height));
+	const uint32_t countX = width >= height ? width / size : 1;
+	const uint32_t countY = width >= height ? 1 : height / size;
+	for (uint32_t i = 0; i < countX * countY; i++) m_free.push_back({x + i % countX * size, y + i / countX * size, size});
+	Tile(x + countX * size, y, width - countX * size, countY * size);
+	Tile(x, y + countY * size, width, height - countY * size);
+}
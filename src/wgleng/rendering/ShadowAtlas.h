@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Allocator for square shadow maps with power of two sizes in one depth texture. The atlas is tiled with the largest
+// power of two squares that fit, an allocation takes the smallest free square it fits in and splits it into quarters
+// until it has the right size. Freed squares are not merged again, Reset starts over.
+class ShadowAtlas {
+public:
+	struct Rect {
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t size = 0;
+	};
+
+	void Reset(uint32_t width, uint32_t height);
+	// size is rounded up to a power of two, false if there is no free square that large
+	bool Allocate(uint32_t size, Rect& rect);
+	void Free(const Rect& rect);
+
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+
+private:
+	void Tile(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	std::vector<Rect> m_free;
+};
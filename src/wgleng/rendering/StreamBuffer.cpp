@@ -0,0 +1,74 @@
+#include "StreamBuffer.h"
+
+#include <algorithm>
+
+StreamBuffer::StreamBuffer(uint32_t regionSize) {
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_uniformAlignment = std::max(alignment, 4);
+	Allocate(regionSize);
+}
+StreamBuffer::~StreamBuffer() {
+	DeleteFences();
+	if (m_buffer) glDeleteBuffers(1, &m_buffer);
+	DeleteRetiredBuffers();
+}
+void StreamBuffer::Allocate(uint32_t regionSize) {
+	DeleteFences();
+	// earlier allocations of this frame may still be bound, deleting the buffer would reset those bindings
+	if (m_buffer) m_retiredBuffers.push_back(m_buffer);
+	// regions start at aligned offsets
+	regionSize = (regionSize + m_uniformAlignment - 1) / m_uniformAlignment * m_uniformAlignment;
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(regionSize) * m_regionCount, nullptr, GL_STREAM_DRAW);
+	m_regionSize = regionSize;
+	m_offset = 0;
+}
+void StreamBuffer::DeleteFences() {
+	for (auto& fence : m_fences) {
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+void StreamBuffer::DeleteRetiredBuffers() {
+	if (!m_retiredBuffers.empty()) glDeleteBuffers(static_cast<GLsizei>(m_retiredBuffers.size()), m_retiredBuffers.data());
+	m_retiredBuffers.clear();
+}
+void StreamBuffer::BeginFrame() {
+	DeleteRetiredBuffers();
+	m_region = (m_region + 1) % m_regionCount;
+	m_offset = 0;
+	m_frameUploadBytes = 0;
+
+	GLsync& fence = m_fences[m_region];
+	if (!fence) return;
+	if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+		// gpu is m_regionCount frames behind, fresh storage is cheaper than waiting
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(m_regionSize) * m_regionCount, nullptr, GL_STREAM_DRAW);
+		DeleteFences();
+		return;
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+void StreamBuffer::EndFrame() {
+	GLsync& fence = m_fences[m_region];
+	if (fence) glDeleteSync(fence);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+StreamBuffer::Allocation StreamBuffer::Upload(const void* data, uint32_t size, uint32_t alignment) {
+	uint32_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+	if (offset + size > m_regionSize) {
+		// large enough for everything uploaded this frame, so the next frames fit into one region again
+		Allocate(std::max(m_regionSize * 2, m_offset + size + alignment));
+		offset = 0;
+	}
+	const GLintptr bufferOffset = static_cast<GLintptr>(m_region) * m_regionSize + offset;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, bufferOffset, size, data);
+	m_offset = offset + size;
+	m_frameUploadBytes += size;
+	return {m_buffer, bufferOffset};
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <cstdint>
+#include <vector>
+
+#include "GLState.h"
+
+// allocator for data that is uploaded every frame (uniforms, instances, debug lines...).
+// the buffer is split into m_regionCount regions used round robin, a frame only writes into its own region,
+// so uploads never overwrite ranges the gpu may still read. a fence per region tells when it is free again,
+// if the gpu is even further behind the whole buffer is orphaned instead of waiting.
+class StreamBuffer {
+public:
+	struct Allocation {
+		GLuint buffer;
+		GLintptr offset;
+	};
+
+	StreamBuffer(uint32_t regionSize);
+	~StreamBuffer();
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+	StreamBuffer(StreamBuffer&&) = delete;
+	StreamBuffer& operator=(StreamBuffer&&) = delete;
+
+	// must be called before the first upload of a frame
+	void BeginFrame();
+	void EndFrame();
+
+	// copies data into the current region, alignment must be a power of two.
+	// allocations stay valid until the end of the frame, a full region moves to a bigger buffer
+	Allocation Upload(const void* data, uint32_t size, uint32_t alignment = 4);
+	// uploads a std140 block and binds it to the uniform binding point
+	template <typename T>
+	Allocation UploadUniform(const T& data, GLuint bindingIndex) {
+		const Allocation allocation = Upload(&data, sizeof(T), m_uniformAlignment);
+		GLState::BindUniformBuffer(bindingIndex, allocation.buffer, allocation.offset, sizeof(T));
+		return allocation;
+	}
+
+	uint64_t GetFrameUploadBytes() const { return m_frameUploadBytes; }
+
+private:
+	void Allocate(uint32_t regionSize);
+	void DeleteFences();
+	void DeleteRetiredBuffers();
+
+	constexpr static inline uint32_t m_regionCount = 3;
+	GLuint m_buffer = 0;
+	std::vector<GLuint> m_retiredBuffers; // replaced mid frame, deleted once the frame is submitted
+	GLsync m_fences[m_regionCount] = {};
+	uint32_t m_regionSize = 0;
+	uint32_t m_region = 0;
+	uint32_t m_offset = 0;
+	uint32_t m_uniformAlignment = 0;
+	uint64_t m_frameUploadBytes = 0;
+};
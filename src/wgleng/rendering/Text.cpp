@@ -1,6 +1,7 @@
 #include "Text.h"
 
 #include <GLES3/gl3.h>
+#include <algorithm>
 #include <charconv>
 
 #include "fonts/arial.h"
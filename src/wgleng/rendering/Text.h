@@ -2,6 +2,7 @@
 
 #include <ft2build.h>
 #include <glm/glm.hpp>
+#include <memory>
 #include <span>
 #include <string>
 #include <string_view>
@@ -2,6 +2,8 @@
 
 #include <GLES3/gl3.h>
 
+#include "GLState.h"
+
 template <typename T = void>
 class UniformBuffer {
 public:
@@ -38,7 +40,7 @@ public:
     uint32_t GetSize() const { return m_size; }
 
     void Bind() const requires (!std::is_void_v<T>) {
-        glBindBufferBase(GL_UNIFORM_BUFFER, m_bindIndex, m_ubo);
+        GLState::BindUniformBuffer(m_bindIndex, m_ubo);
     }
     template<typename U = T>
     void Update(const U& data) requires (!std::is_void_v<T> && std::is_same_v<T, U>) {
@@ -47,7 +49,7 @@ public:
     }
     
     void Bind(uint32_t offset, uint32_t range) const requires (std::is_void_v<T>) {
-        glBindBufferRange(GL_UNIFORM_BUFFER, m_bindIndex, m_ubo, offset, range);
+        GLState::BindUniformBuffer(m_bindIndex, m_ubo, offset, range);
     }
     void Update(GLintptr offset, GLsizeiptr size, const void* data) const requires (std::is_void_v<T>) {
         glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
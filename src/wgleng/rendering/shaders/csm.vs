@@ -1,4 +1,11 @@
 R"(#version 300 es
+#define MULTI_DRAW <<MULTI_DRAW>>
+#if MULTI_DRAW == 1
+#extension GL_ANGLE_multi_draw : require
+#define DRAW_ID gl_DrawID
+#else
+#define DRAW_ID 0
+#endif
 precision mediump float;
 
 layout (location = 0) in vec3 position;
@@ -7,17 +14,37 @@ layout (location = 2) in uint materialId;
 
 layout(std140) uniform CSMUniform {
     mat4 lightSpaceMatrices[<<MAX_FRUSTUMS>>];
+    vec4 depthBiasScales;
+    vec4 cascadeSplits;
+    vec4 atlasScaleOffsets[<<MAX_FRUSTUMS>>];
 };
 
-layout(std140) uniform ModelMatricesUniform {
-    mat4 model[<<MODELS_PER_UBO>>];
-};
+// per instance data, see Renderer::UpdateRenderableMeshes
+uniform highp sampler2D tInstanceTransforms; // 3 texels per instance, rows of the affine model matrix
+uniform highp usampler2D tInstanceIndices; // transform index | highlight id << 24, one range per draw
+// first index of each draw, 4 draws per vector
+uniform ivec4 drawOffsets[<<MULTI_DRAW_OFFSETS>>];
+// dequantization of each draw, see MeshImpl::GetPositionOffset. quantized meshes store positions in [0, 1] of their aabb
+uniform highp vec4 drawPositionOffsets[<<MULTI_DRAWS>>];
+uniform highp vec4 drawPositionScales[<<MULTI_DRAWS>>]; // w = 1 if normal.xy is octahedral encoded
+
+highp mat4x3 loadModel(out uint highlightId) {
+    int i = drawOffsets[DRAW_ID / 4][DRAW_ID % 4] + gl_InstanceID;
+    uint instance = texelFetch(tInstanceIndices, ivec2(i % <<INSTANCE_INDICES_WIDTH>>, i / <<INSTANCE_INDICES_WIDTH>>), 0).r;
+    highlightId = instance >> 24;
+    int t = int(instance & 0xFFFFFFu);
+    ivec2 texel = ivec2(t % <<INSTANCES_PER_ROW>> * 3, t / <<INSTANCES_PER_ROW>>);
+    return transpose(mat3x4(
+        texelFetch(tInstanceTransforms, texel, 0),
+        texelFetch(tInstanceTransforms, texel + ivec2(1, 0), 0),
+        texelFetch(tInstanceTransforms, texel + ivec2(2, 0), 0)
+    ));
+}
 
 void main() {
-    mat4 currentModel = model[gl_InstanceID];
-    // revert misc data
-    currentModel[3][3] = 1.0;
+    uint highlightId;
+    highp mat4x3 model = loadModel(highlightId);
 
-    gl_Position = lightSpaceMatrices[<<FRUSTUM_INDEX>>] * currentModel * vec4(position, 1.0);
+    gl_Position = lightSpaceMatrices[<<FRUSTUM_INDEX>>] * vec4(model * vec4(drawPositionOffsets[DRAW_ID].xyz + position * drawPositionScales[DRAW_ID].xyz, 1.0), 1.0);
 }
 )"
\ No newline at end of file
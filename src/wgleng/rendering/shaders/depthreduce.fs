@@ -0,0 +1,31 @@
+R"(#version 300 es
+precision highp float;
+precision highp int;
+
+// float bits of the min and max depth in the block of the texel, 0 if every sample was sky, see DepthReduction
+out uvec2 reduced;
+
+uniform highp sampler2D tDepth;
+
+const int samples = 8; // per axis and texel
+
+void main() {
+    ivec2 size = textureSize(tDepth, 0);
+    vec2 blockSize = vec2(size) / vec2(<<WIDTH>>, <<HEIGHT>>);
+    vec2 blockStart = floor(gl_FragCoord.xy) * blockSize;
+    vec2 sampleStep = blockSize / float(samples);
+
+    float minDepth = 1.0;
+    float maxDepth = 0.0;
+    for (int x = 0; x < samples; x++) {
+        for (int y = 0; y < samples; y++) {
+            ivec2 coord = ivec2(blockStart + (vec2(x, y) + 0.5) * sampleStep);
+            float depth = texelFetch(tDepth, min(coord, size - 1), 0).r;
+            if (depth >= 1.0) continue; // cleared, nothing was drawn
+            minDepth = min(minDepth, depth);
+            maxDepth = max(maxDepth, depth);
+        }
+    }
+    reduced = maxDepth > 0.0 ? uvec2(floatBitsToUint(minDepth), floatBitsToUint(maxDepth)) : uvec2(0);
+}
+)"
@@ -9,7 +9,7 @@ out vec4 gColor;
 uniform sampler2D tDepth;
 uniform mediump usampler2D tMaterial;
 uniform sampler2D tNormal;
-uniform mediump sampler2DArray tShadow;
+uniform mediump sampler2DShadow tShadow; // atlas of all cascades
 
 layout(std140) uniform LightingInfoUniform {
     vec3 sunlightDir;
@@ -20,9 +20,11 @@ layout(std140) uniform LightingInfoUniform {
 };
 layout(std140) uniform CSMUniform {
     mat4 lightSpaceMatrices[<<MAX_FRUSTUMS>>];
+    vec4 depthBiasScales; // per cascade, the depth ranges are fitted each frame
+    vec4 cascadeSplits; // far view depth per cascade, may change every frame
+    vec4 atlasScaleOffsets[<<MAX_FRUSTUMS>>]; // [0, 1] of a cascade to its rect in the atlas, scale xy, offset zw
 };
 const int cascadeCount = <<CASCADE_COUNT>>;
-const float cascadeSplits[<<CASCADE_COUNT>>] = float[](<<CASCADE_SPLITS>>);
 
 struct Material {
     vec4 diffuse;
@@ -30,7 +32,9 @@ struct Material {
 layout(std140) uniform MaterialUniform {
     Material materials[<<MATERIALS_PER_UBO>>];
 };
-const vec3 highlightColors[<<HIGHLIGHT_COUNT>>] = vec3[](<<HIGHLIGHT_COLORS>>);
+layout(std140) uniform HighlightUniform {
+    vec4 highlightColors[<<MAX_HIGHLIGHTS>>];
+};
 
 // struct PointLight {    
 //     vec3 position;
@@ -59,7 +63,7 @@ void main() {
     uvec4 packedMaterial = texture(tMaterial, uv);
     uint materialId = packedMaterial.r << 8 | packedMaterial.g;
     uint highlightId = packedMaterial.b;
-    vec3 highlightColor = highlightColors[highlightId];
+    vec3 highlightColor = highlightColors[highlightId].rgb;
 
     vec3 backgroundColor = vec3(0.5, 0.4, 0.3);
 
@@ -151,23 +155,43 @@ float getShadow(vec3 fragPosWorldSpace, vec3 normal, float lDepth) {
     if (fragDepth > 0.999) return 0.0;
 
     float lightDirBias = dot(normal, sunlightDir);
-    float bias = max(lightDirBias * -100.0, 0.004 / cascadeSplits[layer]);
+    float biasScale = depthBiasScales[layer];
+    float bias = max(lightDirBias * -100.0, 0.004 / cascadeSplits[layer]) * biasScale;
+    // taps are clamped to the rect of the cascade, so they never reach into a neighbor
+    vec4 scaleOffset = atlasScaleOffsets[layer];
+    vec2 texelSize = 1.0 / vec2(textureSize(tShadow, 0));
+    vec2 rectMin = scaleOffset.zw + texelSize * 0.5;
+    vec2 rectMax = scaleOffset.zw + scaleOffset.xy - texelSize * 0.5;
+    projCoords.xy = projCoords.xy * scaleOffset.xy + scaleOffset.zw;
+    // every fetch compares 2x2 texels and blends the results bilinearly, 1.0 is lit
 #if SHADOW_PCF == 0
-    float depth = texture(tShadow, vec3(projCoords.xy, layer)).r;
-    return (fragDepth + bias) > depth ? 1.0 : 0.0;
+    return 1.0 - texture(tShadow, vec3(clamp(projCoords.xy, rectMin, rectMax), fragDepth + bias));
 #else
-    // PCF
-    bias -= cascadeSplits[layer] * 0.0000004;
-    float shadow = 0.0;
-    vec2 texelSize = 0.8 / vec2(textureSize(tShadow, 0));
-    for(int x = -1; x <= 1; x++) {
-        for(int y = -1; y <= 1; y++) {
-            float pcfDepth = texture(tShadow, vec3(projCoords.xy + vec2(x, y) * texelSize, layer)).r;
-            shadow += (fragDepth + bias) > pcfDepth ? 1.0 : 0.0;      
+    bias -= cascadeSplits[layer] * 0.0000004 * biasScale;
+    float lit = 0.0;
+#if SHADOW_PCF == 1
+    // 4 taps half a texel from the center cover 3x3 texels with tent weights
+    for (int x = 0; x < 2; x++) {
+        for (int y = 0; y < 2; y++) {
+            vec2 offset = vec2(float(x) - 0.5, float(y) - 0.5) * texelSize;
+            lit += texture(tShadow, vec3(clamp(projCoords.xy + offset, rectMin, rectMax), fragDepth + bias));
         }
     }
-    shadow /= 9.0;
-    return shadow;
+    return 1.0 - lit * 0.25;
+#else
+    // poisson disk rotated per pixel, the banding of the fixed kernel turns into noise
+    const vec2 poissonDisk[8] = vec2[](
+        vec2(-0.326, -0.406), vec2(-0.840, -0.074), vec2(-0.696, 0.457), vec2(-0.203, 0.621),
+        vec2(0.962, -0.195), vec2(0.473, -0.480), vec2(0.519, 0.767), vec2(0.185, -0.893)
+    );
+    float angle = 6.2831853 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+    for (int i = 0; i < 8; i++) {
+        vec2 offset = rotation * poissonDisk[i] * 1.5 * texelSize;
+        lit += texture(tShadow, vec3(clamp(projCoords.xy + offset, rectMin, rectMax), fragDepth + bias));
+    }
+    return 1.0 - lit * 0.125;
+#endif
 #endif
 }
 
@@ -1,4 +1,11 @@
 R"(#version 300 es
+#define MULTI_DRAW <<MULTI_DRAW>>
+#if MULTI_DRAW == 1
+#extension GL_ANGLE_multi_draw : require
+#define DRAW_ID gl_DrawID
+#else
+#define DRAW_ID 0
+#endif
 precision mediump float;
 
 layout (location = 0) in vec3 position;
@@ -10,23 +17,52 @@ layout(std140) uniform CameraUniform {
     vec2 nearFarPlane;
 };
 
-layout(std140) uniform ModelMatricesUniform {
-    mat4 model[<<MODELS_PER_UBO>>];
-};
+// per instance data, see Renderer::UpdateRenderableMeshes
+uniform highp sampler2D tInstanceTransforms; // 3 texels per instance, rows of the affine model matrix
+uniform highp usampler2D tInstanceIndices; // transform index | highlight id << 24, one range per draw
+// first index of each draw, 4 draws per vector
+uniform ivec4 drawOffsets[<<MULTI_DRAW_OFFSETS>>];
+// dequantization of each draw, see MeshImpl::GetPositionOffset. quantized meshes store positions in [0, 1] of their aabb
+uniform highp vec4 drawPositionOffsets[<<MULTI_DRAWS>>];
+uniform highp vec4 drawPositionScales[<<MULTI_DRAWS>>]; // w = 1 if normal.xy is octahedral encoded
+
+highp mat4x3 loadModel(out uint highlightId) {
+    int i = drawOffsets[DRAW_ID / 4][DRAW_ID % 4] + gl_InstanceID;
+    uint instance = texelFetch(tInstanceIndices, ivec2(i % <<INSTANCE_INDICES_WIDTH>>, i / <<INSTANCE_INDICES_WIDTH>>), 0).r;
+    highlightId = instance >> 24;
+    int t = int(instance & 0xFFFFFFu);
+    ivec2 texel = ivec2(t % <<INSTANCES_PER_ROW>> * 3, t / <<INSTANCES_PER_ROW>>);
+    return transpose(mat3x4(
+        texelFetch(tInstanceTransforms, texel, 0),
+        texelFetch(tInstanceTransforms, texel + ivec2(1, 0), 0),
+        texelFetch(tInstanceTransforms, texel + ivec2(2, 0), 0)
+    ));
+}
 
 out vec3 u_normal;
 flat out uint u_highlightId;
 flat out uint u_materialId;
 
+vec3 decodeNormal() {
+    if (drawPositionScales[DRAW_ID].w < 0.5) return normal;
+    vec3 n = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return n;
+}
+
 void main() {
-    mat4 currentModel = model[gl_InstanceID];
-    u_highlightId = uint(currentModel[3][3] + 0.5);
-    // revert misc data
-    currentModel[3][3] = 1.0;
+    uint highlightId;
+    highp mat4x3 model = loadModel(highlightId);
+    u_highlightId = highlightId;
 
-    u_normal = transpose(inverse(mat3(currentModel))) * normal;
+    // models are rotation * scale (see computeModelMatrix), so their inverse transpose is model * scale^-2
+    highp mat3 linear = mat3(model);
+    highp vec3 invScale2 = 1.0 / vec3(dot(linear[0], linear[0]), dot(linear[1], linear[1]), dot(linear[2], linear[2]));
+    u_normal = linear * (decodeNormal() * invScale2);
     u_materialId = materialId;
 
-    gl_Position = projxview * currentModel * vec4(position, 1.0);
+    gl_Position = projxview * vec4(model * vec4(drawPositionOffsets[DRAW_ID].xyz + position * drawPositionScales[DRAW_ID].xyz, 1.0), 1.0);
 }
 )"
\ No newline at end of file
@@ -0,0 +1,4 @@
+R"(#version 300 es
+precision mediump float;
+void main() {}
+)"
\ No newline at end of file
@@ -0,0 +1,18 @@
+R"(#version 300 es
+precision mediump float;
+
+layout (location = 0) in vec3 position; // corner of the unit cube
+
+layout(std140) uniform CameraUniform {
+    mat4 projxview;
+    vec2 nearFarPlane;
+};
+
+// world space box of the tested entity, see OcclusionQueries
+uniform highp vec3 aabbMin;
+uniform highp vec3 aabbMax;
+
+void main() {
+    gl_Position = projxview * vec4(mix(aabbMin, aabbMax, position), 1.0);
+}
+)"
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+
+// std::format is missing from some native standard libraries (libstdc++ < 13).
+// Native builds fall back to fmt there, use wgleng::format instead of either.
+#include <version>
+#if defined(__cpp_lib_format) || !defined(WGLENG_HEADLESS)
+#include <format>
+namespace wgleng {
+	using std::format;
+}
+#else
+#include <fmt/format.h>
+namespace wgleng {
+	using fmt::format;
+}
+#endif
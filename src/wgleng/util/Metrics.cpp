@@ -5,8 +5,17 @@
 
 #include "../vendor/imgui/imgui.h"
 
+// EXT_disjoint_timer_query_webgl2
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
 void Metrics::Show() {
 	if (m_enabled == 0) return;
+	CollectGpuDurations();
 	const auto now = TimePoint();
 	bool updateData = false;
 	if (now - m_lastDurationUpdate > 500ms) {
@@ -62,6 +71,55 @@ void Metrics::MeasureDurationStop(Metric m, bool waitForGpu) {
 	data.duration.accum += TimePoint() - data.duration.start;
 	data.duration.count++;
 }
+void Metrics::MeasureGpuDurationStart(Metric m) {
+	if (!IsEnabled(m)) return;
+	if (!m_gpuTimerSupported) {
+		MeasureDurationStart(m);
+		return;
+	}
+	auto& timer = m_data[GetIndex(m)].gpuTimer;
+	if (timer.queries[0] == 0) glGenQueries(m_gpuQueriesPerMetric, timer.queries);
+	const uint32_t slot = timer.next;
+	if (timer.pending[slot]) return; // gpu is more than m_gpuQueriesPerMetric frames behind, skip this sample
+	glBeginQuery(GL_TIME_ELAPSED_EXT, timer.queries[slot]);
+	timer.active = static_cast<int32_t>(slot);
+}
+void Metrics::MeasureGpuDurationStop(Metric m) {
+	if (!IsEnabled(m)) return;
+	if (!m_gpuTimerSupported) {
+		MeasureDurationStop(m);
+		return;
+	}
+	auto& timer = m_data[GetIndex(m)].gpuTimer;
+	if (timer.active < 0) return;
+	glEndQuery(GL_TIME_ELAPSED_EXT);
+	timer.pending[timer.active] = true;
+	timer.next = (timer.active + 1) % m_gpuQueriesPerMetric;
+	timer.active = -1;
+}
+void Metrics::CollectGpuDurations() {
+	if (!m_gpuTimerSupported) return;
+	// results that overlap a disjoint event (gpu reset, power state change...) are meaningless
+	GLint disjoint = 0;
+	glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+	for (auto& data : m_data) {
+		auto& timer = data.gpuTimer;
+		for (uint32_t i = 0; i < m_gpuQueriesPerMetric; i++) {
+			// oldest first, results become available in submission order
+			const uint32_t slot = (timer.next + i) % m_gpuQueriesPerMetric;
+			if (!timer.pending[slot]) continue;
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(timer.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) break;
+			GLuint nanoseconds = 0;
+			glGetQueryObjectuiv(timer.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+			timer.pending[slot] = false;
+			if (disjoint) continue;
+			data.duration.accum += std::chrono::nanoseconds(nanoseconds);
+			data.duration.count++;
+		}
+	}
+}
 void Metrics::SetStaticMetric(Metric m, const std::variant<int64_t, uint64_t, double, std::string>& val) {
 	auto& data = m_data[GetIndex(m)];
 	data.staticMetric = val;
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <GLES3/gl3.h>
 #include <stdint.h>
+#include <optional>
+#include <string>
 #include <variant>
 
 #include "Timer.h"
@@ -27,8 +30,13 @@ enum class Metric : uint32_t {
 	TRIANGLES_TOTAL  = 1 << 16,
 	TRIANGLES_SHADOW = 1 << 17,
 	TRIANGLES_MESHES = 1 << 18,
+	UPLOADED_BYTES   = 1 << 19,
+	STATE_CHANGES    = 1 << 20,
+	STATE_CHANGES_ELIDED = 1 << 21,
+	OCCLUDED_ENTITES = 1 << 22,
+	QUERY_OCCLUDED_ENTITES = 1 << 23,
 	//===========================//
-	METRIC_COUNT = 19,
+	METRIC_COUNT = 24,
 	ALL_METRICS  = (1 << METRIC_COUNT) - 1,
 };
 
@@ -56,6 +64,11 @@ private:
 		"(info) triangle count ",
 		"   (info) shadow triangles ",
 		"   (info) mesh triangles   ",
+		"(info) uploaded bytes ",
+		"(info) gl state changes ",
+		"   (info) elided         ",
+		"(info) occluded entities ",
+		"   (info) by gpu queries ",
 	};
 
 public:
@@ -75,11 +88,19 @@ public:
 
 	static void MeasureDurationStart(Metric m);
 	static void MeasureDurationStop(Metric m, bool waitForGpu = false);
+	// gpu time of the commands issued in between, read back a few frames later without stalling.
+	// uses EXT_disjoint_timer_query_webgl2, falls back to cpu time if the extension is missing.
+	// only one gpu measurement can be active at a time.
+	static void MeasureGpuDurationStart(Metric m);
+	static void MeasureGpuDurationStop(Metric m);
+	static void SetGpuTimerSupported(bool supported) { m_gpuTimerSupported = supported; }
+	static bool IsGpuTimerSupported() { return m_gpuTimerSupported; }
 	static void SetStaticMetric(Metric m, const std::variant<int64_t, uint64_t, double, std::string>& val);
 	static void ResetStaticMetric(Metric m);
 
 private:
 	constexpr static uint32_t GetIndex(Metric m);
+	static void CollectGpuDurations();
 
 private:
 	static inline uint32_t m_enabled = 0;
@@ -106,8 +127,22 @@ private:
 			count = 0;
 		}
 	};
+	// queries are reused round robin, a slot is skipped while its result is still in flight
+	constexpr static uint32_t m_gpuQueriesPerMetric = 4;
+	struct GpuTimer {
+		GpuTimer()
+			: queries{}, pending{}, next{0}, active{-1} {}
+
+		GLuint queries[m_gpuQueriesPerMetric];
+		bool pending[m_gpuQueriesPerMetric];
+		uint32_t next;
+		int32_t active;
+	};
+	static inline bool m_gpuTimerSupported = false;
+
 	struct MeasurementData {
 		DurationMeasurement duration;
+		GpuTimer gpuTimer;
 		std::optional<std::variant<int64_t, uint64_t, double, std::string>> staticMetric;
 	};
 	static inline MeasurementData m_data[static_cast<uint32_t>(Metric::METRIC_COUNT)] = {};
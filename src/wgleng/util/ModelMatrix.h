@@ -2,7 +2,7 @@
 
 #include <glm/glm.hpp>
 
-constexpr inline glm::mat4 computeModelMatrix(
+inline glm::mat4 computeModelMatrix(
 	const glm::vec3& globalPos, const glm::vec3& localPos,
 	const glm::vec3& globalRot, const glm::vec3& localRot,
 	const glm::vec3& scale) noexcept {
@@ -1,11 +1,15 @@
 #include "SceneBuilder.h"
 
+#ifndef WGLENG_HEADLESS
 #include <emscripten/fetch.h>
+#endif
 #include <glm/gtx/euler_angles.hpp>
 
 #include "../core/Components.h"
 #include "../rendering/Debug.h"
 #include "../rendering/Highlights.h"
+#include "../rendering/MeshInstances.h"
+#include "Format.h"
 #include "../vendor/imgui/imgui.h"
 #include "../vendor/imgui/imgui_internal.h"
 #include "../vendor/imgui/imgui_stdlib.h"
@@ -171,7 +175,7 @@ void SceneBuilder::Update() {
 			for (int i = 0; i < m_savedStates.size(); i++) {
 				ImGui::PushID(i);
 				bool isSelected = m_selectedEntities.contains(i);
-				if (ImGui::Selectable(std::format("({}) Entity {}", m_savedStates[i].second.tag, i + 1).c_str(), isSelected)) {
+				if (ImGui::Selectable(wgleng::format("({}) Entity {}", m_savedStates[i].second.tag, i + 1).c_str(), isSelected)) {
 					if (selectMultiple) {
 						if (isSelected) m_selectedEntities.erase(i);
 						else {
@@ -384,10 +388,7 @@ void SceneBuilder::Update() {
 	ImGui::End();
 	Blink(-1);
 	for (int i : m_selectedEntities) {
-		auto meshComp = m_registry.try_get<MeshComponent>(m_savedStates[i].first);
-		if (meshComp) {
-			meshComp->highlightId = Highlights::GetHighlightId("yellow");
-		}
+		MeshInstanceStore::Highlight(m_registry, m_savedStates[i].first, Highlights::GetHighlightId("yellow"));
 	}
 }
 
@@ -526,22 +527,22 @@ void SceneBuilder::Save() {
 	std::string& saveData = *saveDataIpl;
 	{
 		auto vec3Str = [](const glm::vec3& v) {
-			return std::format("{{{},{},{}}}", v.x, v.y, v.z);
+			return wgleng::format("{{{},{},{}}}", v.x, v.y, v.z);
 		};
 		saveData += "#pragma once\n\n";
 		saveData += "#include <stdint.h>\n";
 		saveData += "#include <wgleng/util/SceneBuilder.h>\n\n";
-		saveData += std::format("constexpr uint32_t {}_stateVersion = {};\n", m_saveName, m_stateVersion);
-		saveData += std::format("constexpr uint32_t {}_stateCount = {};\n", m_saveName, m_savedStates.size());
-		saveData += std::format("constexpr SceneBuilder::State {}_states[] = {{\n", m_saveName);
+		saveData += wgleng::format("constexpr uint32_t {}_stateVersion = {};\n", m_saveName, m_stateVersion);
+		saveData += wgleng::format("constexpr uint32_t {}_stateCount = {};\n", m_saveName, m_savedStates.size());
+		saveData += wgleng::format("constexpr SceneBuilder::State {}_states[] = {{\n", m_saveName);
 		for (const auto& pair : m_savedStates) {
 			const State& state = pair.second;
-			saveData += std::format("   {{{},{},{},", vec3Str(state.position), vec3Str(state.rotation), vec3Str(state.scale));
-			saveData += std::format("{},{},{},{},", state.selectedModel, vec3Str(state.modelOffset), vec3Str(state.modelRotation),
+			saveData += wgleng::format("   {{{},{},{},", vec3Str(state.position), vec3Str(state.rotation), vec3Str(state.scale));
+			saveData += wgleng::format("{},{},{},{},", state.selectedModel, vec3Str(state.modelOffset), vec3Str(state.modelRotation),
 				vec3Str(state.modelScale));
-			saveData += std::format("\"{}\",{},", state.tag, state.flags);
-			saveData += std::format("{},{},{},{},", state.selectedCollider, state.mass, state.friction, vec3Str(state.boxColliderSize));
-			saveData += std::format("{},{},{}}},\n", state.sphereColliderRadius, state.capsuleColliderRadius, state.capsuleColliderHeight);
+			saveData += wgleng::format("\"{}\",{},", state.tag, state.flags);
+			saveData += wgleng::format("{},{},{},{},", state.selectedCollider, state.mass, state.friction, vec3Str(state.boxColliderSize));
+			saveData += wgleng::format("{},{},{}}},\n", state.sphereColliderRadius, state.capsuleColliderRadius, state.capsuleColliderHeight);
 		}
 		saveData += "};\n";
 	}